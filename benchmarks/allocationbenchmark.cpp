@@ -0,0 +1,192 @@
+/*
+Allocation benchmark for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Counts heap allocations per message: for the old way of passing std::vector<char> by value into a queue and copying
+//it back out, for Message in the same queue, and for a whole trip through Sockets (both ends, every thread, including
+//making each message and the debug log lines, which are built even when they aren't shown).
+//Usage: allocationbenchmark [Count] [Port]
+
+//Includes.
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/messagetools.h"
+#include "../include/queuetools.h"
+#include "../include/sockettools.h"
+#include "benchtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Every allocation in the process, on any thread.
+static std::atomic<std::uint64_t> Allocations(0);
+
+void* operator new(std::size_t Size) {
+    Allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void* Memory = std::malloc(Size ? Size : 1);
+
+    if (Memory == nullptr) {
+        throw std::bad_alloc();
+
+    }
+
+    return Memory;
+}
+
+void operator delete(void* Memory) noexcept {
+    std::free(Memory);
+
+}
+
+void operator delete(void* Memory, std::size_t) noexcept {
+    std::free(Memory);
+
+}
+
+//The old API: Write() took the vector by value and copied it into the queue, and Read() returned a copy of the front.
+std::vector<char> OldWrite(std::deque<std::vector<char> >& Queue, std::vector<char> Msg) {
+    Queue.push_back(Msg);
+
+    return Msg;
+}
+
+double VectorAllocations(const int Count, const std::size_t Size) {
+    std::deque<std::vector<char> > Queue;
+    const std::string Payload(Size, 'v');
+
+    const std::uint64_t Before = Allocations;
+
+    for (int i = 0; i < Count; i++) {
+        std::vector<char> Msg(Payload.begin(), Payload.end());
+        OldWrite(Queue, Msg);
+
+        std::vector<char> Received = Queue.front();
+        Queue.pop_front();
+
+    }
+
+    return static_cast<double>(Allocations - Before) / Count;
+}
+
+double MessageAllocations(const int Count, const std::size_t Size) {
+    SPSCQueue<Message> Queue(1024);
+    const std::string Payload(Size, 'm');
+
+    const std::uint64_t Before = Allocations;
+
+    for (int i = 0; i < Count; i++) {
+        Message Msg(Payload);
+        Queue.Push(Msg);
+
+        Message Received = Queue.Front();
+        Queue.Pop();
+
+    }
+
+    return static_cast<double>(Allocations - Before) / Count;
+}
+
+//Writes Count messages through a connected pair, while another thread reads them at the other end.
+double SocketsAllocations(Sockets& Server, Sockets& Plug, const int Count, const std::size_t Size) {
+    const std::string Payload(Size, 's');
+
+    const std::uint64_t Before = Allocations;
+
+    std::thread Reader([&]() {
+        //Drop each batch once it's read, so the receive rings can be reused.
+        std::vector<Message> Received;
+        Received.reserve(Count);
+        int Total = 0;
+
+        while (Total < Count) {
+            if (Server.WaitForData(std::chrono::milliseconds(1000))) {
+                Total += Server.DrainAll(Received);
+                Received.clear();
+
+            } else {
+                std::cerr << "Timed out waiting for messages" << std::endl;
+                break;
+
+            }
+        }
+    });
+
+    for (int i = 0; i < Count; i++) {
+        Plug.Write(Message(Payload));
+
+    }
+
+    Reader.join();
+
+    //Starting the thread (and reserving room for the messages) allocates too, but only once.
+    return static_cast<double>(Allocations - Before) / Count;
+}
+
+int main(int argc, char* argv[]) {
+    Logger.SetLevel("Critical");
+
+    const int Count = GetArgument(argc, argv, 1, 20000);
+    const int Port = GetArgument(argc, argv, 2, 50101);
+
+    //Compression needs buffers of its own (see compressionbenchmark), so leave it out.
+    Sockets Server("Socket");
+    Server.SetPortNumber(Port);
+    Server.SetConsoleOutput(false);
+    Server.SetCompressionThreshold(0);
+
+    Sockets Plug("Plug");
+    Plug.SetPortNumber(Port);
+    Plug.SetServerAddress("127.0.0.1");
+    Plug.SetConsoleOutput(false);
+    Plug.SetCompressionThreshold(0);
+
+    if (!StartPair(Server, Plug)) {
+        std::cerr << "Couldn't connect" << std::endl;
+        return 1;
+
+    }
+
+    //Let the buffer pools fill up first.
+    SocketsAllocations(Server, Plug, Count / 10 + 1, 4096);
+
+    std::cout << "Heap allocations per message (" << Count << " messages):" << std::endl;
+    std::cout << std::left << std::setw(10) << "Size" << std::setw(22) << "std::vector<char>"
+              << std::setw(12) << "Message" << "Sockets, end to end" << std::endl;
+
+    const std::size_t Sizes[] = {16, 128, 4096, 65536};
+
+    for (const std::size_t Size : Sizes) {
+        const double Vector = VectorAllocations(Count, Size);
+        const double Msg = MessageAllocations(Count, Size);
+        const double EndToEnd = SocketsAllocations(Server, Plug, Count, Size);
+
+        std::cout << std::left << std::fixed << std::setprecision(2) << std::setw(10) << Size << std::setw(22) << Vector
+                  << std::setw(12) << Msg << EndToEnd << std::endl;
+
+    }
+
+    StopPair(Server, Plug);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+Backend benchmark for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Measures throughput, CPU time and round-trip latency with the polling handler, over TCP loopback, using whichever
+//backend this was built with. Build once with -DIOUring=ON and once without, and compare the two.
+//Usage: backendbenchmark [Messages] [Port]
+
+//Includes.
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/sockettools.h"
+#include "benchtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Sets up both ends to talk over TCP loopback, without compression (which would hide the cost of the I/O), and starts them.
+bool StartPair(Sockets& Server, Sockets& Plug, const int Port) {
+    Server.SetPortNumber(Port);
+    Server.SetConsoleOutput(false);
+    Server.SetCompressionThreshold(0);
+
+    Plug.SetPortNumber(Port);
+    Plug.SetServerAddress("127.0.0.1");
+    Plug.SetConsoleOutput(false);
+    Plug.SetCompressionThreshold(0);
+
+    return StartPair(Server, Plug);
+}
+
+bool BenchmarkThroughput(const int Count, const std::size_t Size, const int Port) {
+    Sockets Server("Socket");
+    Sockets Plug("Plug");
+
+    if (!StartPair(Server, Plug, Port)) {
+        std::cerr << "Couldn't connect" << std::endl;
+        return false;
+
+    }
+
+    const Message Payload(std::string(Size, 't'));
+    const double CPUStart = 1000.0 * std::clock() / CLOCKS_PER_SEC;
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+    std::thread Reader([&]() {
+        std::vector<Message> Received;
+        int Total = 0;
+
+        while (Total < Count && Server.WaitForData(std::chrono::milliseconds(5000))) {
+            Total += Server.DrainAll(Received);
+            Received.clear();
+
+        }
+    });
+
+    for (int i = 0; i < Count; i++) {
+        Plug.Write(Payload);
+
+    }
+
+    Reader.join();
+
+    const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    const double CPUUsed = 1000.0 * std::clock() / CLOCKS_PER_SEC - CPUStart;
+    const double Megabytes = static_cast<double>(Count) * Size / 1e6;
+    const WriteStatistics Stats = Plug.GetWriteStatistics();
+
+    std::cout << std::setw(6) << Size << " bytes: " << std::fixed << std::setprecision(0) << std::setw(8) << Count / Seconds
+              << " msg/s " << std::setw(6) << Megabytes / Seconds << " MB/s  CPU " << std::setprecision(2)
+              << std::setw(6) << 1000.0 * CPUUsed / Count << " us/msg  " << std::setw(6)
+              << static_cast<double>(Stats.Messages) / Stats.Writes << " msgs/write" << std::endl;
+
+    StopPair(Server, Plug);
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    //Whether io_uring was actually used (or the kernel made us fall back to epoll) is logged here.
+    Logger.SetFileName("backendbenchmark.log");
+    Logger.SetLevel("Info");
+
+    const int Count = GetArgument(argc, argv, 1, 100000);
+    const int Port = GetArgument(argc, argv, 2, 50103);
+
+#ifdef STROODLR_IO_URING
+    std::cout << "Backend: io_uring, where the kernel supports it (see backendbenchmark.log)" << std::endl;
+#else
+    std::cout << "Backend: epoll (build with -DIOUring=ON for io_uring)" << std::endl;
+#endif
+
+    std::cout << std::endl << "Throughput, " << Count << " messages:" << std::endl;
+
+    const std::size_t Sizes[] = {64, 1024, 16384, 65536};
+
+    for (const std::size_t Size : Sizes) {
+        if (!BenchmarkThroughput(Size > 1024 ? Count / 10 : Count, Size, Port)) {
+            return 1;
+
+        }
+    }
+
+    std::cout << std::endl << "Round trips:" << std::endl;
+
+    Sockets Server("Socket");
+    Sockets Plug("Plug");
+
+    if (!StartPair(Server, Plug, Port)) {
+        std::cerr << "Couldn't connect" << std::endl;
+        return 1;
+
+    }
+
+    PrintLatencies("64 bytes", SummariseLatencies(PingPong(Server, Plug, Count / 10, 64)));
+    PrintLatencies("16384 bytes", SummariseLatencies(PingPong(Server, Plug, Count / 10, 16384)));
+    StopPair(Server, Plug);
+
+    return 0;
+}
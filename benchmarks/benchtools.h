@@ -0,0 +1,133 @@
+/*
+Benchmark Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/sockettools.h"
+
+//Percentiles of a set of timings, in microseconds.
+struct LatencySummary {
+    double Mean = 0;
+    double Median = 0;
+    double P99 = 0;
+    double Max = 0;
+};
+
+inline LatencySummary SummariseLatencies(std::vector<double> Latencies) {
+    LatencySummary Summary;
+
+    if (Latencies.empty()) {
+        return Summary;
+
+    }
+
+    std::sort(Latencies.begin(), Latencies.end());
+
+    double Total = 0;
+
+    for (std::size_t i = 0; i < Latencies.size(); i++) {
+        Total += Latencies[i];
+
+    }
+
+    Summary.Mean = Total / Latencies.size();
+    Summary.Median = Latencies[Latencies.size() / 2];
+    Summary.P99 = Latencies[(Latencies.size() * 99) / 100];
+    Summary.Max = Latencies.back();
+
+    return Summary;
+}
+
+inline void PrintLatencies(const std::string& Name, const LatencySummary& Summary) {
+    std::cout << std::left << std::setw(24) << Name << std::right << std::fixed << std::setprecision(1)
+              << " mean " << std::setw(8) << Summary.Mean << " us"
+              << "  median " << std::setw(8) << Summary.Median << " us"
+              << "  p99 " << std::setw(8) << Summary.P99 << " us"
+              << "  max " << std::setw(9) << Summary.Max << " us" << std::endl;
+}
+
+//Returns argument Index as a number, or Default if it wasn't given.
+inline int GetArgument(const int argc, char* argv[], const int Index, const int Default) {
+    return (argc > Index) ? std::atoi(argv[Index]) : Default;
+}
+
+//Starts both ends and waits for them to connect. Returns false if they don't within 10 seconds.
+inline bool StartPair(Sockets& Server, Sockets& Plug) {
+    Server.StartHandler();
+    Plug.StartHandler();
+
+    return Plug.WaitForState(ConnectionState::Connected, std::chrono::seconds(10))
+           && Server.WaitForState(ConnectionState::Connected, std::chrono::seconds(10));
+}
+
+inline void StopPair(Sockets& Server, Sockets& Plug) {
+    Plug.RequestHandlerExit();
+    Server.RequestHandlerExit();
+    Plug.WaitForHandlerToExit();
+    Server.WaitForHandlerToExit();
+}
+
+//Sends Count messages of Size bytes from Plug to Server, which sends each one straight back, and returns how long each
+//round trip took (in microseconds). The first few are left out, so connection setup doesn't count.
+inline std::vector<double> PingPong(Sockets& Server, Sockets& Plug, const int Count, const std::size_t Size) {
+    const int Warmup = std::min(Count, 100);
+    std::vector<double> Latencies;
+    Latencies.reserve(Count);
+
+    std::thread Echo([&]() {
+        try {
+            for (int i = 0; i < Warmup + Count; i++) {
+                Server.Write(Server.ReadBlocking());
+
+            }
+
+        } catch (std::runtime_error&) {
+            //The handler exited.
+            return;
+
+        }
+    });
+
+    const Message Ping(std::string(Size, 'p'));
+
+    for (int i = 0; i < Warmup + Count; i++) {
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        Plug.Write(Ping);
+        Plug.ReadBlocking();
+
+        if (i >= Warmup) {
+            Latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count());
+
+        }
+    }
+
+    Echo.join();
+
+    return Latencies;
+}
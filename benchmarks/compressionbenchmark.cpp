@@ -0,0 +1,199 @@
+/*
+Compression benchmark for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Reports how much the built-in codec shrinks log-like text and random data, and what it costs in CPU time per MB:
+//first for the codec on its own, then through a connected pair of Sockets with compression on and off.
+//Usage: compressionbenchmark [Messages] [Size] [Port]
+
+//Includes.
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/compressiontools.h"
+#include "../include/sockettools.h"
+#include "benchtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Returns Size bytes of log lines, which compress about as well as the text we usually send.
+std::string MakeText(std::mt19937& Random, const std::size_t Size) {
+    const char* Levels[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+    const char* Events[] = {"connection resumed, replaying", "queued", "acknowledged", "dropped", "compressed"};
+    std::string Text;
+
+    while (Text.size() < Size) {
+        Text += "2017-06-" + std::to_string(10 + Random() % 20) + " " + std::to_string(Random() % 24) + ":"
+                + std::to_string(Random() % 60) + ":" + std::to_string(Random() % 60) + " " + Levels[Random() % 4]
+                + " Socket Tools: session " + std::to_string(Random() % 1000) + " " + Events[Random() % 5] + " "
+                + std::to_string(Random() % 100000) + " message(s)\n";
+
+    }
+
+    Text.resize(Size);
+
+    return Text;
+}
+
+std::string MakeRandom(std::mt19937& Random, const std::size_t Size) {
+    std::string Data(Size, '\0');
+
+    for (std::size_t i = 0; i < Size; i++) {
+        Data[i] = static_cast<char>(Random());
+
+    }
+
+    return Data;
+}
+
+//CPU time used by every thread in the process so far, in milliseconds.
+double CPUTime() {
+    return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+}
+
+void BenchmarkCodec(const std::string& Name, const std::vector<std::string>& Payloads) {
+    LZCompressor Codec;
+    std::vector<std::vector<char> > Compressed(Payloads.size());
+    double Megabytes = 0;
+    std::size_t CompressedSize = 0;
+
+    double Start = CPUTime();
+
+    for (std::size_t i = 0; i < Payloads.size(); i++) {
+        Codec.Compress(Payloads[i].data(), Payloads[i].size(), Compressed[i]);
+        Megabytes += Payloads[i].size() / 1e6;
+        CompressedSize += Compressed[i].size();
+
+    }
+
+    const double CompressTime = CPUTime() - Start;
+    std::vector<char> Out;
+
+    Start = CPUTime();
+
+    for (std::size_t i = 0; i < Payloads.size(); i++) {
+        Out.resize(Payloads[i].size());
+        Codec.Decompress(Compressed[i].data(), Compressed[i].size(), Out.data(), Out.size());
+
+    }
+
+    const double DecompressTime = CPUTime() - Start;
+
+    std::cout << std::left << std::setw(8) << Name << std::right << std::fixed << std::setprecision(3)
+              << " ratio " << CompressedSize / (Megabytes * 1e6)
+              << "  compress " << std::setprecision(2) << CompressTime / Megabytes << " ms/MB"
+              << "  decompress " << DecompressTime / Megabytes << " ms/MB" << std::endl;
+}
+
+bool BenchmarkSockets(const std::string& Name, const std::vector<std::string>& Payloads, const int Threshold, const int Port) {
+    Sockets Server("Socket");
+    Server.SetPortNumber(Port);
+    Server.SetConsoleOutput(false);
+    Server.SetCompressionThreshold(Threshold);
+
+    Sockets Plug("Plug");
+    Plug.SetPortNumber(Port);
+    Plug.SetServerAddress("127.0.0.1");
+    Plug.SetConsoleOutput(false);
+    Plug.SetCompressionThreshold(Threshold);
+
+    if (!StartPair(Server, Plug)) {
+        std::cerr << "Couldn't connect" << std::endl;
+        return false;
+
+    }
+
+    //Make the messages first, so copying them in doesn't count.
+    std::vector<Message> Messages;
+    double Megabytes = 0;
+
+    for (std::size_t i = 0; i < Payloads.size(); i++) {
+        Messages.push_back(Message(Payloads[i]));
+        Megabytes += Payloads[i].size() / 1e6;
+
+    }
+
+    const std::uint64_t BytesBefore = Plug.GetWriteStatistics().Bytes;
+    const double CPUStart = CPUTime();
+    const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+    std::thread Reader([&]() {
+        std::vector<Message> Received;
+        std::size_t Total = 0;
+
+        while (Total < Messages.size() && Server.WaitForData(std::chrono::milliseconds(5000))) {
+            Total += Server.DrainAll(Received);
+            Received.clear();
+
+        }
+    });
+
+    Plug.WriteBatch(Messages);
+    Reader.join();
+
+    const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    const double CPUUsed = CPUTime() - CPUStart;
+    const std::uint64_t WireBytes = Plug.GetWriteStatistics().Bytes - BytesBefore;
+
+    std::cout << std::left << std::setw(8) << Name << std::setw(5) << (Threshold ? "on" : "off") << std::right << std::fixed
+              << std::setprecision(1) << " on the wire " << std::setw(7) << WireBytes / 1e6 << " MB of " << Megabytes
+              << " MB (" << std::setprecision(3) << WireBytes / (Megabytes * 1e6) << ")" << std::setprecision(2)
+              << "  CPU " << std::setw(6) << CPUUsed / Megabytes << " ms/MB  " << std::setprecision(0)
+              << std::setw(5) << Megabytes / Seconds << " MB/s" << std::endl;
+
+    StopPair(Server, Plug);
+
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Logger.SetLevel("Critical");
+
+    const int Count = GetArgument(argc, argv, 1, 1000);
+    const int Size = GetArgument(argc, argv, 2, 65536);
+    const int Port = GetArgument(argc, argv, 3, 50102);
+
+    std::mt19937 Random(1);
+    std::vector<std::string> Text;
+    std::vector<std::string> Noise;
+
+    for (int i = 0; i < Count; i++) {
+        Text.push_back(MakeText(Random, Size));
+        Noise.push_back(MakeRandom(Random, Size));
+
+    }
+
+    std::cout << "LZ codec, " << Count << " payloads of " << Size << " bytes:" << std::endl;
+    BenchmarkCodec("Text", Text);
+    BenchmarkCodec("Random", Noise);
+
+    //Both ends are in this process, so the CPU time covers compressing, sending, receiving and decompressing.
+    std::cout << std::endl << "Sockets over TCP loopback, compression on (at least 512 bytes) and off:" << std::endl;
+
+    if (!BenchmarkSockets("Text", Text, 512, Port) || !BenchmarkSockets("Text", Text, 0, Port)
+        || !BenchmarkSockets("Random", Noise, 512, Port) || !BenchmarkSockets("Random", Noise, 0, Port)) {
+
+        return 1;
+
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+Handler latency benchmark for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Compares round-trip latency over TCP loopback with the polling handler and the async (boost::asio) handler.
+//Usage: handlerbenchmark [Count] [Size] [Port]
+
+//Includes.
+#include <iostream>
+#include <string>
+
+#include "../include/loggertools.h"
+#include "../include/sockettools.h"
+#include "benchtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+int main(int argc, char* argv[]) {
+    Logger.SetLevel("Critical");
+
+    const int Count = GetArgument(argc, argv, 1, 10000);
+    const int Size = GetArgument(argc, argv, 2, 64);
+    const int Port = GetArgument(argc, argv, 3, 50100);
+
+    std::cout << Count << " round trips of " << Size << " bytes over TCP loopback:" << std::endl;
+
+    const std::string Modes[] = {"Polling", "Async"};
+
+    for (const std::string& Mode : Modes) {
+        Sockets Server("Socket");
+        Server.SetPortNumber(Port);
+        Server.SetConsoleOutput(false);
+        Server.SetHandlerMode(Mode);
+
+        Sockets Plug("Plug");
+        Plug.SetPortNumber(Port);
+        Plug.SetServerAddress("127.0.0.1");
+        Plug.SetConsoleOutput(false);
+        Plug.SetHandlerMode(Mode);
+
+        if (!StartPair(Server, Plug)) {
+            std::cerr << Mode << ": couldn't connect" << std::endl;
+            return 1;
+
+        }
+
+        PrintLatencies(Mode, SummariseLatencies(PingPong(Server, Plug, Count, Size)));
+        StopPair(Server, Plug);
+
+    }
+
+    return 0;
+}
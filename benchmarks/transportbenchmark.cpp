@@ -0,0 +1,86 @@
+/*
+Transport benchmark for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Compares round-trip latency between two ends in the same process over TCP loopback, a Unix domain socket, and shared
+//memory.
+//Usage: transportbenchmark [Count] [Port]
+
+//Includes.
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "../include/loggertools.h"
+#include "../include/sockettools.h"
+#include "benchtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+int main(int argc, char* argv[]) {
+    Logger.SetLevel("Critical");
+
+    const int Count = GetArgument(argc, argv, 1, 10000);
+    const int Port = GetArgument(argc, argv, 2, 50104);
+    const std::string Suffix = std::to_string(getpid()) + ".sock";
+
+    //The port is only used for TCP.
+    const std::string Names[] = {"TCP loopback", "Unix domain socket", "Shared memory"};
+    const std::string Addresses[] = {"127.0.0.1", "unix:/tmp/stroodlr-transportbenchmark-" + Suffix,
+                                     "shm:/tmp/stroodlr-transportbenchmark-shm-" + Suffix};
+
+    const std::size_t Sizes[] = {64, 4096, 65536};
+
+    for (const std::size_t Size : Sizes) {
+        std::cout << Count << " round trips of " << Size << " bytes:" << std::endl;
+
+        for (int i = 0; i < 3; i++) {
+            //For TCP, the socket listens on every interface.
+            Sockets Server("Socket");
+            Server.SetPortNumber(Port);
+            Server.SetConsoleOutput(false);
+            Server.SetCompressionThreshold(0);
+
+            if (i > 0) {
+                Server.SetServerAddress(Addresses[i]);
+
+            }
+
+            Sockets Plug("Plug");
+            Plug.SetPortNumber(Port);
+            Plug.SetServerAddress(Addresses[i]);
+            Plug.SetConsoleOutput(false);
+            Plug.SetCompressionThreshold(0);
+
+            if (!StartPair(Server, Plug)) {
+                std::cerr << Names[i] << ": couldn't connect" << std::endl;
+                return 1;
+
+            }
+
+            PrintLatencies(Names[i], SummariseLatencies(PingPong(Server, Plug, Count, Size)));
+            StopPair(Server, Plug);
+
+        }
+
+        std::cout << std::endl;
+
+    }
+
+    return 0;
+}
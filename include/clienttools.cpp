@@ -56,13 +56,42 @@ void ShowHistory(const deque<string> &History) {
     std::cout << std::endl;
 }
 
-void ShowStatus() {
-    //Print status information. *** Actually check the status later ***
+void ShowStatus(Sockets* const Ptr) {
+    //Print status information.
     Logger.Debug("Client Tools: ShowStatus(): Showing status...");
 
+    RoundTripStatistics RTT = Ptr->GetRoundTripStatistics();
+    QueueStatistics Queues = Ptr->GetQueueStatistics();
+    WriteStatistics Writes = Ptr->GetWriteStatistics();
+    SocketTuning Tuning = Ptr->GetTuning();
+
     std::cout << std::endl << "Status:" << std::endl << std::endl;
     std::cout << "\tClient Status: Good" << std::endl;
-    std::cout << "\tConnected To Server: Yes" << std::endl;
+    std::cout << "\tConnected To Server: " << (Ptr->IsReady() ? "Yes" : "No") << std::endl;
+
+    if (RTT.Samples > 0) {
+        std::cout << "\tRound Trip Time: " << RTT.SmoothedRTT / 1000.0 << " ms (jitter " << RTT.Jitter / 1000.0 << " ms)" << std::endl;
+
+    } else {
+        std::cout << "\tRound Trip Time: Unknown" << std::endl;
+
+    }
+
+    std::cout << "\tIncoming Queue: " << Queues.IncomingMessages << " message(s), " << Queues.IncomingBytes << " byte(s)" << std::endl;
+    std::cout << "\tOutgoing Queue: " << Queues.OutgoingMessages << " message(s), " << Queues.OutgoingBytes << " byte(s)" << std::endl;
+    std::cout << "\tCompressed: " << Writes.CompressedMessages << " message(s), " << Writes.UncompressedBytes << " byte(s) down to " << Writes.CompressedBytes << std::endl;
+    std::cout << "\tSocket Buffers: " << Tuning.SendBufferSize << " byte(s) to send, " << Tuning.ReceiveBufferSize << " byte(s) to receive" << std::endl;
+    std::cout << "\tTCP_NODELAY: " << (Tuning.NoDelay ? "On" : "Off") << ", TCP_QUICKACK: " << (Tuning.QuickAck ? "On" : "Off") << std::endl;
+    std::cout << "\tBusy Polling: " << (Tuning.BusyPoll != 0 ? std::to_string(Tuning.BusyPoll)+" us" : "System Default") << std::endl;
+
+    if (Tuning.KeepAliveIdle != 0) {
+        std::cout << "\tTCP Keepalive: After " << Tuning.KeepAliveIdle << " s idle" << std::endl;
+
+    } else {
+        std::cout << "\tTCP Keepalive: Off" << std::endl;
+
+    }
+
     std::cout << std::endl << "\tServer Status: Good" << std::endl;
 
     //List other connected servers.
@@ -107,18 +136,21 @@ void ListMessages(Sockets* const Ptr) {
         return;
     }
 
-    //List all messages.
-    while (Ptr->HasPendingData()) {
-        //Convert each message to a string and then print it.
-        std::cout << std::endl << ConvertToString(Ptr->Read()) << std::endl;
-        Ptr->Pop();
+    //Take all the messages at once, then print each one straight from its buffer.
+    vector<Message> Messages;
+    Ptr->DrainAll(Messages);
+
+    for (std::size_t i = 0; i < Messages.size(); i++) {
+        std::cout << std::endl;
+        std::cout.write(Messages[i].Data(), Messages[i].Size());
+        std::cout << std::endl;
     }
 
     Logger.Debug("Client Tools: ListMessages(): Done.");
     std::cout << "End of messages." << std::endl << std::endl;
 }
 
-string ParseCmdlineOptions(string& ServerAddress, const int& argc, char* argv[]) {
+string ParseCmdlineOptions(string& ServerAddress, bool& UseAsyncHandler, SocketTuning& Tuning, const int& argc, char* argv[]) {
     //Parse commandline options.
     string Temp;
 
@@ -153,6 +185,26 @@ string ParseCmdlineOptions(string& ServerAddress, const int& argc, char* argv[])
             //If we get here, we must be okay.
             ServerAddress.assign(argv[i+1]);
 
+        } else if ((Temp == "-A") || (Temp == "--async")) {
+            //-A, --async.
+            UseAsyncHandler = true;
+
+        } else if (IsTuningOption(Temp)) {
+            //--nodelay, --sndbuf, --rcvbuf, --quickack, --busypoll, --keepalive.
+            //Set the option to next element, if it exists.
+            if (i == argc - 1) {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            //If not specified, exit.
+            if (string(argv[i+1]).substr(0, 1) == "-") {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            ParseTuningOption(Temp, argv[i+1], Tuning);
+
         } else if ((Temp == "-q") || (Temp == "--quiet")) {
             //-q, --quiet.
             Logger.SetLevel("Warning");
@@ -26,8 +26,8 @@ along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
 //Function prototypes.
 void ListConnectedServers();
 void ShowHistory(const std::deque<std::string> &History);
-void ShowStatus();
+void ShowStatus(Sockets* const Ptr);
 void ShowHelp();
 void CheckForMessages(Sockets* const Ptr);
 void ListMessages(Sockets* const Ptr);
-std::string ParseCmdlineOptions(std::string& ServerAddress, const int& argc, char* argv[]);
+std::string ParseCmdlineOptions(std::string& ServerAddress, bool& UseAsyncHandler, SocketTuning& Tuning, const int& argc, char* argv[]);
@@ -0,0 +1,299 @@
+/*
+Compression Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "compressiontools.h"
+#include "frametools.h"
+
+using std::vector;
+
+//The LZ format is a series of sequences, each made of:
+//  1 byte:  Token. The top 4 bits are the number of literals, the bottom 4 the match length minus MinMatch. 15 means
+//           the length continues in extra bytes, each added on until one isn't 255.
+//  Literals, copied straight to the output.
+//  2 bytes: Match offset (little-endian), counting back from the end of the output so far.
+//The last sequence has only literals, and ends the data.
+static const std::size_t MinMatch = 4;
+static const std::size_t MaxOffset = 65535;
+static const int HashBits = 12;
+static const std::size_t SampleSize = 4096;
+
+//Local helpers.
+static std::uint32_t ReadUInt32(const unsigned char* Data) {
+    std::uint32_t Value;
+    std::memcpy(&Value, Data, sizeof(Value));
+
+    return Value;
+
+}
+
+static std::size_t Hash(const std::uint32_t Value) {
+    return (Value * 2654435761U) >> (32 - HashBits);
+
+}
+
+static void WriteLength(vector<char>& Out, std::size_t Length) {
+    //Writes the part of a length that didn't fit in the token.
+    Length -= 15;
+
+    while (Length >= 255) {
+        Out.push_back(static_cast<char>(255));
+        Length -= 255;
+
+    }
+
+    Out.push_back(static_cast<char>(Length));
+
+}
+
+static bool ReadLength(const unsigned char*& Data, const unsigned char* End, std::size_t& Length) {
+    //Adds the extra bytes of a length to Length. Returns false if the data ends first.
+    unsigned char Byte;
+
+    do {
+        if (Data == End) {
+            return false;
+
+        }
+
+        Byte = *Data++;
+        Length += Byte;
+
+    } while (Byte == 255);
+
+    return true;
+
+}
+
+static void WriteSequence(vector<char>& Out, const unsigned char* Literals, const std::size_t LiteralLength, const std::size_t MatchLength, const std::size_t Offset) {
+    //MatchLength is 0 for the last sequence.
+    std::size_t ExtraMatch = MatchLength == 0 ? 0 : MatchLength - MinMatch;
+
+    Out.push_back(static_cast<char>((std::min<std::size_t>(LiteralLength, 15) << 4) | std::min<std::size_t>(ExtraMatch, 15)));
+
+    if (LiteralLength >= 15) {
+        WriteLength(Out, LiteralLength);
+
+    }
+
+    if (LiteralLength > 0) {
+        //Copy with memcpy; inserting unsigned chars into a vector<char> goes a byte at a time.
+        Out.resize(Out.size() + LiteralLength);
+        std::memcpy(Out.data() + Out.size() - LiteralLength, Literals, LiteralLength);
+
+    }
+
+    if (MatchLength == 0) {
+        return;
+
+    }
+
+    Out.push_back(static_cast<char>(Offset & 0xFF));
+    Out.push_back(static_cast<char>(Offset >> 8));
+
+    if (ExtraMatch >= 15) {
+        WriteLength(Out, ExtraMatch);
+
+    }
+}
+
+//Define LZCompressor's functions.
+void LZCompressor::Compress(const char* Data, const std::size_t Size, vector<char>& Out) const {
+    //Finds repeats with a hash table of recently-seen 4 byte sequences. Doesn't look very hard, but it's fast.
+    const unsigned char* In = reinterpret_cast<const unsigned char*>(Data);
+    const std::size_t Start = Out.size();
+    bool Sampled = false;
+    std::size_t Anchor = 0;
+    std::size_t Position = 0;
+
+    //Each thread keeps its own table, so we don't allocate 16 KB per message.
+    static thread_local vector<std::uint32_t> Table;
+
+    Table.assign(std::size_t(1) << HashBits, 0);
+
+    while (Position + MinMatch <= Size) {
+        if (!Sampled && Position >= SampleSize) {
+            //If the first block didn't get any smaller, the rest probably won't either, so just copy it.
+            Sampled = true;
+
+            if ((Out.size() - Start) + (Position - Anchor) >= Position) {
+                break;
+
+            }
+        }
+
+        std::uint32_t Value = ReadUInt32(In + Position);
+        std::size_t Slot = Hash(Value);
+        std::size_t Candidate = Table[Slot];
+
+        Table[Slot] = static_cast<std::uint32_t>(Position);
+
+        if (Candidate >= Position || Position - Candidate > MaxOffset || ReadUInt32(In + Candidate) != Value) {
+            //Skip ahead faster the longer we go without a match, so incompressible data doesn't cost much.
+            Position += 1 + ((Position - Anchor) >> 6);
+            continue;
+
+        }
+
+        std::size_t Length = MinMatch;
+
+        while (Position + Length < Size && In[Candidate + Length] == In[Position + Length]) {
+            Length++;
+
+        }
+
+        WriteSequence(Out, In + Anchor, Position - Anchor, Length, Position - Candidate);
+
+        Position += Length;
+        Anchor = Position;
+
+    }
+
+    WriteSequence(Out, In + Anchor, Size - Anchor, 0, 0);
+
+}
+
+bool LZCompressor::Decompress(const char* Data, const std::size_t Size, char* Out, const std::size_t OutSize) const {
+    //Checks every length and offset against the buffers, because Data came from the network.
+    const unsigned char* In = reinterpret_cast<const unsigned char*>(Data);
+    const unsigned char* InEnd = In + Size;
+    std::size_t Written = 0;
+
+    while (In < InEnd) {
+        unsigned char Token = *In++;
+        std::size_t LiteralLength = Token >> 4;
+
+        if (LiteralLength == 15 && !ReadLength(In, InEnd, LiteralLength)) {
+            return false;
+
+        }
+
+        if (LiteralLength > static_cast<std::size_t>(InEnd - In) || LiteralLength > OutSize - Written) {
+            return false;
+
+        }
+
+        std::copy(In, In + LiteralLength, Out + Written);
+        In += LiteralLength;
+        Written += LiteralLength;
+
+        if (In == InEnd) {
+            //That was the last sequence.
+            break;
+
+        }
+
+        if (InEnd - In < 2) {
+            return false;
+
+        }
+
+        std::size_t Offset = In[0] | (static_cast<std::size_t>(In[1]) << 8);
+        std::size_t MatchLength = Token & 0x0F;
+
+        In += 2;
+
+        if (MatchLength == 15 && !ReadLength(In, InEnd, MatchLength)) {
+            return false;
+
+        }
+
+        MatchLength += MinMatch;
+
+        if (Offset == 0 || Offset > Written || MatchLength > OutSize - Written) {
+            return false;
+
+        }
+
+        //The match can overlap what it's writing (that's how runs are encoded), so copy a byte at a time.
+        for (std::size_t i = 0; i < MatchLength; i++) {
+            Out[Written] = Out[Written - Offset];
+            Written++;
+
+        }
+    }
+
+    return Written == OutSize;
+
+}
+
+//Define other functions.
+bool CompressPayload(const Compressor& Codec, const Message& Payload, Message& Result) {
+    //Compresses Payload, with the header the peer needs to decompress it.
+    vector<char> Buffer(CompressionHeaderSize);
+
+    Buffer.reserve(CompressionHeaderSize + Payload.Size() + Payload.Size() / 255 + 16);
+    Buffer[0] = Codec.GetID();
+    EncodeUInt32(static_cast<std::uint32_t>(Payload.Size()), Buffer.data() + 1);
+
+    Codec.Compress(Payload.Data(), Payload.Size(), Buffer);
+
+    if (Buffer.size() >= Payload.Size()) {
+        return false;
+
+    }
+
+    Result = Message(std::move(Buffer));
+
+    return true;
+
+}
+
+void DecompressPayload(const vector<std::shared_ptr<Compressor> >& Codecs, const char* Data, const std::size_t Size, vector<char>& Out) {
+    //Decompresses a payload made by CompressPayload() with any codec in Codecs.
+    if (Size < CompressionHeaderSize) {
+        throw std::runtime_error("Malformed compressed frame");
+
+    }
+
+    std::shared_ptr<Compressor> Codec;
+
+    for (std::size_t i = 0; i < Codecs.size(); i++) {
+        if (Codecs[i]->GetID() == Data[0]) {
+            Codec = Codecs[i];
+            break;
+
+        }
+    }
+
+    if (Codec == nullptr) {
+        throw std::runtime_error("Unknown compression codec");
+
+    }
+
+    std::uint32_t Length = DecodeUInt32(Data + 1);
+
+    if (Length > MaxFramePayloadSize) {
+        throw std::runtime_error("Compressed frame too large");
+
+    }
+
+    Out.resize(Length);
+
+    if (!Codec->Decompress(Data + CompressionHeaderSize, Size - CompressionHeaderSize, Out.data(), Length)) {
+        throw std::runtime_error("Corrupt compressed frame");
+
+    }
+}
@@ -0,0 +1,65 @@
+/*
+Compression Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "messagetools.h"
+
+//A compressed payload starts with a header of its own, followed by whatever the codec produced:
+//  1 byte:  Codec ID.
+//  4 bytes: Uncompressed length (network byte order).
+const std::size_t CompressionHeaderSize = 5;
+
+//Class definitions.
+//A compression codec. Sockets can share one, so Compress() and Decompress() must be safe to call from several threads
+//at once.
+class Compressor {
+public:
+    virtual ~Compressor() {};
+
+    virtual char GetID() const = 0; //Must be the same on both sides, and not 0.
+    virtual std::string GetName() const = 0;
+
+    //Appends the compressed form of Size bytes at Data to Out.
+    virtual void Compress(const char* Data, const std::size_t Size, std::vector<char>& Out) const = 0;
+
+    //Decompresses Size bytes at Data into the OutSize bytes at Out, which is exactly the uncompressed length. Returns
+    //false if the data is corrupt.
+    virtual bool Decompress(const char* Data, const std::size_t Size, char* Out, const std::size_t OutSize) const = 0;
+};
+
+//The built-in codec. A byte-oriented LZ77 in the style of LZ4: fast, with no entropy coding, so it's cheap enough to use
+//on every large message. If the first 4 KB don't get any smaller, it copies the rest as it is.
+class LZCompressor : public Compressor {
+public:
+    char GetID() const { return 1; }
+    std::string GetName() const { return "LZ"; }
+
+    void Compress(const char* Data, const std::size_t Size, std::vector<char>& Out) const;
+    bool Decompress(const char* Data, const std::size_t Size, char* Out, const std::size_t OutSize) const;
+};
+
+//Function prototypes.
+bool CompressPayload(const Compressor& Codec, const Message& Payload, Message& Result); //Returns false (leaving Result alone) if it didn't get any smaller.
+void DecompressPayload(const std::vector<std::shared_ptr<Compressor> >& Codecs, const char* Data, const std::size_t Size, std::vector<char>& Out); //Throws std::runtime_error if the payload is corrupt.
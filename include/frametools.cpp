@@ -0,0 +1,320 @@
+/*
+Frame Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <string>
+
+#include "frametools.h"
+
+using std::vector;
+
+//Byte order helpers.
+void EncodeUInt32(const std::uint32_t Value, char* Buffer) {
+    //Writes Value most significant byte first.
+    Buffer[0] = static_cast<char>((Value >> 24) & 0xFF);
+    Buffer[1] = static_cast<char>((Value >> 16) & 0xFF);
+    Buffer[2] = static_cast<char>((Value >> 8) & 0xFF);
+    Buffer[3] = static_cast<char>(Value & 0xFF);
+
+}
+
+std::uint32_t DecodeUInt32(const char* Buffer) {
+    const unsigned char* Bytes = reinterpret_cast<const unsigned char*>(Buffer);
+
+    return (static_cast<std::uint32_t>(Bytes[0]) << 24)
+         | (static_cast<std::uint32_t>(Bytes[1]) << 16)
+         | (static_cast<std::uint32_t>(Bytes[2]) << 8)
+         | static_cast<std::uint32_t>(Bytes[3]);
+
+}
+
+void EncodeFrameHeader(const FrameHeader& Header, char* Buffer) {
+    //Writes Header into the FrameHeaderSize bytes at Buffer.
+    Buffer[0] = static_cast<char>(FrameProtocolVersion);
+    Buffer[1] = Header.Type;
+    Buffer[2] = Header.Compressed ? FrameFlagCompressed : 0;
+    Buffer[3] = static_cast<char>(Header.Channel);
+    EncodeUInt32(Header.Length, Buffer + 4);
+    EncodeUInt32(Header.Sequence, Buffer + 8);
+
+}
+
+FrameHeader DecodeFrameHeader(const char* Buffer) {
+    //Reads a header from the FrameHeaderSize bytes at Buffer. Doesn't check the version or flags: FrameDecoder does.
+    FrameHeader Header;
+
+    Header.Type = Buffer[1];
+    Header.Compressed = (Buffer[2] & FrameFlagCompressed) != 0;
+    Header.Channel = static_cast<std::uint8_t>(Buffer[3]);
+    Header.Length = DecodeUInt32(Buffer + 4);
+    Header.Sequence = DecodeUInt32(Buffer + 8);
+
+    return Header;
+
+}
+
+bool SequenceIsAfter(const std::uint32_t Sequence, const std::uint32_t Other) {
+    //True if Sequence comes after Other, allowing for the numbers wrapping around.
+    return static_cast<std::int32_t>(Sequence - Other) > 0;
+
+}
+
+static void EncodeUInt64(const std::uint64_t Value, char* Buffer) {
+    EncodeUInt32(static_cast<std::uint32_t>(Value >> 32), Buffer);
+    EncodeUInt32(static_cast<std::uint32_t>(Value & 0xFFFFFFFF), Buffer + 4);
+
+}
+
+static std::uint64_t DecodeUInt64(const char* Buffer) {
+    return (static_cast<std::uint64_t>(DecodeUInt32(Buffer)) << 32) | DecodeUInt32(Buffer + 4);
+
+}
+
+void EncodeSessionToken(const std::uint64_t Token, char* Buffer) {
+    //Writes Token into the SessionTokenSize bytes at Buffer.
+    EncodeUInt64(Token, Buffer);
+
+}
+
+std::uint64_t DecodeSessionToken(const char* Buffer) {
+    return DecodeUInt64(Buffer);
+
+}
+
+void EncodeTimestamp(const std::uint64_t Timestamp, char* Buffer) {
+    //Writes Timestamp into the TimestampSize bytes at Buffer. Only the side that made it needs to understand it.
+    EncodeUInt64(Timestamp, Buffer);
+
+}
+
+std::uint64_t DecodeTimestamp(const char* Buffer) {
+    return DecodeUInt64(Buffer);
+
+}
+
+//Define FrameDecoder's functions.
+//---------- Decoding Functions ----------
+char* FrameDecoder::PrepareRead(std::size_t& Space) {
+    //Makes sure there's room for a decent read, and for the whole of the frame we're part of the way through.
+    std::size_t Needed = MinReadSpace;
+
+    if (BufferedBytes() >= FrameHeaderSize) {
+        FrameHeader NextHeader = DecodeFrameHeader(Ring->ReadPointer());
+
+        //A corrupt length is caught by PeekFrame(). Don't make a huge ring for it first.
+        if (NextHeader.Length <= MaxFramePayloadSize && FrameHeaderSize + NextHeader.Length > BufferedBytes()) {
+            Needed = std::max<std::size_t>(Needed, FrameHeaderSize + NextHeader.Length - BufferedBytes());
+
+        }
+    }
+
+    MakeRoom(Needed);
+
+    return Ring->WriteSpace(Space);
+
+}
+
+void FrameDecoder::Commit(const std::size_t Length) {
+    Ring->Commit(Length);
+
+}
+
+void FrameDecoder::Feed(const char* Data, const std::size_t Length) {
+    //The free space is contiguous, so this is one copy however it wraps.
+    std::size_t Space;
+
+    MakeRoom(Length);
+    std::memcpy(Ring->WriteSpace(Space), Data, Length);
+    Ring->Commit(Length);
+
+}
+
+bool FrameDecoder::PeekFrame(FrameHeader& Header, const char*& Payload) {
+    //Finds the next complete frame, if we have one, and leaves it where it is.
+    if (BufferedBytes() < FrameHeaderSize) {
+        return false;
+
+    }
+
+    const char* Start = Ring->ReadPointer();
+    FrameHeader NextHeader = DecodeFrameHeader(Start);
+
+    if (static_cast<std::uint8_t>(Start[0]) != FrameProtocolVersion) {
+        //The peer is talking a different version of the protocol. Nothing after this can be trusted.
+        throw std::runtime_error("Unsupported protocol version "+std::to_string(static_cast<std::uint8_t>(Start[0])));
+
+    } else if ((Start[2] & ~FrameFlagsKnown) != 0) {
+        throw std::runtime_error("Unknown frame flags");
+
+    } else if (NextHeader.Length > MaxFramePayloadSize) {
+        //The stream is corrupt. Don't let it make us allocate huge amounts of memory.
+        throw std::runtime_error("Frame too large");
+
+    } else if (NextHeader.Type < FrameTypeData || NextHeader.Type > FrameTypeGoodbye) {
+        throw std::runtime_error("Unknown frame type");
+
+    } else if (NextHeader.Compressed && NextHeader.Type != FrameTypeData) {
+        throw std::runtime_error("Compressed control frame");
+
+    } else if (NextHeader.Channel != 0 && (NextHeader.Type != FrameTypeData || NextHeader.Sequence != 0)) {
+        //Only channel 0 has sequence numbers, so reliable messages are always acknowledged in order.
+        throw std::runtime_error("Control or reliable frame on a logical channel");
+
+    } else if (NextHeader.Type == FrameTypeHello && (NextHeader.Length < SessionTokenSize || NextHeader.Length > SessionTokenSize + MaxHelloCodecs)) {
+        throw std::runtime_error("Malformed hello frame");
+
+    } else if ((NextHeader.Type == FrameTypePing || NextHeader.Type == FrameTypePong) && NextHeader.Length != TimestampSize) {
+        throw std::runtime_error("Malformed heartbeat frame");
+
+    } else if (NextHeader.Type == FrameTypeGoodbye && NextHeader.Length != 1) {
+        throw std::runtime_error("Malformed goodbye frame");
+
+    }
+
+    if (BufferedBytes() < FrameHeaderSize + NextHeader.Length) {
+        //Wait for the rest of the payload.
+        return false;
+
+    }
+
+    Header = NextHeader;
+    Payload = Start + FrameHeaderSize;
+    PeekedSize = FrameHeaderSize + NextHeader.Length;
+
+    return true;
+
+}
+
+void FrameDecoder::Consume() {
+    Ring->Consume(PeekedSize);
+    PeekedSize = 0;
+
+}
+
+Message FrameDecoder::TakePayload() {
+    //The payload stays in the ring until the application has finished with it.
+    Ring->Consume(FrameHeaderSize);
+    Message Payload = Ring->Lease(PeekedSize - FrameHeaderSize);
+    PeekedSize = 0;
+
+    return Payload;
+
+}
+
+bool FrameDecoder::GetFrame(FrameHeader& Header, vector<char>& Payload) {
+    //Pops the next complete frame, if we have one.
+    const char* Start;
+
+    if (!PeekFrame(Header, Start)) {
+        return false;
+
+    }
+
+    Payload.assign(Start, Start + Header.Length);
+    Consume();
+
+    return true;
+
+}
+
+//---------- Other Functions ----------
+void FrameDecoder::Reset() {
+    //Throws away any partial frames (used when the connection is reset). Messages already handed out are still valid.
+    if (Ring != nullptr) {
+        Ring->Clear();
+
+    }
+
+    PeekedSize = 0;
+
+}
+
+std::size_t FrameDecoder::BufferedBytes() {
+    return (Ring != nullptr) ? Ring->Readable() : 0;
+
+}
+
+//---------- Private Functions ----------
+void FrameDecoder::MakeRoom(const std::size_t Needed) {
+    //Makes sure there are at least Needed bytes free in the ring. If the application is still holding on to the
+    //messages in the way, or the ring is too small, moves whatever we haven't parsed yet to another ring. The old one
+    //stays alive until the application has finished with its messages, and might be used again after that.
+    std::size_t Space = 0;
+
+    if (Ring != nullptr) {
+        Ring->WriteSpace(Space);
+
+    }
+
+    if (Space >= Needed) {
+        return;
+
+    }
+
+    std::size_t Unparsed = BufferedBytes();
+    std::size_t Size = std::max(DefaultReceiveRingSize, Unparsed + Needed);
+    std::shared_ptr<ReceiveRing> NewRing;
+
+    //If it's messages the application hasn't finished with that are in the way, it's behind, so make the next ring
+    //bigger. That way, a backlog fits in one ring, instead of needing a new one every few messages.
+    std::size_t Grown = Size;
+
+    if (Ring != nullptr) {
+        Grown = std::max(Size, std::min(2 * Ring->GetSize(), MaxReceiveRingSize));
+
+    }
+
+    for (std::size_t i = 0; i < Retired.size(); i++) {
+        if (Retired[i]->GetSize() >= Size && Retired[i]->IsIdle()) {
+            NewRing = Retired[i];
+            Retired.erase(Retired.begin() + i);
+            break;
+
+        }
+    }
+
+    if (NewRing == nullptr) {
+        NewRing = std::make_shared<ReceiveRing>(Grown);
+
+    }
+
+    if (Ring != nullptr) {
+        std::memcpy(NewRing->WriteSpace(Space), Ring->ReadPointer(), Unparsed);
+        NewRing->Commit(Unparsed);
+        Ring->Clear();
+
+        //Keep the old ring to use again, unless it's too small to be worth it.
+        if (Ring->GetSize() >= DefaultReceiveRingSize) {
+            if (Retired.size() == MaxRetiredRings) {
+                Retired.erase(Retired.begin());
+
+            }
+
+            Retired.push_back(Ring);
+
+        }
+    }
+
+    Ring = NewRing;
+
+}
@@ -0,0 +1,136 @@
+/*
+Frame Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "messagetools.h"
+#include "ringtools.h"
+
+//Every frame on the wire has a fixed-layout header, followed by the payload itself:
+//  1 byte:  Protocol version (FrameProtocolVersion).
+//  1 byte:  Frame type (see below).
+//  1 byte:  Flags (see below).
+//  1 byte:  Logical channel. Always 0 for control frames.
+//  4 bytes: Payload length (network byte order).
+//  4 bytes: Message ID, or sequence number (network byte order). 0 if the sender doesn't want an acknowledgement.
+//The multi-byte fields are 4-byte aligned, so headers can be read where they lie in a receive buffer.
+const std::size_t FrameHeaderSize = 12;
+
+//Peers talking any other version are refused, rather than misread.
+const std::uint8_t FrameProtocolVersion = 1;
+
+//Refuse frames bigger than this, so a corrupt header can't make us allocate huge amounts of memory.
+const std::uint32_t MaxFramePayloadSize = 16 * 1024 * 1024;
+
+//Frame types.
+const char FrameTypeData = 0; //A message for the application.
+const char FrameTypeAck = 1;  //Acknowledges every sequence number up to and including the one in the header. No payload.
+const char FrameTypeHello = 2; //Starts or resumes a session. The payload is the session token, then the IDs of the compression codecs we can decompress (if any). The sequence number is the last one we received.
+const char FrameTypePing = 3;  //Heartbeat. The payload is a timestamp, which the peer sends back in a Pong.
+const char FrameTypePong = 4;  //Reply to a Ping, with the Ping's timestamp.
+const char FrameTypeControl = 5; //An application control message. Sent ahead of every channel's messages, and handed to the OnControl callback instead of being queued.
+const char FrameTypeGoodbye = 6; //The sender is closing the connection on purpose. The payload is one of the reasons below.
+
+//Flags. Only data frames can be compressed.
+const char FrameFlagCompressed = 0x01;
+const char FrameFlagsKnown = FrameFlagCompressed;
+
+//Reasons for saying goodbye.
+const char GoodbyeClosing = 0;      //The application is closing the connection, and won't resume the session.
+const char GoodbyeShuttingDown = 1; //The server is shutting down.
+
+//Session tokens and timestamps are 8 bytes (network byte order). A session token of 0 means "no session yet".
+const std::size_t SessionTokenSize = 8;
+const std::size_t TimestampSize = 8;
+
+//A Hello can list up to this many compression codecs.
+const std::size_t MaxHelloCodecs = 16;
+
+//The least room FrameDecoder::PrepareRead() gives for a read.
+const std::size_t MinReadSpace = 4096;
+
+//Rings the decoder has moved on from, but might use again once the application has finished with their messages.
+const std::size_t MaxRetiredRings = 4;
+
+//Structs.
+struct FrameHeader {
+    std::uint32_t Length = 0;
+    char Type = FrameTypeData;
+    std::uint32_t Sequence = 0;
+    std::uint8_t Channel = 0;
+    bool Compressed = false;
+};
+
+struct Frame {
+    FrameHeader Header;
+    Message Payload;
+};
+
+//Function prototypes.
+void EncodeUInt32(const std::uint32_t Value, char* Buffer);
+std::uint32_t DecodeUInt32(const char* Buffer);
+void EncodeFrameHeader(const FrameHeader& Header, char* Buffer);
+FrameHeader DecodeFrameHeader(const char* Buffer);
+bool SequenceIsAfter(const std::uint32_t Sequence, const std::uint32_t Other);
+void EncodeSessionToken(const std::uint64_t Token, char* Buffer);
+std::uint64_t DecodeSessionToken(const char* Buffer);
+void EncodeTimestamp(const std::uint64_t Timestamp, char* Buffer);
+std::uint64_t DecodeTimestamp(const char* Buffer);
+
+//Class definitions.
+//Reassembles frames from a byte stream, in a ReceiveRing, so the socket can be read straight into it and frames can be
+//parsed where they lie, even if they wrap around the end of the ring. If the ring fills up with messages the
+//application hasn't finished with, or a frame is too big for it, the decoder moves on to another one.
+class FrameDecoder {
+public:
+    //Read data from the socket straight into Space bytes at PrepareRead(), then call Commit() with how much arrived.
+    //Partial frames are kept until the rest arrives. Throws boost::system::system_error if we need a new ring and
+    //can't make one.
+    char* PrepareRead(std::size_t& Space);
+    void Commit(const std::size_t Length);
+
+    //Copies data that has already been read somewhere else.
+    void Feed(const char* Data, const std::size_t Length);
+
+    //Points Payload at the next complete frame's payload, where it lies in our buffer, without copying it. Returns
+    //false if there isn't one yet. Payload is valid until the next call to Consume(), Feed() or Reset().
+    bool PeekFrame(FrameHeader& Header, const char*& Payload);
+    void Consume(); //Drops the frame from PeekFrame().
+    Message TakePayload(); //Like Consume(), but returns the payload as a view of the ring instead of throwing it away.
+
+    //Pops the next complete frame, copying its payload. Returns false if there isn't one yet.
+    bool GetFrame(FrameHeader& Header, std::vector<char>& Payload);
+
+    void Reset();
+    std::size_t BufferedBytes();
+
+private:
+    //Variables.
+    std::shared_ptr<ReceiveRing> Ring;
+    std::vector<std::shared_ptr<ReceiveRing> > Retired;
+    std::size_t PeekedSize = 0;
+
+    //Private function declarations.
+    void MakeRoom(const std::size_t Needed);
+};
@@ -0,0 +1,271 @@
+/*
+Message Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "messagetools.h"
+
+using std::string;
+using std::vector;
+
+const std::size_t Message::InlineCapacity;
+
+//Blocks.
+//The bytes of a copied message, straight after the count, in one allocation.
+class HeapBlock : public MessageBlock {
+public:
+    static HeapBlock* Create(const char* Data, const std::size_t Size) {
+        void* Memory = ::operator new(sizeof(HeapBlock) + Size);
+        HeapBlock* Block = new (Memory) HeapBlock();
+
+        std::memcpy(Block->Bytes(), Data, Size);
+
+        return Block;
+    }
+
+    char* Bytes() { return reinterpret_cast<char*>(this + 1); }
+
+protected:
+    void Free() {
+        this->~HeapBlock();
+        ::operator delete(this);
+
+    }
+};
+
+//A std::vector we took over, so it can be handed back to a buffer pool.
+class VectorBlock : public MessageBlock {
+public:
+    explicit VectorBlock(vector<char>&& TheBuffer) : Buffer(std::move(TheBuffer)) {}
+
+    vector<char> Buffer;
+
+protected:
+    void Free() { delete this; }
+};
+
+//Define Message's functions.
+//---------- Constructors ----------
+Message::Message(const string& Str) : Message(Str.data(), Str.size()) {}
+
+Message::Message(const char* Data, const std::size_t Size) : Length(Size) {
+    if (Size <= InlineCapacity) {
+        std::copy(Data, Data + Size, Inline);
+
+    } else {
+        HeapBlock* NewBlock = HeapBlock::Create(Data, Size);
+
+        Block = NewBlock;
+        Bytes = NewBlock->Bytes();
+        Kind = StorageHeap;
+
+    }
+}
+
+Message::Message(vector<char>&& Buffer) : Length(Buffer.size()) {
+    if (Length <= InlineCapacity) {
+        std::copy(Buffer.begin(), Buffer.end(), Inline);
+
+    } else {
+        VectorBlock* NewBlock = new VectorBlock(std::move(Buffer));
+
+        Block = NewBlock;
+        Bytes = NewBlock->Buffer.data();
+        Kind = StorageVector;
+
+    }
+}
+
+Message::~Message() {
+    Release();
+
+}
+
+Message::Message(const Message& that) : Block(that.Block), Bytes(that.Bytes), Length(that.Length), Kind(that.Kind) {
+    if (Block) {
+        Block->AddReference();
+
+    } else {
+        std::copy(that.Inline, that.Inline + Length, Inline);
+
+    }
+}
+
+Message& Message::operator = (const Message& rhs) {
+    if (this != &rhs) {
+        //Take the new reference first, in case rhs shares our block.
+        if (rhs.Block) {
+            rhs.Block->AddReference();
+
+        }
+
+        Release();
+
+        Block = rhs.Block;
+        Bytes = rhs.Bytes;
+        Length = rhs.Length;
+        Kind = rhs.Kind;
+
+        if (!Block) {
+            std::copy(rhs.Inline, rhs.Inline + Length, Inline);
+
+        }
+    }
+
+    return *this;
+
+}
+
+Message::Message(Message&& that) : Block(that.Block), Bytes(that.Bytes), Length(that.Length), Kind(that.Kind) {
+    if (!Block) {
+        std::copy(that.Inline, that.Inline + Length, Inline);
+
+    }
+
+    that.Block = nullptr;
+    that.Bytes = nullptr;
+    that.Length = 0;
+    that.Kind = StorageInline;
+
+}
+
+Message& Message::operator = (Message&& rhs) {
+    if (this != &rhs) {
+        Release();
+
+        Block = rhs.Block;
+        Bytes = rhs.Bytes;
+        Length = rhs.Length;
+        Kind = rhs.Kind;
+
+        if (!Block) {
+            std::copy(rhs.Inline, rhs.Inline + Length, Inline);
+
+        }
+
+        rhs.Block = nullptr;
+        rhs.Bytes = nullptr;
+        rhs.Length = 0;
+        rhs.Kind = StorageInline;
+
+    }
+
+    return *this;
+
+}
+
+Message Message::Adopt(vector<char>& Buffer) {
+    //Wraps a freshly-filled receive buffer. Small messages are copied inline, so the caller can fill Buffer again.
+    if (Buffer.size() <= InlineCapacity) {
+        return Message(Buffer.data(), Buffer.size());
+
+    }
+
+    Message Result(std::move(Buffer));
+    Buffer = vector<char>();
+
+    return Result;
+
+}
+
+Message Message::Wrap(MessageBlock* Owner, const char* Data, const std::size_t Size) {
+    //Refers to memory someone else owns, without copying it. Small messages are copied inline instead, so they don't
+    //hold on to it.
+    if (Size <= InlineCapacity) {
+        Message Result(Data, Size);
+        Owner->RemoveReference();
+
+        return Result;
+
+    }
+
+    Message Result;
+    Result.Block = Owner;
+    Result.Bytes = Data;
+    Result.Length = Size;
+    Result.Kind = StorageView;
+
+    return Result;
+
+}
+
+//---------- Other Functions ----------
+Message Message::Slice(const std::size_t Start, const std::size_t Count) const {
+    //Returns a view of Count bytes from Start. Shares our buffer rather than copying it, unless the slice is small.
+    if (Start > Length || Count > Length - Start) {
+        throw std::out_of_range("Slice is outside the message");
+
+    }
+
+    if (!Block || Count <= InlineCapacity) {
+        return Message(Data() + Start, Count);
+
+    }
+
+    Message Result(*this);
+    Result.Bytes += Start;
+    Result.Length = Count;
+
+    return Result;
+
+}
+
+string Message::ToString() const {
+    return string(Data(), Length);
+
+}
+
+bool Message::operator == (const string& Str) const {
+    return Str.size() == Length && std::equal(Str.begin(), Str.end(), Data());
+
+}
+
+bool Message::TakeBuffer(vector<char>& Buffer) {
+    //Gets our vector back for reuse once nobody else can see it. Only safe if no other thread is copying this Message.
+    if (Kind != StorageVector || Block->IsShared()) {
+        return false;
+
+    }
+
+    Buffer = std::move(static_cast<VectorBlock*>(Block)->Buffer);
+    Release();
+
+    return true;
+
+}
+
+//---------- Private Functions ----------
+void Message::Release() {
+    //Drops our reference to the block, and leaves us empty.
+    if (Block) {
+        Block->RemoveReference();
+
+    }
+
+    Block = nullptr;
+    Bytes = nullptr;
+    Length = 0;
+    Kind = StorageInline;
+
+}
@@ -0,0 +1,120 @@
+/*
+Message Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Class definitions.
+//A reference-counted block of memory that Messages share. The count lives in the block, next to (or inside) whatever
+//owns the bytes, so sharing a payload never needs an allocation of its own. Free() is called by whichever thread drops
+//the last reference.
+class MessageBlock {
+public:
+    //Constructors. A new block has one reference, which belongs to whoever made it.
+    MessageBlock() : References(1) {}
+
+    //Other constructors.
+    MessageBlock(const MessageBlock& that) = delete;
+    MessageBlock& operator = (const MessageBlock& rhs) = delete;
+
+    //Reference counting functions.
+    void AddReference() { References.fetch_add(1, std::memory_order_relaxed); }
+    void RemoveReference() { if (References.fetch_sub(1, std::memory_order_acq_rel) == 1) { Free(); } }
+    bool IsShared() const { return References.load(std::memory_order_acquire) != 1; }
+
+protected:
+    //Destructor. Blocks are only destroyed by Free().
+    virtual ~MessageBlock() {}
+
+    virtual void Free() = 0;
+    void Reuse() { References.store(1, std::memory_order_relaxed); } //For blocks that are recycled rather than freed.
+
+private:
+    //Variables.
+    std::atomic<std::size_t> References;
+};
+
+//An immutable message payload. Copying a Message doesn't copy the payload: copies (and slices) share one reference-counted
+//buffer. Messages of up to InlineCapacity bytes are stored inside the Message itself, so they never touch the heap.
+//Larger ones are copied into a single allocation that holds both the count and the bytes. A Message can also take over a
+//std::vector, or be a view of memory owned by something else (such as a receive ring), which is told when the last
+//copy has gone.
+class Message {
+public:
+    static const std::size_t InlineCapacity = 32;
+
+    //Constructors.
+    Message() {};
+    explicit Message(const std::string& Str); //Copies Str.
+    Message(const char* Data, const std::size_t Size); //Copies Size bytes from Data.
+    explicit Message(std::vector<char>&& Buffer); //Takes Buffer without copying it.
+
+    //Destructor.
+    ~Message();
+
+    //Copying shares the payload. Moving leaves the other Message empty.
+    Message(const Message& that);
+    Message& operator = (const Message& rhs);
+    Message(Message&& that);
+    Message& operator = (Message&& rhs);
+
+    //Named constructors.
+    static Message Adopt(std::vector<char>& Buffer); //Like Message(std::move(Buffer)), but small messages are copied inline and Buffer is left alone to be reused.
+    static Message Wrap(MessageBlock* Owner, const char* Data, const std::size_t Size); //A view of Size bytes at Data. Takes over the caller's reference to Owner, which is freed once every copy has gone.
+
+    //Info getter functions.
+    const char* Data() const { return Block ? Bytes : Inline; }
+    std::size_t Size() const { return Length; }
+    bool Empty() const { return Length == 0; }
+    bool IsView() const { return Kind == StorageView; }
+    bool HasBuffer() const { return Kind == StorageVector; } //True if we took over a std::vector, which TakeBuffer() can hand back.
+    const char* begin() const { return Data(); }
+    const char* end() const { return Data() + Length; }
+
+    //Other functions.
+    Message Slice(const std::size_t Start, const std::size_t Count) const; //A view of part of this message. Throws std::out_of_range if it doesn't fit.
+    std::string ToString() const;
+    bool operator == (const std::string& Str) const;
+    bool operator != (const std::string& Str) const { return !(*this == Str); }
+    bool TakeBuffer(std::vector<char>& Buffer); //If nothing else shares the vector we took over, moves it into Buffer and empties us.
+
+private:
+    //Where the bytes are.
+    enum StorageKind : std::uint8_t {
+        StorageInline,
+        StorageHeap,
+        StorageVector,
+        StorageView
+    };
+
+    //Variables. Block is null for inline messages, and Bytes points at our part of its memory otherwise.
+    MessageBlock* Block = nullptr;
+    const char* Bytes = nullptr;
+    std::size_t Length = 0;
+    StorageKind Kind = StorageInline;
+    char Inline[InlineCapacity];
+
+    //Private function declarations.
+    void Release();
+};
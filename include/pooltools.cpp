@@ -0,0 +1,88 @@
+/*
+Pool Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include "pooltools.h"
+
+using std::vector;
+
+//Define BufferPool's functions.
+//---------- Acquire/Release Functions ----------
+vector<char> BufferPool::Acquire() {
+    //Returns an empty buffer with at least BufferSize bytes of capacity, from the pool if possible.
+    vector<char> Buffer;
+
+    if (!FreeBuffers.Empty()) {
+        Buffer = std::move(FreeBuffers.Front());
+        FreeBuffers.Pop();
+        Hits++;
+
+    } else {
+        Buffer.reserve(BufferSize);
+        Misses++;
+
+    }
+
+    //Keep track of the most buffers that have been in use at once.
+    std::uint64_t Current = ++InUse;
+    std::uint64_t Highest = HighWaterMark;
+
+    while (Current > Highest && !HighWaterMark.compare_exchange_weak(Highest, Current));
+
+    return Buffer;
+
+}
+
+void BufferPool::Release(vector<char>&& Buffer) {
+    //Gives a buffer back once the message in it has been dealt with. Buffers that grew to hold a large message are
+    //freed instead, so one big message doesn't leave the pool holding on to lots of memory.
+    InUse--;
+
+    if (Buffer.capacity() == 0 || Buffer.capacity() > BufferSize) {
+        return;
+
+    }
+
+    Buffer.clear();
+
+    //If the pool is already full, just let the buffer go.
+    FreeBuffers.Push(std::move(Buffer));
+
+}
+
+void BufferPool::Forget() {
+    //The application has kept a buffer for itself, so it won't be coming back.
+    InUse--;
+
+}
+
+//---------- Info getter functions ----------
+BufferPoolStatistics BufferPool::GetStatistics() {
+    BufferPoolStatistics Stats;
+
+    Stats.Hits = Hits;
+    Stats.Misses = Misses;
+    Stats.InUse = InUse;
+    Stats.HighWaterMark = HighWaterMark;
+
+    return Stats;
+
+}
@@ -0,0 +1,69 @@
+/*
+Pool Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "queuetools.h"
+
+//Structs.
+struct BufferPoolStatistics {
+    std::uint64_t Hits = 0;          //Buffers handed out from the pool.
+    std::uint64_t Misses = 0;        //Buffers we had to allocate because the pool was empty.
+    std::uint64_t InUse = 0;         //Buffers handed out and not released yet.
+    std::uint64_t HighWaterMark = 0; //The most buffers that have ever been in use at once.
+};
+
+//Class definitions.
+//Recycles fixed-size receive buffers between the handler thread, which acquires them, and the application thread, which
+//releases them once it has finished with the message in them. The free list is an SPSCQueue, so neither side takes a lock.
+class BufferPool {
+public:
+    //Constructors.
+    explicit BufferPool(const std::size_t Capacity = 1024, const std::size_t TheBufferSize = 4096)
+        : FreeBuffers(Capacity), BufferSize(TheBufferSize) {}
+
+    //Other constructors.
+    BufferPool(const BufferPool& that) = delete;
+    BufferPool& operator = (const BufferPool& rhs) = delete;
+
+    //Handler thread only.
+    std::vector<char> Acquire();
+
+    //Application thread only. Call Forget() instead of Release() if the application keeps the buffer.
+    void Release(std::vector<char>&& Buffer);
+    void Forget();
+
+    //Info getter functions.
+    BufferPoolStatistics GetStatistics();
+
+private:
+    //Variables.
+    SPSCQueue<std::vector<char> > FreeBuffers;
+    const std::size_t BufferSize;
+
+    std::atomic<std::uint64_t> Hits{0};
+    std::atomic<std::uint64_t> Misses{0};
+    std::atomic<std::uint64_t> InUse{0};
+    std::atomic<std::uint64_t> HighWaterMark{0};
+};
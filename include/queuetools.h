@@ -0,0 +1,218 @@
+/*
+Queue Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+//Assumed size of a cache line. Keeps the producer's and consumer's indexes from sharing one.
+const std::size_t CacheLineSize = 64;
+
+//Class definitions.
+//Bounded single-producer/single-consumer ring buffer.
+//Exactly one thread may call Push() and PushMany(), and exactly one (other) thread may call Front(), At(), Pop(),
+//PopMany() and Clear().
+//Empty(), Full() and Size() are safe from either thread.
+template <typename T>
+class SPSCQueue {
+public:
+    //Constructors. Capacity is rounded up to a power of two.
+    explicit SPSCQueue(const std::size_t MinCapacity = 1024) : Capacity(RoundUp(MinCapacity)), Mask(Capacity - 1), Slots(Capacity) {}
+
+    //Other constructors.
+    SPSCQueue(const SPSCQueue& that) = delete; //Other threads hold references to the slots, so don't allow copying.
+    SPSCQueue& operator = (const SPSCQueue& rhs) = delete;
+
+    //Producer functions.
+    bool Push(const T& Item) {
+        //Copies Item into the next free slot. Returns false if the queue is full.
+        T Temp(Item);
+        return Push(std::move(Temp));
+
+    }
+
+    bool Push(T&& Item) {
+        //Moves Item into the next free slot. Returns false if the queue is full.
+        const std::size_t CurrentTail = Tail.load(std::memory_order_relaxed);
+
+        if (CurrentTail - CachedHead == Capacity) {
+            //Looks full. Refresh our copy of the consumer's index and check again.
+            CachedHead = Head.load(std::memory_order_acquire);
+
+            if (CurrentTail - CachedHead == Capacity) {
+                return false;
+
+            }
+        }
+
+        Slots[CurrentTail & Mask] = std::move(Item);
+        Tail.store(CurrentTail + 1, std::memory_order_release);
+
+        return true;
+
+    }
+
+    template <typename Iterator>
+    std::size_t PushMany(Iterator First, Iterator Last) {
+        //Moves as many items from [First, Last) as will fit, and publishes them all at once. Returns the number moved;
+        //the rest are left alone.
+        //One look at the consumer's index is cheap compared to a whole batch, so always get an up to date one.
+        const std::size_t CurrentTail = Tail.load(std::memory_order_relaxed);
+        CachedHead = Head.load(std::memory_order_acquire);
+
+        std::size_t Room = Capacity - (CurrentTail - CachedHead);
+        std::size_t Count = 0;
+
+        for (; First != Last && Count < Room; ++First, ++Count) {
+            Slots[(CurrentTail + Count) & Mask] = std::move(*First);
+
+        }
+
+        Tail.store(CurrentTail + Count, std::memory_order_release);
+
+        return Count;
+
+    }
+
+    //Consumer functions.
+    T& Front() {
+        //Returns the oldest item. Don't call this if the queue is empty.
+        return Slots[Head.load(std::memory_order_relaxed) & Mask];
+
+    }
+
+    T& At(const std::size_t Index) {
+        //Returns the item Index places behind the oldest one. Don't call this unless Index < Size().
+        return Slots[(Head.load(std::memory_order_relaxed) + Index) & Mask];
+
+    }
+
+    void Pop() {
+        //Removes the oldest item, if there is one, and hands its slot back to the producer.
+        const std::size_t CurrentHead = Head.load(std::memory_order_relaxed);
+
+        if (CurrentHead == CachedTail) {
+            CachedTail = Tail.load(std::memory_order_acquire);
+
+            if (CurrentHead == CachedTail) {
+                return;
+
+            }
+        }
+
+        //Free whatever the item owns now, rather than when the slot is next reused.
+        Slots[CurrentHead & Mask] = T();
+        Head.store(CurrentHead + 1, std::memory_order_release);
+
+    }
+
+    template <typename Container>
+    std::size_t PopMany(Container& Out, const std::size_t Max) {
+        //Moves up to Max of the oldest items onto the end of Out, and hands all their slots back at once. Returns the
+        //number moved.
+        const std::size_t CurrentHead = Head.load(std::memory_order_relaxed);
+        CachedTail = Tail.load(std::memory_order_acquire);
+
+        std::size_t Count = CachedTail - CurrentHead;
+
+        if (Count > Max) {
+            Count = Max;
+
+        }
+
+        for (std::size_t i = 0; i < Count; i++) {
+            T& Slot = Slots[(CurrentHead + i) & Mask];
+            Out.push_back(std::move(Slot));
+            Slot = T();
+
+        }
+
+        Head.store(CurrentHead + Count, std::memory_order_release);
+
+        return Count;
+
+    }
+
+    void Clear() {
+        //Pops everything that's currently in the queue.
+        while (!Empty()) {
+            Pop();
+
+        }
+    }
+
+    //Info getter functions.
+    bool Empty() const {
+        return Head.load(std::memory_order_acquire) == Tail.load(std::memory_order_acquire);
+
+    }
+
+    bool Full() const {
+        return Size() >= Capacity;
+
+    }
+
+    std::size_t Size() const {
+        const std::size_t CurrentHead = Head.load(std::memory_order_acquire);
+        return Tail.load(std::memory_order_acquire) - CurrentHead;
+
+    }
+
+    std::size_t GetCapacity() const {
+        return Capacity;
+
+    }
+
+private:
+    //Variables.
+    const std::size_t Capacity;
+    const std::size_t Mask;
+    std::vector<T> Slots;
+
+    //Each side's variables are padded by a whole cache line, so they never share one with the other side (or with
+    //whatever the queue is next to), however the queue happens to be aligned. Queues live inside heap-allocated
+    //objects, and operator new doesn't honour alignas() beyond 16 bytes before C++17.
+    char ConsumerPadding[CacheLineSize];
+
+    //Consumer side. CachedTail is the consumer's last look at Tail, so it doesn't have to touch the producer's cache line every time.
+    std::atomic<std::size_t> Head{0};
+    std::size_t CachedTail = 0;
+    char ProducerPadding[CacheLineSize];
+
+    //Producer side.
+    std::atomic<std::size_t> Tail{0};
+    std::size_t CachedHead = 0;
+    char EndPadding[CacheLineSize];
+
+    //Private function declarations.
+    static std::size_t RoundUp(std::size_t Value) {
+        std::size_t Result = 1;
+
+        while (Result < Value) {
+            Result <<= 1;
+
+        }
+
+        return Result;
+
+    }
+};
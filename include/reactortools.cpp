@@ -0,0 +1,143 @@
+/*
+Reactor Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <boost/system/system_error.hpp>
+
+#include "reactortools.h"
+
+using std::vector;
+
+//Local helpers.
+static void ThrowLastError(const char* What) {
+    throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()), What);
+
+}
+
+//Define Reactor's functions.
+//---------- Constructors ----------
+Reactor::Reactor(const bool EdgeTriggered) : EdgeTriggered(EdgeTriggered) {
+    EpollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+
+    if (EpollDescriptor == -1) {
+        ThrowLastError("epoll_create1");
+
+    }
+}
+
+Reactor::~Reactor() {
+    close(EpollDescriptor);
+
+}
+
+//---------- Registration Functions ----------
+void Reactor::Add(const int FileDescriptor, const bool WantRead, const bool WantWrite) {
+    Control(EPOLL_CTL_ADD, FileDescriptor, WantRead, WantWrite);
+    Registered++;
+
+    //Make sure one wait can report every descriptor.
+    if (EventBuffer.size() < Registered) {
+        EventBuffer.resize(Registered);
+
+    }
+}
+
+void Reactor::Modify(const int FileDescriptor, const bool WantRead, const bool WantWrite) {
+    Control(EPOLL_CTL_MOD, FileDescriptor, WantRead, WantWrite);
+
+}
+
+void Reactor::Remove(const int FileDescriptor) {
+    //Closing a descriptor removes it anyway, so don't complain if it's already gone.
+    epoll_event Unused = {};
+
+    if (epoll_ctl(EpollDescriptor, EPOLL_CTL_DEL, FileDescriptor, &Unused) == -1 && errno != EBADF && errno != ENOENT) {
+        ThrowLastError("epoll_ctl");
+
+    }
+
+    if (Registered > 0) {
+        Registered--;
+
+    }
+}
+
+//---------- Waiting Functions ----------
+std::size_t Reactor::Wait(const std::chrono::microseconds& Timeout, vector<ReactorEvent>& Ready) {
+    //epoll_wait() only takes milliseconds, so round up rather than spinning on timeouts shorter than that.
+    int Milliseconds = static_cast<int>((Timeout.count() + 999) / 1000);
+    int Count = epoll_wait(EpollDescriptor, EventBuffer.data(), static_cast<int>(EventBuffer.size()), Milliseconds);
+
+    Ready.clear();
+
+    if (Count == -1) {
+        if (errno == EINTR) {
+            return 0;
+
+        }
+
+        ThrowLastError("epoll_wait");
+
+    }
+
+    for (int i = 0; i < Count; i++) {
+        ReactorEvent Event;
+        Event.FileDescriptor = EventBuffer[i].data.fd;
+        Event.Readable = (EventBuffer[i].events & (EPOLLIN | EPOLLRDHUP)) != 0;
+        Event.Writable = (EventBuffer[i].events & EPOLLOUT) != 0;
+        Event.Closed = (EventBuffer[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+
+        Ready.push_back(Event);
+
+    }
+
+    return Ready.size();
+
+}
+
+//---------- Private Functions ----------
+void Reactor::Control(const int Operation, const int FileDescriptor, const bool WantRead, const bool WantWrite) {
+    epoll_event Event = {};
+
+    Event.data.fd = FileDescriptor;
+    Event.events = EPOLLRDHUP;
+
+    if (WantRead) {
+        Event.events |= EPOLLIN;
+
+    }
+
+    if (WantWrite) {
+        Event.events |= EPOLLOUT;
+
+    }
+
+    if (EdgeTriggered) {
+        Event.events |= EPOLLET;
+
+    }
+
+    if (epoll_ctl(EpollDescriptor, Operation, FileDescriptor, &Event) == -1) {
+        ThrowLastError("epoll_ctl");
+
+    }
+}
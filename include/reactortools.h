@@ -0,0 +1,75 @@
+/*
+Reactor Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include <sys/epoll.h>
+
+//Structs.
+//What happened to one of the file descriptors a Reactor is watching.
+struct ReactorEvent {
+    int FileDescriptor;
+    bool Readable;
+    bool Writable;
+    bool Closed; //Hung up, or an error. Reading will say which.
+};
+
+//Class definitions.
+//Waits for any number of file descriptors at once with epoll. Unlike select(), each descriptor is registered once rather
+//than on every wait, there's no FD_SETSIZE limit, and waiting costs the same however many descriptors there are.
+//In edge-triggered mode, a descriptor is only reported when new data arrives, so whoever reads it must keep going until
+//it would block (or remember that it hasn't).
+class Reactor {
+public:
+    //Constructors. Throws boost::system::system_error if epoll isn't available.
+    explicit Reactor(const bool EdgeTriggered = false);
+
+    //Destructor.
+    ~Reactor();
+
+    //Other constructors.
+    Reactor(const Reactor& that) = delete; //We own the epoll descriptor, so don't allow copying.
+    Reactor& operator = (const Reactor& rhs) = delete;
+
+    //Registration functions. Throw boost::system::system_error on failure.
+    void Add(const int FileDescriptor, const bool WantRead, const bool WantWrite);
+    void Modify(const int FileDescriptor, const bool WantRead, const bool WantWrite);
+    void Remove(const int FileDescriptor);
+
+    //Waits up to Timeout for events, and replaces the contents of Ready with them. Returns the number of events, or 0
+    //if we timed out or were interrupted by a signal.
+    std::size_t Wait(const std::chrono::microseconds& Timeout, std::vector<ReactorEvent>& Ready);
+
+    //Info getter functions.
+    bool IsEdgeTriggered() const { return EdgeTriggered; }
+    std::size_t Size() const { return Registered; }
+
+private:
+    //Variables.
+    int EpollDescriptor;
+    bool EdgeTriggered;
+    std::size_t Registered = 0;
+    std::vector<epoll_event> EventBuffer = std::vector<epoll_event>(64);
+
+    //Private function declarations.
+    void Control(const int Operation, const int FileDescriptor, const bool WantRead, const bool WantWrite);
+};
@@ -0,0 +1,189 @@
+/*
+Receive Ring Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <boost/system/system_error.hpp>
+
+#include "ringtools.h"
+
+//A leased part of the ring. Each one is the block for its view's Messages, so leasing doesn't allocate. It keeps the
+//ring alive until the view has gone.
+struct RingLease : public MessageBlock {
+    std::uint64_t Start;
+    std::atomic<bool> Released;
+    std::shared_ptr<ReceiveRing> Ring;
+
+    void Lease(const std::shared_ptr<ReceiveRing>& Owner, const std::uint64_t Position) {
+        Reuse();
+        Start = Position;
+        Released.store(false, std::memory_order_relaxed);
+        Ring = Owner;
+
+    }
+
+protected:
+    void Free() {
+        //Called by whichever thread drops the last copy of a view. The owner reclaims the space next time it writes,
+        //and might reuse this lease as soon as it's marked, so let go of the ring first. That might be the last
+        //reference to it, which destroys this lease too, so don't touch anything afterwards.
+        std::shared_ptr<ReceiveRing> Owner = std::move(Ring);
+        Released.store(true, std::memory_order_release);
+
+    }
+};
+
+//Local helpers.
+static void ThrowError(const int Error, const char* What) {
+    throw boost::system::system_error(boost::system::error_code(Error, boost::system::system_category()), What);
+
+}
+
+//Define ReceiveRing's functions.
+//---------- Constructors ----------
+ReceiveRing::ReceiveRing(const std::size_t MinimumSize) : Leases(new RingLease[MaxRingLeases]) {
+    //Both mappings have to start on a page boundary, so use a power of 2 that's at least a page.
+    Size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+    while (Size < MinimumSize) {
+        Size *= 2;
+
+    }
+
+    int MemoryDescriptor = memfd_create("stroodlr-receive", MFD_CLOEXEC);
+
+    if (MemoryDescriptor == -1) {
+        ThrowError(errno, "memfd_create");
+
+    }
+
+    if (ftruncate(MemoryDescriptor, Size) == -1) {
+        int Error = errno;
+        close(MemoryDescriptor);
+        ThrowError(Error, "ftruncate");
+
+    }
+
+    //Reserve room for both copies, then map the memfd over each half.
+    void* Reserved = mmap(nullptr, 2 * Size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (Reserved == MAP_FAILED) {
+        int Error = errno;
+        close(MemoryDescriptor);
+        ThrowError(Error, "mmap");
+
+    }
+
+    char* Base = static_cast<char*>(Reserved);
+
+    if (mmap(Base, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, MemoryDescriptor, 0) == MAP_FAILED
+        || mmap(Base + Size, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, MemoryDescriptor, 0) == MAP_FAILED) {
+
+        int Error = errno;
+        munmap(Base, 2 * Size);
+        close(MemoryDescriptor);
+        ThrowError(Error, "mmap");
+
+    }
+
+    //The mappings keep the memory alive.
+    close(MemoryDescriptor);
+    Data = Base;
+
+    for (std::size_t i = 0; i < MaxRingLeases; i++) {
+        Leases[i].Released = false;
+
+    }
+}
+
+ReceiveRing::~ReceiveRing() {
+    munmap(Data, 2 * Size);
+
+}
+
+//---------- Writing Functions ----------
+char* ReceiveRing::WriteSpace(std::size_t& Space) {
+    Reclaim();
+    Space = Size - (Head - Tail);
+
+    return Data + (Head & (Size - 1));
+
+}
+
+void ReceiveRing::Commit(const std::size_t Count) {
+    Head += Count;
+
+}
+
+//---------- Reading Functions ----------
+void ReceiveRing::Consume(const std::size_t Count) {
+    ReadPosition += Count;
+
+}
+
+Message ReceiveRing::Lease(const std::size_t Count) {
+    //Small messages are copied inline, and if we've run out of leases, this one is copied too.
+    const char* Start = ReadPointer();
+
+    if (Count <= Message::InlineCapacity || NextLease - OldestLease == MaxRingLeases) {
+        Message Copy(Start, Count);
+        Consume(Count);
+
+        return Copy;
+
+    }
+
+    RingLease& NewLease = Leases[NextLease % MaxRingLeases];
+    NewLease.Lease(shared_from_this(), ReadPosition);
+    NextLease++;
+
+    Consume(Count);
+
+    return Message::Wrap(&NewLease, Start, Count);
+
+}
+
+void ReceiveRing::Clear() {
+    ReadPosition = Head;
+
+}
+
+//---------- Info getter functions ----------
+bool ReceiveRing::IsIdle() {
+    Reclaim();
+
+    return NextLease == OldestLease;
+
+}
+
+//---------- Private Functions ----------
+void ReceiveRing::Reclaim() {
+    //Moves Tail up to the oldest lease that hasn't been released yet, or to ReadPosition if there isn't one. Leases
+    //released out of order wait for the ones before them.
+    while (OldestLease != NextLease && Leases[OldestLease % MaxRingLeases].Released.load(std::memory_order_acquire)) {
+        OldestLease++;
+
+    }
+
+    Tail = (OldestLease == NextLease) ? ReadPosition : Leases[OldestLease % MaxRingLeases].Start;
+
+}
@@ -0,0 +1,89 @@
+/*
+Receive Ring Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "messagetools.h"
+
+//The size of a new receive ring, unless a frame needs a bigger one. Rounded up to a power of 2 pages.
+const std::size_t DefaultReceiveRingSize = 128 * 1024;
+
+//If the application falls behind, each new ring is twice the size of the last, up to this (unless a frame needs more).
+const std::size_t MaxReceiveRingSize = 8 * 1024 * 1024;
+
+//How many views of a ring can be handed out and not released yet. Any more are copied instead.
+const std::size_t MaxRingLeases = 1024;
+
+//Defined in ringtools.cpp.
+struct RingLease;
+
+//Class definitions.
+//A circular receive buffer, mapped twice in a row, so whatever is in it (or whatever space is free) can always be used
+//as one contiguous block, even where it wraps around the end. Data is written at the head and consumed from the front.
+//Consumed data can be leased out as Messages that point straight into the ring; the space is only reused once that
+//lease (and every one before it) has been released, which happens when the last copy of the Message has gone, on
+//whichever thread that is. Everything else is for the one thread that owns the ring.
+class ReceiveRing : public std::enable_shared_from_this<ReceiveRing> {
+public:
+    //Constructors. Throws boost::system::system_error if the memory can't be mapped.
+    explicit ReceiveRing(const std::size_t MinimumSize);
+
+    //Destructor.
+    ~ReceiveRing();
+
+    //Other constructors.
+    ReceiveRing(const ReceiveRing& that) = delete; //We own the mapping, so don't allow copying.
+    ReceiveRing& operator = (const ReceiveRing& rhs) = delete;
+
+    //Writing functions.
+    char* WriteSpace(std::size_t& Space); //Where to write next, and how much room there is (after reclaiming anything released).
+    void Commit(const std::size_t Count); //Count bytes have been written at WriteSpace().
+
+    //Reading functions.
+    const char* ReadPointer() const { return Data + (ReadPosition & (Size - 1)); }
+    std::size_t Readable() const { return Head - ReadPosition; }
+    void Consume(const std::size_t Count); //Drops Count bytes from the front. Their space can be reused straight away.
+    Message Lease(const std::size_t Count); //Consumes Count bytes from the front, and returns a view of them.
+    void Clear(); //Drops everything that hasn't been consumed yet.
+
+    //Info getter functions.
+    std::size_t GetSize() const { return Size; }
+    bool IsIdle(); //True if nothing is leased out.
+
+private:
+    //Variables. Positions count bytes since the ring was made, so they never wrap.
+    char* Data = nullptr;
+    std::size_t Size = 0;
+    std::uint64_t Head = 0;
+    std::uint64_t ReadPosition = 0;
+    std::uint64_t Tail = 0; //Everything before here can be overwritten.
+
+    //Leases, oldest first, in a circular array. Other threads only release them.
+    std::unique_ptr<RingLease[]> Leases;
+    std::uint64_t NextLease = 0;
+    std::uint64_t OldestLease = 0;
+
+    //Private function declarations.
+    void Reclaim();
+};
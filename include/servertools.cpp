@@ -19,13 +19,14 @@ along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdexcept>
 
 #include "loggertools.h"
+#include "sockettools.h"
 
 using std::string;
 
 //Allow us to use the logger here.
 extern Logging Logger;
 
-void ParseCmdlineOptions(int& PortNumber, const int& argc, char* argv[]) {
+void ParseCmdlineOptions(int& PortNumber, string& Address, int& ThreadCount, SocketTuning& Tuning, const int& argc, char* argv[]) {
     //Parse commandline options.
     string Temp;
 
@@ -67,6 +68,74 @@ void ParseCmdlineOptions(int& PortNumber, const int& argc, char* argv[]) {
 
             }
 
+        } else if ((Temp == "-a") || (Temp == "--address")) {
+            //-a, --address.
+            //Set the address to listen on to next element, if it exists.
+            if (i == argc - 1) {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            Temp.assign(argv[i+1]);
+
+            //If not specified, exit.
+            if (Temp.substr(0, 1) == "-") {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            Address = Temp;
+
+        } else if ((Temp == "-t") || (Temp == "--threads")) {
+            //-t, --threads.
+            //Set the number of threads to next element, if it exists.
+            if (i == argc - 1) {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            Temp.assign(argv[i+1]);
+
+            //If not specified, exit.
+            if (Temp.substr(0, 1) == "-") {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            try {
+                ThreadCount = std::stoi(Temp);
+
+            } catch (std::invalid_argument const& e) {
+                throw std::runtime_error("Option value invalid.");
+
+            }
+
+            if (ThreadCount < 1) {
+                throw std::runtime_error("Option value invalid.");
+
+            }
+
+        } else if (IsTuningOption(Temp)) {
+            //--nodelay, --sndbuf, --rcvbuf, --quickack, --busypoll, --keepalive.
+            //Set the option to next element, if it exists.
+            if (i == argc - 1) {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            //If not specified, exit.
+            if (string(argv[i+1]).substr(0, 1) == "-") {
+                throw std::runtime_error("Option value not specified.");
+
+            }
+
+            ParseTuningOption(Temp, argv[i+1], Tuning);
+
+        } else if ((Temp == "-A") || (Temp == "--async")) {
+            //-A, --async. Sessions always run on SocketServer's thread pool with the event-driven handler, so there's
+            //nothing to change. Still accepted, so scripts written for older versions keep working.
+            Logger.Info("Server Tools: ParseCmdlineOptions(): Clients are always served by the event-driven handler, so -A/--async has no effect.");
+
         } else if ((Temp == "-q") || (Temp == "--quiet")) {
             //-q, --quiet.
             Logger.SetLevel("Warning");
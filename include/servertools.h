@@ -18,5 +18,9 @@ along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
 //Only include once.
 #pragma once
 
+#include <string>
+
+#include "sockettools.h"
+
 //Function declarations.
-void ParseCmdlineOptions(int& PortNumber, const int& argc, char* argv[]);
+void ParseCmdlineOptions(int& PortNumber, std::string& Address, int& ThreadCount, SocketTuning& Tuning, const int& argc, char* argv[]);
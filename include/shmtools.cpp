@@ -0,0 +1,571 @@
+/*
+Shared Memory Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <boost/system/system_error.hpp>
+
+#include "shmtools.h"
+
+using std::vector;
+
+//The shared state of one ring. Only the producer writes Tail, and only the consumer writes Head. They're on separate
+//cache lines, so the two sides don't slow each other down.
+struct SharedRingHeader {
+    alignas(64) std::atomic<std::uint64_t> Head;
+    alignas(64) std::atomic<std::uint64_t> Tail;
+    alignas(64) std::atomic<std::uint32_t> ConsumerWaiting; //Set by the consumer before it sleeps, so the producer wakes it.
+    std::atomic<std::uint32_t> ProducerWaiting;             //Likewise, for a producer waiting for space.
+};
+
+//The start of the memfd. The data for each ring follows, client to server first.
+struct SharedSegment {
+    std::uint32_t Magic;
+    std::uint32_t Version;
+    std::uint64_t RingSize;
+    SharedRingHeader Rings[2]; //Client to server, then server to client.
+};
+
+static const std::uint32_t SegmentMagic = 0x5354524F; //"STRO".
+static const std::uint32_t SegmentVersion = 1;
+
+//Where each wake-up is in Events. The connecting side sends them in the order the accepting side uses.
+static const int InboundDataEvent = 0;
+static const int InboundSpaceEvent = 1;
+static const int OutboundDataEvent = 2;
+static const int OutboundSpaceEvent = 3;
+
+//Local helpers.
+static void ThrowError(const int Error, const char* What) {
+    throw boost::system::system_error(boost::system::error_code(Error, boost::system::system_category()), What);
+
+}
+
+static void Signal(const int Descriptor) {
+    std::uint64_t One = 1;
+
+    while (write(Descriptor, &One, sizeof(One)) == -1 && errno == EINTR) {}
+
+}
+
+static void ClearEvent(const int Descriptor) {
+    std::uint64_t Count;
+
+    while (read(Descriptor, &Count, sizeof(Count)) == -1 && errno == EINTR) {}
+
+}
+
+//Define SharedMemoryStream's functions.
+//---------- Constructors ----------
+SharedMemoryStream::SharedMemoryStream(const int SocketDescriptor, const std::size_t RingSize)
+    : SocketDescriptor(SocketDescriptor), RingSize(RingSize) {
+
+    if (RingSize == 0 || (RingSize & (RingSize - 1)) != 0 || RingSize > MaxSharedMemoryRingSize) {
+        throw std::runtime_error("Shared memory ring size must be a power of 2, and no more than 64 MiB");
+
+    }
+
+    //Seal the size, so the peer can't shrink it under us (which would crash us the next time we touched it).
+    int MemoryDescriptor = memfd_create("stroodlr", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if (MemoryDescriptor == -1) {
+        ThrowError(errno, "memfd_create");
+
+    }
+
+    SegmentSize = sizeof(SharedSegment) + 2 * RingSize;
+
+    if (ftruncate(MemoryDescriptor, SegmentSize) == -1 || fcntl(MemoryDescriptor, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        int Error = errno;
+        close(MemoryDescriptor);
+        ThrowError(Error, "memfd");
+
+    }
+
+    try {
+        MapSegment(MemoryDescriptor, true);
+
+        for (int i = 0; i < 4; i++) {
+            Events[i] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+            if (Events[i] == -1) {
+                ThrowError(errno, "eventfd");
+
+            }
+        }
+
+        //The accepting side's inbound events are our outbound ones.
+        int Descriptors[5] = {MemoryDescriptor, Events[OutboundDataEvent], Events[OutboundSpaceEvent], Events[InboundDataEvent], Events[InboundSpaceEvent]};
+        char Buffer[CMSG_SPACE(sizeof(Descriptors))];
+        char Version = static_cast<char>(SegmentVersion);
+        iovec Data = {&Version, 1};
+        msghdr Header;
+
+        std::memset(&Header, 0, sizeof(Header));
+        std::memset(Buffer, 0, sizeof(Buffer));
+        Header.msg_iov = &Data;
+        Header.msg_iovlen = 1;
+        Header.msg_control = Buffer;
+        Header.msg_controllen = sizeof(Buffer);
+
+        cmsghdr* Control = CMSG_FIRSTHDR(&Header);
+        Control->cmsg_level = SOL_SOCKET;
+        Control->cmsg_type = SCM_RIGHTS;
+        Control->cmsg_len = CMSG_LEN(sizeof(Descriptors));
+        std::memcpy(CMSG_DATA(Control), Descriptors, sizeof(Descriptors));
+
+        ssize_t Sent;
+
+        do {
+            Sent = sendmsg(SocketDescriptor, &Header, MSG_NOSIGNAL);
+
+        } while (Sent == -1 && errno == EINTR);
+
+        if (Sent != 1) {
+            ThrowError(Sent == -1 ? errno : EPIPE, "sendmsg");
+
+        }
+
+        SetUpReadDescriptor();
+
+    } catch (...) {
+        close(MemoryDescriptor);
+        CloseDescriptors();
+        throw;
+
+    }
+
+    //The peer has its own copy now.
+    close(MemoryDescriptor);
+
+}
+
+SharedMemoryStream::SharedMemoryStream(const int SocketDescriptor)
+    : SocketDescriptor(SocketDescriptor) {
+
+    int Descriptors[5];
+    char Buffer[CMSG_SPACE(sizeof(Descriptors))];
+    char Version = 0;
+    iovec Data = {&Version, 1};
+    msghdr Header;
+
+    std::memset(&Header, 0, sizeof(Header));
+    Header.msg_iov = &Data;
+    Header.msg_iovlen = 1;
+    Header.msg_control = Buffer;
+    Header.msg_controllen = sizeof(Buffer);
+
+    ssize_t Received;
+
+    do {
+        Received = recvmsg(SocketDescriptor, &Header, MSG_CMSG_CLOEXEC);
+
+    } while (Received == -1 && errno == EINTR);
+
+    if (Received == -1) {
+        ThrowError(errno, "recvmsg");
+
+    }
+
+    //Take ownership of whatever we were sent first, so nothing leaks if it's wrong.
+    cmsghdr* Control = CMSG_FIRSTHDR(&Header);
+    std::size_t Count = 0;
+
+    if (Control != nullptr && Control->cmsg_level == SOL_SOCKET && Control->cmsg_type == SCM_RIGHTS) {
+        Count = (Control->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        std::memcpy(Descriptors, CMSG_DATA(Control), std::min<std::size_t>(Count, 5) * sizeof(int));
+
+    }
+
+    for (std::size_t i = 1; i < std::min<std::size_t>(Count, 5); i++) {
+        Events[i - 1] = Descriptors[i];
+
+    }
+
+    try {
+        if (Received != 1 || Count != 5 || (Header.msg_flags & MSG_CTRUNC) || Version != static_cast<char>(SegmentVersion)) {
+            throw std::runtime_error("Peer didn't send usable shared memory");
+
+        }
+
+        MapSegment(Descriptors[0], false);
+        SetUpReadDescriptor();
+
+    } catch (...) {
+        if (Count >= 1) {
+            close(Descriptors[0]);
+
+        }
+
+        CloseDescriptors();
+        throw;
+
+    }
+
+    close(Descriptors[0]);
+
+}
+
+SharedMemoryStream::~SharedMemoryStream() {
+    //The asio descriptors have to go before the ones they're copies of.
+    ReadWaiter = nullptr;
+    SpaceWaiter = nullptr;
+    CloseDescriptors();
+
+}
+
+//---------- Reading Functions ----------
+std::size_t SharedMemoryStream::Peek(const char*& Data) {
+    //Returns as much as we can read without wrapping around. Anything after that is returned next time.
+    std::uint64_t Available = Inbound->Tail.load(std::memory_order_acquire) - ReadPosition;
+
+    if (Available > RingSize) {
+        throw std::runtime_error("Shared memory ring is corrupt");
+
+    }
+
+    std::size_t Offset = ReadPosition & (RingSize - 1);
+    Data = InboundData + Offset;
+
+    return std::min<std::size_t>(Available, RingSize - Offset);
+
+}
+
+void SharedMemoryStream::Consume(const std::size_t Size) {
+    ReadPosition += Size;
+    Inbound->Head.store(ReadPosition, std::memory_order_release);
+
+    //Pairs with the fence in PrepareToWaitForSpace(), so either it sees the space, or we see that it's waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (Inbound->ProducerWaiting.load(std::memory_order_relaxed) != 0 && Inbound->ProducerWaiting.exchange(0) != 0) {
+        Signal(Events[InboundSpaceEvent]);
+
+    }
+}
+
+bool SharedMemoryStream::PrepareToWait() {
+    //Clear the old wake-up first, so it can't hide a new one.
+    ClearEvent(Events[InboundDataEvent]);
+    Inbound->ConsumerWaiting.store(1, std::memory_order_relaxed);
+
+    //Pairs with the fence in WriteSome(), so either we see the data, or it sees that we're waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (Inbound->Tail.load(std::memory_order_acquire) != ReadPosition) {
+        Inbound->ConsumerWaiting.store(0, std::memory_order_relaxed);
+        return false;
+
+    }
+
+    return true;
+
+}
+
+bool SharedMemoryStream::PeerHasGone() {
+    //The peer never sends anything on the socket after the rings, so if it's readable, it's been closed.
+    char Byte;
+    ssize_t Result = recv(SocketDescriptor, &Byte, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    return !(Result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+
+}
+
+//---------- Writing Functions ----------
+std::size_t SharedMemoryStream::WriteSome(const vector<boost::asio::const_buffer>& Buffers, const std::size_t Offset) {
+    //Copies as much as fits, then publishes it all at once.
+    std::uint64_t InUse = WritePosition - Outbound->Head.load(std::memory_order_acquire);
+
+    if (InUse > RingSize) {
+        throw std::runtime_error("Shared memory ring is corrupt");
+
+    }
+
+    std::size_t Free = RingSize - InUse;
+    std::size_t Skip = Offset;
+    std::size_t Written = 0;
+
+    for (std::size_t i = 0; i < Buffers.size() && Written < Free; i++) {
+        const char* Data = static_cast<const char*>(Buffers[i].data());
+        std::size_t Size = Buffers[i].size();
+
+        if (Skip >= Size) {
+            Skip -= Size;
+            continue;
+
+        }
+
+        Data += Skip;
+        Size = std::min(Size - Skip, Free - Written);
+        Skip = 0;
+
+        //Copy in up to two pieces, if we're at the end of the ring.
+        std::size_t Start = (WritePosition + Written) & (RingSize - 1);
+        std::size_t First = std::min(Size, RingSize - Start);
+
+        std::memcpy(OutboundData + Start, Data, First);
+        std::memcpy(OutboundData, Data + First, Size - First);
+        Written += Size;
+
+    }
+
+    if (Written == 0) {
+        return 0;
+
+    }
+
+    WritePosition += Written;
+    Outbound->Tail.store(WritePosition, std::memory_order_release);
+
+    //Pairs with the fence in PrepareToWait().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (Outbound->ConsumerWaiting.load(std::memory_order_relaxed) != 0 && Outbound->ConsumerWaiting.exchange(0) != 0) {
+        Signal(Events[OutboundDataEvent]);
+
+    }
+
+    return Written;
+
+}
+
+bool SharedMemoryStream::PrepareToWaitForSpace() {
+    ClearEvent(Events[OutboundSpaceEvent]);
+    Outbound->ProducerWaiting.store(1, std::memory_order_relaxed);
+
+    //Pairs with the fence in Consume().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (WritePosition - Outbound->Head.load(std::memory_order_acquire) < RingSize) {
+        Outbound->ProducerWaiting.store(0, std::memory_order_relaxed);
+        return false;
+
+    }
+
+    return true;
+
+}
+
+//---------- Async Functions ----------
+void SharedMemoryStream::AsyncWaitReadable(boost::asio::io_service::strand& Strand, const std::function<void(const boost::system::error_code&)>& Callback) {
+    //Calls Callback once there might be something to read. Peek() to find out.
+    if (!PrepareToWait()) {
+        Strand.post(std::bind(Callback, boost::system::error_code()));
+        return;
+
+    }
+
+    if (ReadWaiter == nullptr) {
+        ReadWaiter.reset(new boost::asio::posix::stream_descriptor(Strand.context(), dup(ReadDescriptor)));
+
+    }
+
+    std::shared_ptr<SharedMemoryStream> Self = shared_from_this();
+    ReadWaiter->async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                           Strand.wrap([Self, Callback](const boost::system::error_code& Error) { Callback(Error); }));
+
+}
+
+void SharedMemoryStream::AsyncWrite(boost::asio::io_service::strand& Strand, std::shared_ptr<vector<boost::asio::const_buffer> > Buffers,
+                                    const std::function<void(const boost::system::error_code&, std::size_t)>& Callback) {
+    //Like boost::asio::async_write(). Buffers must stay valid until Callback is called.
+    ContinueAsyncWrite(Strand, Buffers, 0, Callback);
+
+}
+
+void SharedMemoryStream::Close() {
+    //Cancels anything we're waiting for, so the callbacks (and anything they hold on to) are finished with.
+    boost::system::error_code Ignored;
+
+    if (ReadWaiter != nullptr) {
+        ReadWaiter->close(Ignored);
+
+    }
+
+    if (SpaceWaiter != nullptr) {
+        SpaceWaiter->close(Ignored);
+
+    }
+}
+
+//---------- Private Functions ----------
+void SharedMemoryStream::MapSegment(const int MemoryDescriptor, const bool Create) {
+    //Maps the rings. If we didn't make them, checks that they're safe to use first.
+    if (!Create) {
+        struct stat Info;
+        int Seals = fcntl(MemoryDescriptor, F_GET_SEALS);
+
+        if (fstat(MemoryDescriptor, &Info) == -1) {
+            ThrowError(errno, "fstat");
+
+        }
+
+        if (Seals == -1 || !(Seals & F_SEAL_SHRINK) || Info.st_size < static_cast<off_t>(sizeof(SharedSegment))
+            || Info.st_size > static_cast<off_t>(sizeof(SharedSegment) + 2 * MaxSharedMemoryRingSize)) {
+
+            throw std::runtime_error("Peer's shared memory isn't usable");
+
+        }
+
+        SegmentSize = Info.st_size;
+
+    }
+
+    void* Memory = mmap(nullptr, SegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, MemoryDescriptor, 0);
+
+    if (Memory == MAP_FAILED) {
+        ThrowError(errno, "mmap");
+
+    }
+
+    Segment = static_cast<SharedSegment*>(Memory);
+
+    if (Create) {
+        new (Segment) SharedSegment();
+        Segment->Magic = SegmentMagic;
+        Segment->Version = SegmentVersion;
+        Segment->RingSize = RingSize;
+
+    } else {
+        //Only read the size once, so the peer can't change it under us.
+        RingSize = Segment->RingSize;
+
+        if (Segment->Magic != SegmentMagic || Segment->Version != SegmentVersion || RingSize == 0 || (RingSize & (RingSize - 1)) != 0
+            || RingSize > MaxSharedMemoryRingSize || sizeof(SharedSegment) + 2 * RingSize > SegmentSize) {
+
+            throw std::runtime_error("Peer's shared memory isn't usable");
+
+        }
+    }
+
+    //The connecting side writes to the first ring.
+    char* Rings = reinterpret_cast<char*>(Segment) + sizeof(SharedSegment);
+
+    Outbound = &Segment->Rings[Create ? 0 : 1];
+    Inbound = &Segment->Rings[Create ? 1 : 0];
+    OutboundData = Rings + (Create ? 0 : RingSize);
+    InboundData = Rings + (Create ? RingSize : 0);
+
+}
+
+void SharedMemoryStream::SetUpReadDescriptor() {
+    //Wakes up when the peer writes, or closes the socket.
+    ReadDescriptor = epoll_create1(EPOLL_CLOEXEC);
+
+    if (ReadDescriptor == -1) {
+        ThrowError(errno, "epoll_create1");
+
+    }
+
+    epoll_event Event;
+    std::memset(&Event, 0, sizeof(Event));
+    Event.events = EPOLLIN;
+    Event.data.fd = Events[InboundDataEvent];
+
+    if (epoll_ctl(ReadDescriptor, EPOLL_CTL_ADD, Events[InboundDataEvent], &Event) == -1) {
+        ThrowError(errno, "epoll_ctl");
+
+    }
+
+    Event.events = EPOLLIN | EPOLLRDHUP;
+    Event.data.fd = SocketDescriptor;
+
+    if (epoll_ctl(ReadDescriptor, EPOLL_CTL_ADD, SocketDescriptor, &Event) == -1) {
+        ThrowError(errno, "epoll_ctl");
+
+    }
+}
+
+void SharedMemoryStream::ContinueAsyncWrite(boost::asio::io_service::strand& Strand, std::shared_ptr<vector<boost::asio::const_buffer> > Buffers,
+                                            std::size_t Written, const std::function<void(const boost::system::error_code&, std::size_t)>& Callback) {
+    //Writes what fits, then waits on the strand for the peer to make room for the rest.
+    std::size_t Total = boost::asio::buffer_size(*Buffers);
+
+    try {
+        do {
+            Written += WriteSome(*Buffers, Written);
+
+        } while (Written != Total && !PrepareToWaitForSpace());
+
+    } catch (std::runtime_error&) {
+        Strand.post(std::bind(Callback, boost::system::error_code(boost::asio::error::fault), Written));
+        return;
+
+    }
+
+    if (Written == Total) {
+        Strand.post(std::bind(Callback, boost::system::error_code(), Written));
+        return;
+
+    }
+
+    if (SpaceWaiter == nullptr) {
+        SpaceWaiter.reset(new boost::asio::posix::stream_descriptor(Strand.context(), dup(Events[OutboundSpaceEvent])));
+
+    }
+
+    std::shared_ptr<SharedMemoryStream> Self = shared_from_this();
+    boost::asio::io_service::strand* StrandPtr = &Strand;
+
+    SpaceWaiter->async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                            Strand.wrap([Self, StrandPtr, Buffers, Written, Callback](const boost::system::error_code& Error) {
+                                if (Error) {
+                                    Callback(Error, Written);
+                                    return;
+
+                                }
+
+                                Self->ContinueAsyncWrite(*StrandPtr, Buffers, Written, Callback);
+                            }));
+
+}
+
+void SharedMemoryStream::CloseDescriptors() {
+    if (Segment != nullptr) {
+        munmap(Segment, SegmentSize);
+        Segment = nullptr;
+
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (Events[i] != -1) {
+            close(Events[i]);
+            Events[i] = -1;
+
+        }
+    }
+
+    if (ReadDescriptor != -1) {
+        close(ReadDescriptor);
+        ReadDescriptor = -1;
+
+    }
+}
@@ -0,0 +1,112 @@
+/*
+Shared Memory Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+
+//The size of each ring (there's one each way). Must be a power of 2.
+const std::size_t SharedMemoryRingSize = 1024 * 1024;
+
+//The largest ring we'll accept from a peer.
+const std::size_t MaxSharedMemoryRingSize = 64 * 1024 * 1024;
+
+//Defined in shmtools.cpp.
+struct SharedRingHeader;
+struct SharedSegment;
+
+//Class definitions.
+//A byte stream between two processes on the same machine, made of two single-producer, single-consumer rings in a
+//memfd, so sending and receiving don't involve the kernel at all. The connecting side makes the rings and sends them
+//over a Unix domain socket, which is kept open so each side notices when the other goes away. Each side only wakes the
+//other (with an eventfd) if it's about to sleep, so there are no system calls while both are busy. Only one thread may
+//read, and one write, at once.
+class SharedMemoryStream : public std::enable_shared_from_this<SharedMemoryStream> {
+public:
+    //Constructors. Throw boost::system::system_error, or std::runtime_error if the peer sends something we can't use.
+    SharedMemoryStream(const int SocketDescriptor, const std::size_t RingSize); //Makes the rings and sends them to the peer.
+    explicit SharedMemoryStream(const int SocketDescriptor); //Receives the rings from the peer. Blocks if they haven't arrived.
+
+    //Destructor.
+    ~SharedMemoryStream();
+
+    //Other constructors.
+    SharedMemoryStream(const SharedMemoryStream& that) = delete; //We own the mapping and descriptors, so don't allow copying.
+    SharedMemoryStream& operator = (const SharedMemoryStream& rhs) = delete;
+
+    //Reading functions. Throw std::runtime_error if the peer has scribbled on the ring.
+    std::size_t Peek(const char*& Data); //Points Data at the next bytes to read, and returns how many there are (0 if none).
+    void Consume(const std::size_t Size); //Frees the first Size bytes from Peek(), waking the peer if it's waiting for space.
+    bool PrepareToWait(); //Asks the peer to wake us when it writes. Returns false if there's something to read already.
+    bool PeerHasGone(); //Only worth asking once there's nothing left to read.
+
+    //Readable when there might be something to read, or the peer has gone. Call PrepareToWait() before waiting for it.
+    int GetReadDescriptor() const { return ReadDescriptor; }
+
+    //Writing functions. Throw std::runtime_error if the peer has scribbled on the ring.
+    std::size_t WriteSome(const std::vector<boost::asio::const_buffer>& Buffers, const std::size_t Offset); //Writes what fits, from Offset bytes in, without blocking.
+    bool PrepareToWaitForSpace(); //Asks the peer to wake us when it reads. Returns false if there's room already.
+
+    //Readable when the peer might have made room. Call PrepareToWaitForSpace() before waiting for it.
+    int GetSpaceDescriptor() const { return Events[3]; }
+
+    //Async functions, like those of a socket. Callbacks are called on Strand.
+    void AsyncWaitReadable(boost::asio::io_service::strand& Strand, const std::function<void(const boost::system::error_code&)>& Callback);
+    void AsyncWrite(boost::asio::io_service::strand& Strand, std::shared_ptr<std::vector<boost::asio::const_buffer> > Buffers,
+                    const std::function<void(const boost::system::error_code&, std::size_t)>& Callback);
+
+    //Cancels any async operations. Call on the strand.
+    void Close();
+
+private:
+    //Variables.
+    int SocketDescriptor;
+    SharedSegment* Segment = nullptr;
+    std::size_t SegmentSize = 0;
+    std::size_t RingSize = 0;
+
+    //Our ends of the rings. We keep our own copies of our positions, in case the peer scribbles on the shared ones.
+    SharedRingHeader* Inbound;
+    SharedRingHeader* Outbound;
+    char* InboundData;
+    char* OutboundData;
+    std::uint64_t ReadPosition = 0;
+    std::uint64_t WritePosition = 0;
+
+    //Wake-ups. Data and space for the inbound ring, then data and space for the outbound ring.
+    int Events[4] = {-1, -1, -1, -1};
+    int ReadDescriptor = -1;
+
+    //Only used by the async functions.
+    std::shared_ptr<boost::asio::posix::stream_descriptor> ReadWaiter;
+    std::shared_ptr<boost::asio::posix::stream_descriptor> SpaceWaiter;
+
+    //Private function declarations.
+    void MapSegment(const int MemoryDescriptor, const bool Create);
+    void SetUpReadDescriptor();
+    void ContinueAsyncWrite(boost::asio::io_service::strand& Strand, std::shared_ptr<std::vector<boost::asio::const_buffer> > Buffers,
+                            std::size_t Written, const std::function<void(const boost::system::error_code&, std::size_t)>& Callback);
+    void CloseDescriptors();
+};
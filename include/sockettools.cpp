@@ -16,449 +16,4420 @@ along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <string>
-#include <queue>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/lexical_cast.hpp>
 #include <iostream>
 #include <thread>
 #include <stdexcept>
+#include <random>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "sockettools.h"
+#include "frametools.h"
 #include "loggertools.h"
 #include "tools.h"
 
 using std::string;
 using std::vector;
-using std::queue;
 using boost::asio::ip::tcp;
 
 //Allow us to use the logger here.
 extern Logging Logger;
 
-//Define Sockets' functions.
-//---------- Setup Functions ----------
-void Sockets::SetPortNumber(const int& PortNo) {
-    Logger.Debug("Socket Tools: Sockets::SetPortNumber(): Setting PortNumber to "+std::to_string(PortNo)+"...");
-    PortNumber = PortNo;
+//Local helpers.
+static std::uint64_t RandomNumber() {
+    //Used for session tokens and reconnect jitter. Any thread can call this.
+    static std::mutex GeneratorMutex;
+    static std::mt19937_64 Generator(std::random_device{}());
+
+    std::lock_guard<std::mutex> Lock(GeneratorMutex);
+    return Generator();
 
 }
 
-//Only useful when creating a plug, rather than a socket.
-void Sockets::SetServerAddress(const string& ServerAdd) {
-    Logger.Debug("Socket Tools: Sockets::SetServerAddress(): Setting ServerAddress to "+ServerAdd+"...");
-    ServerAddress = ServerAdd;
+static std::uint64_t NewSessionToken() {
+    //0 means "no session", so never hand that out.
+    std::uint64_t Token;
 
-}
+    do {
+        Token = RandomNumber();
 
-void Sockets::SetConsoleOutput(const bool State) {
-    //Can tell us not to output any messages to console (used in server).
-    Logger.Debug("Socket Tools: Sockets::SetConsoleOutput(): Setting Verbose to "+boost::lexical_cast<string>(State)+"...");
-    Verbose = State;
+    } while (Token == 0);
 
-}
+    return Token;
 
-void Sockets::StartHandler() {
-    //Starts the handler thread and then returns.
-    //Setup.
-    ReadyForTransmission = false;
-    Reconnected = false;
-    HandlerShouldExit = false;
-    HandlerExited = false;
+}
 
-    if (Type == "Plug" || Type == "Socket") {
-        Logger.Debug("Socket Tools: Sockets::StartHandler(): Check passed, starting handler...");
-        HandlerThread = std::thread(Handler, this);
+static Frame MakeHelloFrame(const std::uint64_t Token, const std::uint32_t LastReceived, const vector<char>& Codecs) {
+    Frame Hello;
+    vector<char> Payload(SessionTokenSize);
 
-    } else {
-        Logger.Debug("Socket Tools: Sockets::StartHandler(): Type isn't set correctly! Throwing runtime_error...");
-        throw std::runtime_error("Type not set correctly");
+    EncodeSessionToken(Token, Payload.data());
+    Payload.insert(Payload.end(), Codecs.begin(), Codecs.end());
+    Hello.Header.Length = Payload.size();
+    Hello.Header.Type = FrameTypeHello;
+    Hello.Header.Sequence = LastReceived;
+    Hello.Payload = Message(std::move(Payload));
 
-    }
+    return Hello;
 
 }
 
-//---------- Info getter functions ----------
-bool Sockets::IsReady() {
-    return ReadyForTransmission;
+static Frame MakeHeartbeatFrame(const char Type, const std::uint64_t Timestamp) {
+    Frame Heartbeat;
+    vector<char> Payload(TimestampSize);
+
+    EncodeTimestamp(Timestamp, Payload.data());
+    Heartbeat.Header.Length = TimestampSize;
+    Heartbeat.Header.Type = Type;
+    Heartbeat.Payload = Message(std::move(Payload));
+
+    return Heartbeat;
 
 }
 
-bool Sockets::JustReconnected() {
-    //Clear and return Reconnected.
-    bool Temp = Reconnected;
-    Reconnected = false;
+static std::uint64_t MicrosecondsNow() {
+    //For heartbeat timestamps. Only ever compared with our own clock.
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 
-    return Temp;
+}
+
+static bool IsSharedMemoryAddress(const string& Address) {
+    return Address.compare(0, SharedMemoryAddressPrefix.size(), SharedMemoryAddressPrefix) == 0;
 
 }
 
-void Sockets::WaitForHandlerToExit() {
-    HandlerThread.join();
+static bool IsLocalAddress(const string& Address) {
+    //True if Address is the path of a Unix domain socket, whether or not it's used to set up shared memory.
+    return Address.compare(0, UnixAddressPrefix.size(), UnixAddressPrefix) == 0 || IsSharedMemoryAddress(Address);
 
 }
 
-bool Sockets::HandlerHasExited() {
-    return HandlerExited;
+static string LocalPath(const string& Address) {
+    return Address.substr(Address.find(':') + 1);
 
 }
-//---------- Controller Functions ----------
-void Sockets::RequestHandlerExit() {
-    Logger.Debug("Socket Tools: Sockets::RequestHandlerExit(): Requesting handler to exit...");
-    HandlerShouldExit = true;
 
+static void RemoveSocketFile(const string& Address) {
+    //Unix domain sockets leave a file behind, which stops anyone binding to the path again. Only removes sockets, so
+    //a typo can't delete anything else.
+    if (!IsLocalAddress(Address)) {
+        return;
+
+    }
+
+    string Path = LocalPath(Address);
+    struct stat Info;
+
+    if (stat(Path.c_str(), &Info) == 0 && S_ISSOCK(Info.st_mode)) {
+        Logger.Debug("Socket Tools: RemoveSocketFile(): Removing old socket file "+Path+"...");
+        unlink(Path.c_str());
+
+    }
 }
 
-void Sockets::Reset() {
-    //Resets the socket to the default state.
-    Logger.Debug("Socket Tools: Sockets::Reset(): Resetting socket...");
+static StreamProtocol::endpoint ListeningEndpoint(const string& Address, const int PortNumber) {
+    //Where to listen for connections. An empty address means every IPv4 interface.
+    if (IsLocalAddress(Address)) {
+        return boost::asio::local::stream_protocol::endpoint(LocalPath(Address));
 
-    //Variables for tracking status of the other thread.
-    ReadyForTransmission = false;
-    Reconnected = false;
-    HandlerShouldExit = false;
-    HandlerExited = false;
+    } else if (Address.empty()) {
+        return tcp::endpoint(tcp::v4(), PortNumber);
 
-    //Queues.
-    IncomingQueue = queue<vector<char> >();
-    OutgoingQueue = queue<vector<char> >();
+    }
 
-    //Boost stuff.
-    Socket = nullptr;
-    acceptor = nullptr;
-    resolver = nullptr;    
-    io_service->stop();
-    io_service = nullptr;
+    return tcp::endpoint(boost::asio::ip::address::from_string(Address), PortNumber);
 
-    Logger.Debug("Socket Tools: Sockets::Reset(): Done! Socket is now in its default state...");
 }
 
-//---------- Handler Thread & Functions ----------
-void Sockets::CreateAndConnect(Sockets* Ptr) {
-    //Handles connecting/reconnecting the socket.
-    //Handle any errors while connecting.
-    try {
-        if (Ptr->Type == "Plug") {
-            Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Creating and connecting plug...");
-            Ptr->CreatePlug();
-            Ptr->ConnectPlug();
+static bool SetSocketOption(const int Descriptor, const int Level, const int Name, const int Value, const string& OptionName) {
+    //Options the kernel refuses are logged and skipped, because the connection works without them.
+    if (setsockopt(Descriptor, Level, Name, &Value, sizeof(Value)) == 0) {
+        return true;
 
-        } else if (Ptr->Type == "Socket") {
-            Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Creating and connecting socket...");
-            Ptr->CreateSocket();
-            Ptr->ConnectSocket();
+    }
 
-        }
+    Logger.Warning("Socket Tools: SetSocketOption(): Couldn't set "+OptionName+": "+std::strerror(errno)+". Continuing...");
+    return false;
 
-        //We are now connected.
-        Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Done!");
-        Ptr->ReadyForTransmission = true;
+}
 
-    } catch (boost::system::system_error const& e) {
-        Logger.Critical("Socket Tools: Sockets::CreateAndConnect(): Error connecting: "+static_cast<string>(e.what())+". Exiting...");
+static void CheckTuning(const SocketTuning& Tuning) {
+    if (Tuning.SendBufferSize < 0 || Tuning.ReceiveBufferSize < 0 || Tuning.BusyPoll < 0
+        || Tuning.KeepAliveIdle < 0 || Tuning.KeepAliveInterval < 0 || Tuning.KeepAliveCount < 0) {
+        throw std::runtime_error("Invalid socket tuning");
 
-        if (Ptr->Verbose) {
-            std::cerr << "Connecting Failed: " << e.what() << std::endl;
-            std::cerr << "Press ENTER to exit." << std::endl;
+    }
+}
 
-        }
+static void OpenAcceptor(StreamAcceptor& Acceptor, const string& Address, const int PortNumber, const SocketTuning& Tuning) {
+    //Opens, binds and starts listening. Throws boost::system::system_error on failure.
+    StreamProtocol::endpoint Endpoint = ListeningEndpoint(Address, PortNumber);
 
-        //Make the handler exit.
-        Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Asking handler to exit...");
-        Ptr->HandlerShouldExit = true;
+    RemoveSocketFile(Address);
 
-        return;
+    Acceptor.open(Endpoint.protocol());
+
+    if (!IsLocalAddress(Address)) {
+        Acceptor.set_option(StreamAcceptor::reuse_address(true));
+
+    }
+
+    //Accepted sockets start with the listening socket's buffer sizes. The receive buffer has to be set before the
+    //connection is made, because the TCP window scale is agreed then.
+    if (Tuning.SendBufferSize != 0) {
+        SetSocketOption(Acceptor.native_handle(), SOL_SOCKET, SO_SNDBUF, Tuning.SendBufferSize, "SO_SNDBUF");
 
     }
 
+    if (Tuning.ReceiveBufferSize != 0) {
+        SetSocketOption(Acceptor.native_handle(), SOL_SOCKET, SO_RCVBUF, Tuning.ReceiveBufferSize, "SO_RCVBUF");
+
+    }
+
+    Acceptor.bind(Endpoint);
+    Acceptor.listen();
+
 }
 
-void Sockets::Handler(Sockets* Ptr) {
-    //Handles setup, send/receive, and maintenance of socket (reconnections).
-    Logger.Debug("Socket Tools: Sockets::Handler(): Starting up...");
-    int Sent;
-    int ReadResult;
+static string DescribeEndpoint(const StreamProtocol::endpoint& Endpoint) {
+    //For log messages. Unix domain socket clients don't have an address worth showing.
+    if (Endpoint.protocol().family() == AF_INET || Endpoint.protocol().family() == AF_INET6) {
+        tcp::endpoint Address;
 
-    //Setup the socket.
-    Logger.Debug("Socket Tools: Sockets::Handler(): Calling Ptr->CreateAndConnect to set the socket up...");
-    Ptr->CreateAndConnect(Ptr);
+        std::memcpy(Address.data(), Endpoint.data(), Endpoint.size());
+        Address.resize(Endpoint.size());
 
-    Logger.Debug("Socket Tools: Sockets::Handler(): Done! Entering main loop.");
+        return Address.address().to_string();
 
-    //Keep sending and receiving messages until we're asked to exit.
-    while (!Ptr->HandlerShouldExit) {
-        //Send any pending messages.
-        Sent = Ptr->SendAnyPendingMessages();
+    }
 
-        //Receive messages if there are any.
-        ReadResult = Ptr->AttemptToReadFromSocket();
+    return "a local client";
 
-        //Check if the peer left.
-        if (ReadResult == -1) {
-            Logger.Debug("Socket Tools: Sockets::Handler(): Lost connection to peer. Attempting to reconnect...");
+}
 
-            if (Ptr->Verbose) {
-                std::cout << std::endl << std::endl << "Lost connection to peer. Reconnecting..." << std::endl;
+//Command line options.
+bool IsTuningOption(const string& Option) {
+    return Option == "--nodelay" || Option == "--sndbuf" || Option == "--rcvbuf" || Option == "--quickack"
+           || Option == "--busypoll" || Option == "--keepalive";
+
+}
+
+void ParseTuningOption(const string& Option, const string& Value, SocketTuning& Tuning) {
+    //Sets the option named by Option to Value, as given on the command line.
+    try {
+        if (Option == "--nodelay" || Option == "--quickack") {
+            if (Value != "on" && Value != "off") {
+                throw std::runtime_error("Option value invalid.");
 
             }
 
-            //Reset the socket. Also sets the tracker.
-            Logger.Debug("Socket Tools: Sockets::Handler(): Resetting socket...");
-            Ptr->Reset();
+            bool& Flag = (Option == "--nodelay") ? Tuning.NoDelay : Tuning.QuickAck;
+            Flag = (Value == "on");
 
-            //Wait for the socket to reconnect or we're requested to exit.
-            //Wait for 2 seconds first.
-            std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+        } else if (Option == "--keepalive") {
+            //IDLE, or IDLE,INTERVAL,COUNT.
+            vector<string> Values = split(Value, ",");
 
-            Logger.Debug("Socket Tools: Sockets::Handler(): Recreating and attempting to reconnect the socket...");
-            Ptr->CreateAndConnect(Ptr);
+            if (Values.size() != 1 && Values.size() != 3) {
+                throw std::runtime_error("Option value invalid.");
 
-            //If reconnection was successful, set flag and tell user.
-            if (!Ptr->HandlerShouldExit) {
-                Logger.Debug("Socket Tools: Sockets::Handler(): Success! Telling user and re-entering main loop...");
-                Ptr->Reconnected = true;
+            }
 
-                if (Ptr->Verbose) {
-                    std::cerr << "Reconnected to peer." << std::endl << "Press ENTER to continue." << std::endl;
+            Tuning.KeepAliveIdle = std::stoi(Values[0]);
+
+            if (Values.size() == 3) {
+                Tuning.KeepAliveInterval = std::stoi(Values[1]);
+                Tuning.KeepAliveCount = std::stoi(Values[2]);
 
-                }
             }
+
+        } else if (Option == "--sndbuf") {
+            Tuning.SendBufferSize = std::stoi(Value);
+
+        } else if (Option == "--rcvbuf") {
+            Tuning.ReceiveBufferSize = std::stoi(Value);
+
+        } else if (Option == "--busypoll") {
+            Tuning.BusyPoll = std::stoi(Value);
+
         }
-    }
 
-    //Flag that we've exited.
-    Logger.Debug("Socket Tools: Sockets::Handler(): Exiting as per the request...");
-    Ptr->HandlerExited = true;
+        //Negative sizes and times.
+        CheckTuning(Tuning);
+
+    } catch (std::logic_error const& e) {
+        //std::stoi() throws std::invalid_argument or std::out_of_range.
+        throw std::runtime_error("Option value invalid.");
 
+    }
 }
 
-//---------- Connection Functions (Plugs) ----------
-void Sockets::CreatePlug() {
-    //Sets up the plug for us.
-    Logger.Info("Socket Tools: Sockets::CreatePlug(): Creating the plug...");
+//Connection states.
+string ConnectionStateName(const ConnectionState State) {
+    switch (State) {
+    case ConnectionState::Disconnected:
+        return "Disconnected";
 
-    io_service = std::shared_ptr<boost::asio::io_service>(new boost::asio::io_service());
+    case ConnectionState::Connecting:
+        return "Connecting";
 
-    //DNS resolution.
-    tcp::resolver resolver(*io_service);
-    tcp::resolver::query query(ServerAddress, std::to_string(PortNumber));
-    endpoint_iterator = resolver.resolve(query);
+    case ConnectionState::Connected:
+        return "Connected";
 
-    Socket = std::shared_ptr<tcp::socket>(new tcp::socket(*io_service));
+    case ConnectionState::Reconnecting:
+        return "Reconnecting";
 
-    Logger.Info("Socket Tools: Sockets::CreatePlug(): Done!");
+    case ConnectionState::Closing:
+        return "Closing";
 
-}
+    case ConnectionState::Closed:
+        return "Closed";
 
-void Sockets::ConnectPlug() { //*** ERROR HANDLING ***
-    //Waits until the plug has connected to a socket.
-    Logger.Info("Socket Tools: Sockets::ConnectPlug(): Attempting to connect to the requested socket...");
+    }
 
-    boost::asio::connect(*Socket, endpoint_iterator);
+    return "Unknown";
 
-    Logger.Info("Socket Tools: Sockets::ConnectPlug(): Done!");
+}
+
+//Define Sockets' functions.
+//---------- Constructors ----------
+Sockets::Sockets(std::shared_ptr<boost::asio::io_service> Service, std::shared_ptr<StreamProtocol::socket> AcceptedSocket)
+    : Socket(AcceptedSocket), Type("Session"), HandlerMode("Async"),
+      IncomingQueue(SessionQueueCapacity), OutgoingQueue(SessionQueueCapacity), ReceivePool(SessionQueueCapacity), io_service(Service) {
+    //Used by SocketServer for connections it has accepted. Runs on the server's io_service instead of its own handler thread.
+    Verbose = false;
+    State = ConnectionState::Connecting;
+
+    //Sessions have much smaller queues, so scale the watermarks down to match.
+    IncomingWatermarks = {SessionQueueCapacity, SessionQueueCapacity / 2, 1024 * 1024, 512 * 1024};
+    OutgoingWatermarks = {SessionQueueCapacity, SessionQueueCapacity / 2, 1024 * 1024, 512 * 1024};
 
 }
 
-//---------- Connection Functions (Sockets) ----------
-void Sockets::CreateSocket() {
-    //Sets up the socket for us.
-    Logger.Info("Socket Tools: Sockets::CreateSocket(): Creating the socket...");
+Sockets::~Sockets() {
+    ReleaseBoostObjects();
 
-    io_service = std::shared_ptr<boost::asio::io_service>(new boost::asio::io_service());
+    if (WakeDescriptor != -1) {
+        close(WakeDescriptor);
 
-    acceptor = std::shared_ptr<tcp::acceptor>(new tcp::acceptor(*io_service, tcp::endpoint(tcp::v4(), PortNumber)));
-    Socket = std::shared_ptr<tcp::socket>(new tcp::socket(*io_service));
+    }
 
-    Logger.Info("Socket Tools: Sockets::CreateSocket(): Done!");
+    if (Type == "Socket") {
+        RemoveSocketFile(ServerAddress);
 
+    }
 }
 
-void Sockets::ConnectSocket() {
-    //Waits until the socket has connected to a plug.
-    Logger.Info("Socket Tools: Sockets::ConnectSocket(): Attempting to connect to the requested socket...");
+//---------- Setup Functions ----------
+void Sockets::SetPortNumber(const int& PortNo) {
+    Logger.Debug("Socket Tools: Sockets::SetPortNumber(): Setting PortNumber to "+std::to_string(PortNo)+"...");
+    PortNumber = PortNo;
 
-    acceptor->accept(*Socket);
+}
 
-    Logger.Info("Socket Tools: Sockets::ConnectSocket(): Done!");
+//Where a plug connects to, or a socket listens on. Either can use a Unix domain socket with a "unix:" address.
+void Sockets::SetServerAddress(const string& ServerAdd) {
+    Logger.Debug("Socket Tools: Sockets::SetServerAddress(): Setting ServerAddress to "+ServerAdd+"...");
+    ServerAddress = ServerAdd;
 
 }
 
-//--------- Read/Write Functions ----------
-void Sockets::Write(vector<char> Msg) {
-    //Pushes a message to the outgoing message queue so it can be written later by the handler thread.
-    Logger.Debug("Socket Tools: Sockets::Write(): Pushing "+ConvertToString(Msg)+" to OutgoingQueue...");
-    OutgoingQueue.push(Msg);
+void Sockets::SetConsoleOutput(const bool State) {
+    //Can tell us not to output any messages to console (used in server).
+    Logger.Debug("Socket Tools: Sockets::SetConsoleOutput(): Setting Verbose to "+boost::lexical_cast<string>(State)+"...");
+    Verbose = State;
 
 }
 
-void Sockets::SendToPeer(const vector<char>& Msg) {
-    //Sends the given message to the peer and waits for an acknowledgement). A convenience function. *** TODO If ACK is very slow, try again *** *** Will need to change this later cos if there's a high volume of messages it might fail ***
-    Logger.Debug("Socket Tools: Sockets::SendToPeer(): Sending message "+ConvertToString(Msg)+" to peer...");
-
-    //Push it to the message queue.
-    Write(Msg);
+void Sockets::SetHandlerMode(const string& Mode) {
+    //"Polling" sends and reads in a loop, waiting up to a second in epoll each time.
+    //"Async" uses completion handlers on io_service, so messages are sent as soon as they are queued.
+    if (Mode != "Polling" && Mode != "Async") {
+        Logger.Debug("Socket Tools: Sockets::SetHandlerMode(): Invalid mode "+Mode+"! Throwing runtime_error...");
+        throw std::runtime_error("Invalid handler mode");
 
-    //Wait until an \x06 (ACK) has arrived.
-    Logger.Debug("Socket Tools: Sockets::SendToPeer(): Waiting for acknowledgement...");
-    while (!HasPendingData()) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
 
-    //Remove the ACK from the queue.
-    Logger.Info("Socket Tools: Sockets::SendToPeer(): Done.");
-    Pop();
+    Logger.Debug("Socket Tools: Sockets::SetHandlerMode(): Setting HandlerMode to "+Mode+"...");
+    HandlerMode = Mode;
 
 }
 
-bool Sockets::HasPendingData() {
-    //Returns true if there's data on the queue to read, else false.
-    return !IncomingQueue.empty();
+void Sockets::SetEdgeTriggered(const bool State) {
+    //Edge-triggered epoll saves a wakeup per read when data arrives faster than we can handle it.
+    Logger.Debug("Socket Tools: Sockets::SetEdgeTriggered(): Setting EdgeTriggered to "+boost::lexical_cast<string>(State)+"...");
+    EdgeTriggered = State;
 
 }
 
-vector<char> Sockets::Read() {
-    //Returns the item at the front of IncomingQueue.
-    Logger.Debug("Socket Tools: Sockets::Read(): Returning front of IncomingQueue..."); 
-    vector<char> Temp = IncomingQueue.front();
+void Sockets::SetSendWindow(const int& Size) {
+    //Sets how many reliable messages can be waiting for an acknowledgement before SendReliable() blocks.
+    if (Size < 1) {
+        Logger.Debug("Socket Tools: Sockets::SetSendWindow(): Invalid window size! Throwing runtime_error...");
+        throw std::runtime_error("Send window must be at least 1");
 
-    return Temp;
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SetSendWindow(): Setting SendWindow to "+std::to_string(Size)+"...");
+    SendWindow = Size;
 
 }
 
-void Sockets::Pop() {
-    //Clears the front element from IncomingQueue. Prevents crash also if the queue is empty.
-    if (!IncomingQueue.empty()) {
-        Logger.Debug("Socket Tools: Sockets::Pop(): Clearing front element of IncomingQueue...");
-        IncomingQueue.pop();
+void Sockets::SetWriteBatchLimits(const int& MaxFrames, const int& MaxBytes) {
+    //Sets the most frames, and bytes, the handler will send with one write. A frame bigger than MaxBytes is still sent, on its own.
+    if (MaxFrames < 1 || MaxBytes < 1) {
+        Logger.Debug("Socket Tools: Sockets::SetWriteBatchLimits(): Invalid limits! Throwing runtime_error...");
+        throw std::runtime_error("Write batch limits must be at least 1");
 
     }
 
+    Logger.Debug("Socket Tools: Sockets::SetWriteBatchLimits(): Setting MaxBatchFrames to "+std::to_string(MaxFrames)+" and MaxBatchBytes to "+std::to_string(MaxBytes)+"...");
+    MaxBatchFrames = MaxFrames;
+    MaxBatchBytes = MaxBytes;
+
+    //One extra header for an acknowledgement.
+    WriteHeaders.resize((MaxBatchFrames + 1) * FrameHeaderSize);
+
 }
 
-//---------- Other Functions ----------
-int Sockets::SendAnyPendingMessages() {
-    //Sends any messages waiting in the message queue.
-    Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Sending any pending messages...");
+void Sockets::AddChannel(const std::uint8_t ID, const int& Weight) {
+    //Adds a logical channel with its own queues. When several channels have messages waiting, each write is shared
+    //between them in proportion to their weights.
+    if (Weight < 1) {
+        Logger.Debug("Socket Tools: Sockets::AddChannel(): Invalid weight! Throwing runtime_error...");
+        throw std::runtime_error("Channel weight must be at least 1");
 
-    //Setup. 
-    boost::system::error_code Error;
+    } else if (ID == 0) {
+        Logger.Debug("Socket Tools: Sockets::AddChannel(): Setting the weight of channel 0 to "+std::to_string(Weight)+"...");
+        ChannelWeights[0] = Weight;
+        return;
 
-    try {
-        //Wait until there's something to send in the queue.
-        if (OutgoingQueue.empty()) {
-            Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Nothing to send.");
-            return false;
-        }
+    } else if (ChannelsByID[ID] != nullptr) {
+        Logger.Debug("Socket Tools: Sockets::AddChannel(): Channel "+std::to_string(ID)+" already exists! Throwing runtime_error...");
+        throw std::runtime_error("Channel already exists");
 
-        //Write the data.
-        Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Sending data...");
-        boost::asio::write(*Socket, boost::asio::buffer(OutgoingQueue.front()), Error);
+    }
 
-        if (Error == boost::asio::error::eof) {
-            Logger.Error("Socket Tools: Sockets::SendAnyPendingMessages(): Connection was closed cleanly by the peer...");
-            return false; // Connection closed cleanly by peer. *** HANDLE BETTER ***
-    
-        } else if (Error) {
-            Logger.Error("Socket Tools: Sockets::SendAnyPendingMessages(): Other error from boost! throwing boost::system::system_error...");
-            throw boost::system::system_error(Error); // Some other error.
+    Logger.Debug("Socket Tools: Sockets::AddChannel(): Adding channel "+std::to_string(ID)+" with weight "+std::to_string(Weight)+"...");
 
-        }
+    Channels.push_back(std::make_shared<LogicalChannel>(ID, IncomingQueue.GetCapacity()));
+    ChannelsByID[ID] = Channels.back().get();
+    ChannelWeights.push_back(Weight);
+    ChannelDeficits.push_back(0);
+    ChannelFramesInBatch.push_back(0);
 
-        //Remove last thing from message queue.
-        Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Clearing item at front of OutgoingQueue...");
-        OutgoingQueue.pop();  
+}
 
-    } catch (std::exception& err) {
-        Logger.Error("Socket Tools: Sockets::SendAnyPendingMessages(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
-        std::cerr << "Error: " << err.what() << std::endl;
-    }
+void Sockets::SetOnMessage(const std::function<void(const Message&)>& Callback) {
+    //Hands each message to Callback as soon as it arrives, on the handler thread, instead of queuing it for Read().
+    Logger.Debug("Socket Tools: Sockets::SetOnMessage(): Setting message callback...");
+    OnMessage = Callback;
 
-    Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Done.");
-    return true;
 }
 
-int Sockets::AttemptToReadFromSocket() {
-    //Attempts to read some data from the socket.
-    Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Attempting to read some data from the socket...");
+void Sockets::SetOnControl(const std::function<void(const Message&)>& Callback) {
+    //Hands each control message from the peer to Callback, on the handler thread. Without one, they're dropped.
+    Logger.Debug("Socket Tools: Sockets::SetOnControl(): Setting control message callback...");
+    OnControl = Callback;
 
-    //Setup.
-    std::vector<char>* MyBuffer = new std::vector<char> (128, '#');
-    boost::system::error_code Error;
-    int Result;
+}
 
-    try {
-        //This is a solution I found on Stack Overflow, but it means this is no longer platform independant :( I'll keep researching.
-        //Set up a timed select call, so we can handle timeout cases.
-        fd_set fileDescriptorSet;
-        struct timeval timeStruct;
+void Sockets::AddStateCallback(const std::function<void(const ConnectionState, const ConnectionState)>& Callback) {
+    //Callback is called with the old and new state whenever the state changes, on whichever thread changed it. It
+    //mustn't block, or call anything that waits for the handler.
+    Logger.Debug("Socket Tools: Sockets::AddStateCallback(): Adding state change callback...");
+    StateCallbacks.push_back(Callback);
 
-        //Set the timeout to 1 second
-        timeStruct.tv_sec = 1;
-        timeStruct.tv_usec = 0;
-        FD_ZERO(&fileDescriptorSet);
+}
 
-        //We'll need to get the underlying native socket for this select call, in order
-        //to add a simple timeout on the read:
-        int nativeSocket = Socket->native();
+void Sockets::SetReconnectBackoff(const int& InitialDelay, const int& MaxDelay, const int& MaxAttempts) {
+    //Sets how long to wait between attempts to reconnect, and how many attempts to make before giving up.
+    if (InitialDelay < 1 || MaxDelay < InitialDelay || MaxAttempts < 1) {
+        Logger.Debug("Socket Tools: Sockets::SetReconnectBackoff(): Invalid backoff settings! Throwing runtime_error...");
+        throw std::runtime_error("Invalid reconnect backoff settings");
 
-        FD_SET(nativeSocket, &fileDescriptorSet);
+    }
 
-        //Don't use mutexes here (blocks writing).
-        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Waiting for data...");
+    Logger.Debug("Socket Tools: Sockets::SetReconnectBackoff(): Waiting "+std::to_string(InitialDelay)+" to "+std::to_string(MaxDelay)+" ms between up to "+std::to_string(MaxAttempts)+" attempts...");
+    InitialReconnectDelay = std::chrono::milliseconds(InitialDelay);
+    MaxReconnectDelay = std::chrono::milliseconds(MaxDelay);
+    MaxReconnectAttempts = MaxAttempts;
 
-        Result = select(nativeSocket+1, &fileDescriptorSet, NULL, NULL, &timeStruct);
+}
 
-        if (!FD_ISSET(nativeSocket, &fileDescriptorSet)) {
-            //We timed-out. Return.
-            Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Timed out. Giving up for now...");
-            return 0;
+void Sockets::SetHeartbeat(const int& Interval, const int& MissedLimit) {
+    //Sets how often we ping the peer, and how many intervals it can be silent for before we assume it's gone.
+    if (Interval < 0 || MissedLimit < 1) {
+        Logger.Debug("Socket Tools: Sockets::SetHeartbeat(): Invalid heartbeat settings! Throwing runtime_error...");
+        throw std::runtime_error("Invalid heartbeat settings");
 
-        } else if (Result == -1) {
-            //Error. Socket is probably closed.
-            Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Socket is closed!");
-            return -1;
+    }
 
-        }
+    Logger.Debug("Socket Tools: Sockets::SetHeartbeat(): Pinging every "+std::to_string(Interval)+" ms, allowing "+std::to_string(MissedLimit)+" missed heartbeat(s)...");
+    HeartbeatInterval = std::chrono::milliseconds(Interval);
+    MissedHeartbeatLimit = MissedLimit;
 
-        //Try to read some data.
-        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Attempting to read some data...");
+}
 
-        Socket->read_some(boost::asio::buffer(*MyBuffer), Error);
+void Sockets::SetDrainTimeout(const int& Timeout) {
+    //Sets how long the handler keeps sending queued messages for once it's asked to exit.
+    if (Timeout < 0) {
+        Logger.Debug("Socket Tools: Sockets::SetDrainTimeout(): Invalid drain timeout! Throwing runtime_error...");
+        throw std::runtime_error("Invalid drain timeout");
 
-        if (Error == boost::asio::error::eof) {
-            Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Socket closed cleanly by peer! Returning -1...");
+    }
 
-            return -1; // Connection closed cleanly by peer.
+    Logger.Debug("Socket Tools: Sockets::SetDrainTimeout(): Draining for up to "+std::to_string(Timeout)+" ms on exit...");
+    DrainTimeout = std::chrono::milliseconds(Timeout);
 
-        } else if (Error) {
-            Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Other error from boost! throwing boost::system::system_error...");
-            throw boost::system::system_error(Error); // Some other error.
+}
 
-        }
+void Sockets::SetIncomingWatermarks(const QueueWatermarks& Watermarks) {
+    //Sets when the handler stops reading from the socket, and when it starts again.
+    if (Watermarks.HighMessages < 1 || Watermarks.HighMessages > IncomingQueue.GetCapacity()
+        || Watermarks.LowMessages > Watermarks.HighMessages || Watermarks.LowBytes > Watermarks.HighBytes) {
+        Logger.Debug("Socket Tools: Sockets::SetIncomingWatermarks(): Invalid watermarks! Throwing runtime_error...");
+        throw std::runtime_error("Invalid watermarks");
 
-        //Remove any remaining "#"s.
-        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Erasing any remaining '#'s from the message...");
-        MyBuffer->erase(std::remove(MyBuffer->begin(), MyBuffer->end(), '#'), MyBuffer->end());
+    }
 
-        //Push to the message queue.
-        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Pushing message to IncomingQueue...");
-        IncomingQueue.push(*MyBuffer);
+    Logger.Debug("Socket Tools: Sockets::SetIncomingWatermarks(): Pausing reads at "+std::to_string(Watermarks.HighMessages)+" messages or "+std::to_string(Watermarks.HighBytes)+" bytes...");
+    IncomingWatermarks = Watermarks;
 
-        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Done.");
+}
 
-        return Result;
+void Sockets::SetOutgoingWatermarks(const QueueWatermarks& Watermarks) {
+    //Sets when Write() considers OutgoingQueue full, and when it has drained enough to accept messages again.
+    if (Watermarks.HighMessages < 1 || Watermarks.HighMessages > OutgoingQueue.GetCapacity()
+        || Watermarks.LowMessages > Watermarks.HighMessages || Watermarks.LowBytes > Watermarks.HighBytes) {
+        Logger.Debug("Socket Tools: Sockets::SetOutgoingWatermarks(): Invalid watermarks! Throwing runtime_error...");
+        throw std::runtime_error("Invalid watermarks");
 
-    } catch (std::exception& err) {
-        Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
-        std::cerr << "Error: " << err.what() << std::endl;
-        return -1;
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SetOutgoingWatermarks(): Throttling writes at "+std::to_string(Watermarks.HighMessages)+" messages or "+std::to_string(Watermarks.HighBytes)+" bytes...");
+    OutgoingWatermarks = Watermarks;
+
+}
+
+void Sockets::SetWritePolicy(const std::string& Policy) {
+    //Sets what Write() does when OutgoingQueue is full.
+    if (Policy != "Block" && Policy != "Fail" && Policy != "Drop") {
+        Logger.Debug("Socket Tools: Sockets::SetWritePolicy(): Invalid write policy "+Policy+"! Throwing runtime_error...");
+        throw std::runtime_error("Invalid write policy");
 
     }
+
+    Logger.Debug("Socket Tools: Sockets::SetWritePolicy(): Setting write policy to "+Policy+"...");
+    WritePolicy = Policy;
+
 }
 
-//---------- Operators ----------
-std::shared_ptr<tcp::socket> Sockets::operator * () {
-    //Return the socket.
-    Logger.Info("Socket Tools: Sockets::AttemptToReadFromSocket(): Returning a std::shared_ptr to the socket as requested...");
-    return Socket;
+void Sockets::SetCompressionThreshold(const int& Threshold) {
+    //Sets the smallest message we'll try to compress.
+    if (Threshold < 0) {
+        Logger.Debug("Socket Tools: Sockets::SetCompressionThreshold(): Invalid threshold! Throwing runtime_error...");
+        throw std::runtime_error("Invalid compression threshold");
 
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SetCompressionThreshold(): Compressing messages of at least "+std::to_string(Threshold)+" bytes...");
+    CompressionThreshold = Threshold;
+
+}
+
+void Sockets::SetTuning(const SocketTuning& NewTuning) {
+    //Sets every socket option at once.
+    try {
+        CheckTuning(NewTuning);
+
+    } catch (std::runtime_error const& e) {
+        Logger.Debug("Socket Tools: Sockets::SetTuning(): Invalid socket tuning! Throwing runtime_error...");
+        throw;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SetTuning(): Setting socket options...");
+    Tuning = NewTuning;
+
+}
+
+void Sockets::SetNoDelay(const bool State) {
+    //Turns Nagle's algorithm off (true, the default) or on.
+    Logger.Debug("Socket Tools: Sockets::SetNoDelay(): Setting TCP_NODELAY to "+std::to_string(State)+"...");
+    Tuning.NoDelay = State;
+
+}
+
+void Sockets::SetBufferSizes(const int& SendSize, const int& ReceiveSize) {
+    //Sets the kernel's send and receive buffer sizes, in bytes. 0 leaves the system default.
+    SocketTuning NewTuning = Tuning;
+    NewTuning.SendBufferSize = SendSize;
+    NewTuning.ReceiveBufferSize = ReceiveSize;
+
+    SetTuning(NewTuning);
+
+}
+
+void Sockets::SetQuickAck(const bool State) {
+    //Acknowledges data as soon as it arrives, instead of waiting for a reply to carry the acknowledgement.
+    Logger.Debug("Socket Tools: Sockets::SetQuickAck(): Setting TCP_QUICKACK to "+std::to_string(State)+"...");
+    Tuning.QuickAck = State;
+
+}
+
+void Sockets::SetBusyPoll(const int& Microseconds) {
+    //Sets how long the kernel spins waiting for packets when we read an empty socket. 0 leaves the system default.
+    SocketTuning NewTuning = Tuning;
+    NewTuning.BusyPoll = Microseconds;
+
+    SetTuning(NewTuning);
+
+}
+
+void Sockets::SetKeepAlive(const int& Idle, const int& Interval, const int& Count) {
+    //Turns TCP keepalive on after Idle seconds without traffic, or off if Idle is 0. Interval and Count can be 0 for
+    //the system defaults.
+    SocketTuning NewTuning = Tuning;
+    NewTuning.KeepAliveIdle = Idle;
+    NewTuning.KeepAliveInterval = Interval;
+    NewTuning.KeepAliveCount = Count;
+
+    SetTuning(NewTuning);
+
+}
+
+void Sockets::AddCompressor(std::shared_ptr<Compressor> Codec) {
+    //Adds a codec, and prefers it to the ones we already have. Replaces any codec with the same ID.
+    if (Codec == nullptr || Codec->GetID() == 0) {
+        Logger.Debug("Socket Tools: Sockets::AddCompressor(): Invalid codec! Throwing runtime_error...");
+        throw std::runtime_error("Invalid compression codec");
+
+    }
+
+    for (std::size_t i = 0; i < Compressors.size(); i++) {
+        if (Compressors[i]->GetID() == Codec->GetID()) {
+            Compressors.erase(Compressors.begin() + i);
+            break;
+
+        }
+    }
+
+    if (Compressors.size() >= MaxHelloCodecs) {
+        Logger.Debug("Socket Tools: Sockets::AddCompressor(): Too many codecs! Throwing runtime_error...");
+        throw std::runtime_error("Too many compression codecs");
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::AddCompressor(): Adding codec "+Codec->GetName()+"...");
+    Compressors.insert(Compressors.begin(), Codec);
+
+}
+
+void Sockets::StartHandler() {
+    //Starts the handler thread and then returns.
+    //Setup.
+    State = ConnectionState::Disconnected;
+    Reconnected = false;
+    HandlerShouldExit = false;
+    ConnectionUnusable = false;
+
+    if (Type == "Plug" || Type == "Socket") {
+        //Write() and RequestHandlerExit() wake the handler with this.
+        if (WakeDescriptor == -1) {
+            WakeDescriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+            if (WakeDescriptor == -1) {
+                throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()), "eventfd");
+
+            }
+        }
+
+        Logger.Debug("Socket Tools: Sockets::StartHandler(): Check passed, starting handler...");
+        SetState(ConnectionState::Connecting);
+        HandlerThread = std::thread(Handler, this);
+
+    } else {
+        Logger.Debug("Socket Tools: Sockets::StartHandler(): Type isn't set correctly! Throwing runtime_error...");
+        throw std::runtime_error("Type not set correctly");
+
+    }
+
+}
+
+//---------- Info getter functions ----------
+bool Sockets::IsReady() {
+    return State == ConnectionState::Connected;
+
+}
+
+bool Sockets::JustReconnected() {
+    //Clear and return Reconnected.
+    bool Temp = Reconnected;
+    Reconnected = false;
+
+    return Temp;
+
+}
+
+void Sockets::WaitForHandlerToExit() {
+    //Sessions don't have a handler thread of their own.
+    if (HandlerThread.joinable()) {
+        HandlerThread.join();
+
+    }
+
+}
+
+bool Sockets::HandlerHasExited() {
+    return State == ConnectionState::Closed;
+
+}
+
+ConnectionState Sockets::GetState() {
+    return State;
+
+}
+
+bool Sockets::WaitForState(const ConnectionState Wanted, const std::chrono::milliseconds& Timeout) {
+    //Nothing follows Closed, so stop waiting then too. SetState() takes StateMutex before notifying, so we can't miss
+    //a change between checking State and starting to wait.
+    std::unique_lock<std::mutex> Lock(StateMutex);
+    StateChanged.wait_for(Lock, Timeout, [this, Wanted]() { ConnectionState Current = State; return Current == Wanted || Current == ConnectionState::Closed; });
+
+    return State == Wanted;
+
+}
+
+bool Sockets::WaitForState(const ConnectionState Wanted) {
+    std::unique_lock<std::mutex> Lock(StateMutex);
+    StateChanged.wait(Lock, [this, Wanted]() { ConnectionState Current = State; return Current == Wanted || Current == ConnectionState::Closed; });
+
+    return State == Wanted;
+
+}
+
+WriteStatistics Sockets::GetWriteStatistics() {
+    //Returns counters showing how many frames, on average, each write carried.
+    WriteStatistics Stats;
+
+    Stats.Writes = StatWrites;
+    Stats.Messages = StatMessages;
+    Stats.Bytes = StatBytes;
+    Stats.LargestBatch = StatLargestBatch;
+    Stats.CompressedMessages = StatCompressedMessages;
+    Stats.UncompressedBytes = StatUncompressedBytes;
+    Stats.CompressedBytes = StatCompressedBytes;
+
+    return Stats;
+
+}
+
+BufferPoolStatistics Sockets::GetReceivePoolStatistics() {
+    return ReceivePool.GetStatistics();
+
+}
+
+RoundTripStatistics Sockets::GetRoundTripStatistics() {
+    RoundTripStatistics Stats;
+
+    Stats.Samples = RTTSamples;
+    Stats.SmoothedRTT = SmoothedRTT;
+    Stats.Jitter = RTTVariation;
+    Stats.AckTimeout = std::chrono::duration_cast<std::chrono::microseconds>(GetAckTimeout()).count();
+
+    return Stats;
+
+}
+
+QueueStatistics Sockets::GetQueueStatistics() {
+    //Returns how full the message queues are, and how often they've pushed back.
+    QueueStatistics Stats;
+
+    Stats.IncomingMessages = IncomingQueue.Size();
+    Stats.IncomingBytes = IncomingBytes;
+    Stats.OutgoingMessages = OutgoingQueue.Size();
+    Stats.OutgoingBytes = OutgoingBytes;
+    Stats.DroppedMessages = StatDropped;
+    Stats.ReadPauses = StatReadPauses;
+
+    return Stats;
+
+}
+
+SocketTuning Sockets::GetTuning() {
+    //Returns the socket options in use, with the buffer sizes the kernel actually gave us.
+    SocketTuning Current = Tuning;
+
+    Current.SendBufferSize = ActualSendBufferSize;
+    Current.ReceiveBufferSize = ActualReceiveBufferSize;
+
+    return Current;
+
+}
+
+std::chrono::milliseconds Sockets::GetAckTimeout() {
+    //How long an acknowledgement should take to arrive, worked out from the RTT like TCP's retransmission timeout.
+    if (RTTSamples == 0) {
+        return InitialAckTimeout;
+
+    }
+
+    std::chrono::milliseconds Timeout = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::microseconds(SmoothedRTT + 4 * RTTVariation));
+
+    return std::max(MinAckTimeout, std::min(Timeout, MaxAckTimeout));
+
+}
+//---------- Controller Functions ----------
+void Sockets::RequestHandlerExit() {
+    Logger.Debug("Socket Tools: Sockets::RequestHandlerExit(): Requesting handler to exit...");
+    HandlerShouldExit = true;
+
+    //Sessions share the server's io_service, so send what's queued, then close the connection.
+    if (Type == "Session") {
+        std::shared_ptr<Sockets> Self = KeepAlive();
+        PostToStrand([this, Self]() { BeginAsyncDrain(); });
+        return;
+
+    }
+
+    //The polling handler might be waiting for something to read, or for room to write.
+    Wake();
+
+    //The async handler is blocked in io_service->run(). Let it send what's queued first, then stop that too.
+    if (HandlerMode == "Async" && !(CanTransmit() && PostToStrand([this]() { BeginAsyncDrain(); }))) {
+        StopService();
+
+    }
+}
+
+void Sockets::Reset() {
+    //Resets the socket to the default state.
+    Logger.Debug("Socket Tools: Sockets::Reset(): Resetting socket...");
+
+    //Variables for tracking status of the other thread. The handler has already moved State on. Leave HandlerShouldExit
+    //alone, so an exit requested while we're reconnecting isn't forgotten.
+    Reconnected = false;
+    ConnectionUnusable = false;
+
+    //Queues. Messages we've already received are still valid, so leave IncomingQueue alone (we're its producer, so we
+    //can't clear it anyway). Reliable messages are still in Unacknowledged, and are replayed when we reconnect, but
+    //anything else we hadn't sent yet is lost with the connection.
+    std::size_t Dropped = ClearOutgoingQueue();
+
+    if (Dropped != 0) {
+        Logger.Warning("Socket Tools: Sockets::Reset(): Dropped "+std::to_string(Dropped)+" unsent message(s) with the old connection. Use SendReliable() for messages that must survive a reconnect.");
+        StatDropped += Dropped;
+
+    }
+
+    FramesBeingWritten = 0;
+    ControlFramesBeingWritten = 0;
+
+    //Throw away any partial frame from the old connection. The next peer might not support the same codecs.
+    Decoder.Reset();
+    PeerCompressor = nullptr;
+
+    //Our Hello tells the peer what we've received, so there's no need to acknowledge it separately.
+    AckPending = false;
+    SessionEstablished = false;
+    PeerSaidGoodbye = false;
+
+#ifdef STROODLR_IO_URING
+    //Anything still in progress has to finish before the socket (or the ring) goes away.
+    AbandonRing();
+
+#endif
+    //The next connection's socket might get the same descriptor, so stop watching this one now.
+    if (EventReactor != nullptr && RegisteredDescriptor != -1) {
+        EventReactor->Remove(RegisteredDescriptor);
+
+    }
+
+    RegisteredDescriptor = -1;
+    SocketReadable = false;
+
+    //Boost stuff.
+    ReleaseBoostObjects();
+
+    Logger.Debug("Socket Tools: Sockets::Reset(): Done! Socket is now in its default state...");
+}
+
+//---------- Handler Thread & Functions ----------
+bool Sockets::SetState(const ConnectionState NewState) {
+    //Moves to NewState, unless we're closing (when only Closed can follow) or have closed. Wakes anyone waiting in
+    //WaitForState(), then calls the callbacks. Returns false if the state didn't change.
+    ConnectionState OldState = State;
+
+    do {
+        if (OldState == NewState || OldState == ConnectionState::Closed || (OldState == ConnectionState::Closing && NewState != ConnectionState::Closed)) {
+            return false;
+
+        }
+
+    } while (!State.compare_exchange_weak(OldState, NewState));
+
+    Logger.Debug("Socket Tools: Sockets::SetState(): "+ConnectionStateName(OldState)+" -> "+ConnectionStateName(NewState)+"...");
+
+    {
+        std::lock_guard<std::mutex> Lock(StateMutex);
+        StateChanged.notify_all();
+
+    }
+
+    //A Write() waiting for room won't get any now.
+    if (NewState == ConnectionState::Closed) {
+        NotifyOutgoingRoom();
+
+    }
+
+    for (std::size_t i = 0; i < StateCallbacks.size(); i++) {
+        try {
+            StateCallbacks[i](OldState, NewState);
+
+        } catch (std::exception& err) {
+            Logger.Error("Socket Tools: Sockets::SetState(): State change callback threw an exception! Error was "+static_cast<string>(err.what())+"...");
+
+        }
+    }
+
+    return true;
+
+}
+
+bool Sockets::CanTransmit() {
+    //True while there's a connection to send on, including while we're closing it.
+    ConnectionState Current = State;
+
+    return (Current == ConnectionState::Connected || Current == ConnectionState::Closing) && !ConnectionUnusable;
+
+}
+
+void Sockets::SetService(const std::shared_ptr<boost::asio::io_service>& Service) {
+    //Called by the handler thread when it makes a new io_service. See ServiceMutex.
+    std::lock_guard<std::mutex> Lock(ServiceMutex);
+    io_service = Service;
+
+}
+
+void Sockets::SetStrand(const std::shared_ptr<boost::asio::io_service::strand>& NewStrand) {
+    std::lock_guard<std::mutex> Lock(ServiceMutex);
+    Strand = NewStrand;
+
+}
+
+bool Sockets::PostToStrand(const std::function<void()>& Work) {
+    //Posts Work to the async handler's strand from any thread. Returns false if there isn't one. The lock stops the
+    //handler thread replacing or destroying the strand (or its io_service) while we're using it. post() never runs
+    //Work straight away, so it can't come back here and deadlock.
+    std::lock_guard<std::mutex> Lock(ServiceMutex);
+
+    if (Strand == nullptr) {
+        return false;
+
+    }
+
+    Strand->post(Work);
+
+    return true;
+
+}
+
+void Sockets::StopService() {
+    //Stops the async handler's io_service from any thread, if there is one.
+    std::lock_guard<std::mutex> Lock(ServiceMutex);
+
+    if (io_service != nullptr) {
+        io_service->stop();
+
+    }
+}
+
+void Sockets::ReleaseBoostObjects() {
+    //Destroys everything that belongs to the connection's io_service, then the io_service itself. The order of
+    //destruction is important here. Sessions share the server's io_service, so leave it running.
+    std::lock_guard<std::mutex> Lock(ServiceMutex);
+
+    HeartbeatTimer = nullptr;
+    DrainTimer = nullptr;
+    Strand = nullptr;
+    SharedMemory = nullptr;
+    Socket = nullptr;
+    acceptor = nullptr;
+
+    if (io_service != nullptr && Type != "Session") {
+        io_service->stop();
+
+    }
+
+    io_service = nullptr;
+
+}
+
+bool Sockets::CreateAndConnect(Sockets* Ptr) {
+    //Handles connecting/reconnecting the socket. Returns false if we couldn't connect.
+    //Handle any errors while connecting.
+    try {
+        if (Ptr->Type == "Plug") {
+            Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Creating and connecting plug...");
+            Ptr->CreatePlug();
+            Ptr->ConnectPlug();
+
+        } else if (Ptr->Type == "Socket") {
+            Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Creating and connecting socket...");
+            Ptr->CreateSocket();
+            Ptr->ConnectSocket();
+
+        }
+
+        //We are now connected. Start (or resume) the session.
+        Logger.Debug("Socket Tools: Sockets::CreateAndConnect(): Done!");
+        Ptr->SendHello();
+        Ptr->StartHeartbeat();
+
+        if (Ptr->State == ConnectionState::Reconnecting) {
+            Ptr->Reconnected = true;
+
+        }
+
+        Ptr->SetState(ConnectionState::Connected);
+
+        return true;
+
+    } catch (boost::system::system_error const& e) {
+        Logger.Error("Socket Tools: Sockets::CreateAndConnect(): Error connecting: "+static_cast<string>(e.what())+"...");
+
+        if (Ptr->Verbose) {
+            std::cerr << "Connecting Failed: " << e.what() << std::endl;
+
+        }
+
+        return false;
+
+    }
+
+}
+
+bool Sockets::Reconnect() {
+    //Tries to reconnect, waiting longer after each failed attempt. Returns false if we gave up, or were asked to exit.
+    std::chrono::milliseconds Delay = InitialReconnectDelay;
+
+    for (int Attempt = 1; Attempt <= MaxReconnectAttempts && !HandlerShouldExit; Attempt++) {
+        //Wait for somewhere between half and all of Delay, so lots of clients that lost the same server don't all come
+        //back at the same moment.
+        std::chrono::milliseconds Wait = Delay / 2 + std::chrono::milliseconds(RandomNumber() % (Delay.count() / 2 + 1));
+        std::chrono::steady_clock::time_point WaitUntil = std::chrono::steady_clock::now() + Wait;
+
+        Logger.Debug("Socket Tools: Sockets::Reconnect(): Waiting "+std::to_string(Wait.count())+" ms before attempt "+std::to_string(Attempt)+"...");
+
+        //RequestHandlerExit() wakes us up if it's called while we wait.
+        while (!HandlerShouldExit && std::chrono::steady_clock::now() < WaitUntil) {
+            WaitForWake(std::chrono::duration_cast<std::chrono::milliseconds>(WaitUntil - std::chrono::steady_clock::now()) + std::chrono::milliseconds(1));
+
+        }
+
+        if (HandlerShouldExit) {
+            break;
+
+        }
+
+        if (CreateAndConnect(this)) {
+            return true;
+
+        }
+
+        //Tidy up the half-made connection before trying again.
+        Reset();
+        Delay = std::min(Delay * 2, MaxReconnectDelay);
+
+    }
+
+    return false;
+
+}
+
+void Sockets::Handler(Sockets* Ptr) {
+    //Handles setup, send/receive, and maintenance of socket (reconnections).
+    Logger.Debug("Socket Tools: Sockets::Handler(): Starting up...");
+    int Sent;
+    int ReadResult;
+
+    //Setup the socket.
+    Logger.Debug("Socket Tools: Sockets::Handler(): Calling Ptr->CreateAndConnect to set the socket up...");
+
+    if (!Ptr->CreateAndConnect(Ptr)) {
+        Logger.Critical("Socket Tools: Sockets::Handler(): Couldn't connect. Exiting...");
+
+        if (Ptr->Verbose) {
+            std::cerr << "Press ENTER to exit." << std::endl;
+
+        }
+
+        Ptr->HandlerShouldExit = true;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::Handler(): Done! Entering main loop.");
+
+    //Keep sending and receiving messages until we're asked to exit.
+    while (!Ptr->HandlerShouldExit) {
+        if (Ptr->HandlerMode == "Async") {
+            //Let the completion handlers do the work. Only returns when we lose the connection or are asked to exit.
+            ReadResult = Ptr->RunAsyncHandler();
+
+        } else if (!Ptr->CheckHeartbeat()) {
+            //The peer has gone quiet. Treat it like any other lost connection.
+            ReadResult = -1;
+
+#ifdef STROODLR_IO_URING
+        } else if (Ptr->SharedMemory == nullptr && Ptr->SetUpRing()) {
+            //Send and receive with io_uring.
+            ReadResult = Ptr->RunRingIteration();
+
+#endif
+        } else {
+            //Send any pending messages.
+            Sent = Ptr->SendAnyPendingMessages();
+
+            //Receive messages if there are any.
+            ReadResult = Ptr->AttemptToReadFromSocket();
+
+        }
+
+        //Check if the peer left.
+        if (ReadResult == -1) {
+            Logger.Debug("Socket Tools: Sockets::Handler(): Lost connection to peer. Attempting to reconnect...");
+
+            if (Ptr->Verbose) {
+                std::cout << std::endl << std::endl << (Ptr->PeerSaidGoodbye ? "Peer closed the connection." : "Lost connection to peer.") << " Reconnecting..." << std::endl;
+
+            }
+
+            //Reset the socket.
+            Logger.Debug("Socket Tools: Sockets::Handler(): Resetting socket...");
+            Ptr->SetState(ConnectionState::Reconnecting);
+            Ptr->Reset();
+
+            //Wait for the socket to reconnect or we're requested to exit.
+            Logger.Debug("Socket Tools: Sockets::Handler(): Recreating and attempting to reconnect the socket...");
+
+            if (Ptr->Reconnect()) {
+                //Set flag and tell user.
+                Logger.Debug("Socket Tools: Sockets::Handler(): Success! Telling user and re-entering main loop...");
+
+                if (Ptr->Verbose) {
+                    std::cerr << "Reconnected to peer." << std::endl << "Press ENTER to continue." << std::endl;
+
+                }
+
+            } else if (!Ptr->HandlerShouldExit) {
+                Logger.Critical("Socket Tools: Sockets::Handler(): Giving up on reconnecting. Exiting...");
+
+                if (Ptr->Verbose) {
+                    std::cerr << "Couldn't reconnect to peer." << std::endl << "Press ENTER to exit." << std::endl;
+
+                }
+
+                Ptr->HandlerShouldExit = true;
+
+            }
+        }
+    }
+
+    //Send whatever is still queued, then let the peer know we're going on purpose, so it doesn't wait for us to come back.
+    if (Ptr->State == ConnectionState::Connected) {
+        Ptr->SetState(ConnectionState::Closing);
+
+    }
+
+    Ptr->Drain();
+    Ptr->SayGoodbye((Ptr->Type == "Plug") ? GoodbyeClosing : GoodbyeShuttingDown);
+
+    //Flag that we've exited.
+    WriteStatistics Stats = Ptr->GetWriteStatistics();
+    BufferPoolStatistics PoolStats = Ptr->GetReceivePoolStatistics();
+    QueueStatistics QueueStats = Ptr->GetQueueStatistics();
+    Logger.Info("Socket Tools: Sockets::Handler(): Sent "+std::to_string(Stats.Messages)+" message(s) with "+std::to_string(Stats.Writes)+" write(s) (at most "+std::to_string(Stats.LargestBatch)+" per write).");
+    Logger.Info("Socket Tools: Sockets::Handler(): Compressed "+std::to_string(Stats.CompressedMessages)+" message(s) from "+std::to_string(Stats.UncompressedBytes)+" to "+std::to_string(Stats.CompressedBytes)+" bytes.");
+    Logger.Info("Socket Tools: Sockets::Handler(): Receive buffers: "+std::to_string(PoolStats.Hits)+" pool hit(s), "+std::to_string(PoolStats.Misses)+" miss(es), at most "+std::to_string(PoolStats.HighWaterMark)+" in use at once.");
+    Logger.Info("Socket Tools: Sockets::Handler(): Paused reads "+std::to_string(QueueStats.ReadPauses)+" time(s), dropped "+std::to_string(QueueStats.DroppedMessages)+" outgoing message(s).");
+    Logger.Debug("Socket Tools: Sockets::Handler(): Exiting as per the request...");
+    Ptr->SetState(ConnectionState::Closed);
+    Ptr->FailUnacknowledged();
+    Ptr->NotifyDataArrived();
+
+}
+
+//---------- Connection Functions (Plugs) ----------
+void Sockets::CreatePlug() {
+    //Sets up the plug for us.
+    Logger.Info("Socket Tools: Sockets::CreatePlug(): Creating the plug...");
+
+    SetService(std::shared_ptr<boost::asio::io_service>(new boost::asio::io_service()));
+
+    Endpoints.clear();
+
+    if (IsLocalAddress(ServerAddress)) {
+        //Local, so there's nothing to resolve.
+        Endpoints.push_back(boost::asio::local::stream_protocol::endpoint(LocalPath(ServerAddress)));
+
+    } else {
+        //DNS resolution.
+        tcp::resolver resolver(*io_service);
+        tcp::resolver::query query(ServerAddress, std::to_string(PortNumber));
+
+        for (tcp::resolver::iterator It = resolver.resolve(query); It != tcp::resolver::iterator(); It++) {
+            Endpoints.push_back(It->endpoint());
+
+        }
+    }
+
+    Socket = std::shared_ptr<StreamProtocol::socket>(new StreamProtocol::socket(*io_service));
+
+    Logger.Info("Socket Tools: Sockets::CreatePlug(): Done!");
+
+}
+
+void Sockets::ConnectPlug() { //*** ERROR HANDLING ***
+    //Waits until the plug has connected to a socket.
+    Logger.Info("Socket Tools: Sockets::ConnectPlug(): Attempting to connect to the requested socket...");
+
+    //Try each endpoint in turn, like boost::asio::connect() does. The socket is opened with the right protocol for each.
+    boost::system::error_code Error = boost::asio::error::host_not_found;
+
+    for (std::size_t i = 0; i < Endpoints.size(); i++) {
+        Socket->close(Error);
+        Socket->open(Endpoints[i].protocol(), Error);
+
+        if (Error) {
+            continue;
+
+        }
+
+        //Before connecting, so the buffer sizes are taken into account when the TCP window scale is agreed.
+        ApplyTuning();
+        Socket->connect(Endpoints[i], Error);
+
+        if (!Error) {
+            break;
+
+        }
+    }
+
+    if (Error) {
+        throw boost::system::system_error(Error);
+
+    }
+
+    if (IsSharedMemoryAddress(ServerAddress)) {
+        Logger.Info("Socket Tools: Sockets::ConnectPlug(): Sending shared memory to the socket...");
+        SharedMemory = std::make_shared<SharedMemoryStream>(Socket->native_handle(), SharedMemoryRingSize);
+
+    }
+
+    Logger.Info("Socket Tools: Sockets::ConnectPlug(): Done!");
+
+}
+
+//---------- Connection Functions (Sockets) ----------
+void Sockets::CreateSocket() {
+    //Sets up the socket for us.
+    Logger.Info("Socket Tools: Sockets::CreateSocket(): Creating the socket...");
+
+    SetService(std::shared_ptr<boost::asio::io_service>(new boost::asio::io_service()));
+
+    acceptor = std::shared_ptr<StreamAcceptor>(new StreamAcceptor(*io_service));
+    OpenAcceptor(*acceptor, ServerAddress, PortNumber, Tuning);
+    Socket = std::shared_ptr<StreamProtocol::socket>(new StreamProtocol::socket(*io_service));
+
+    Logger.Info("Socket Tools: Sockets::CreateSocket(): Done!");
+
+}
+
+void Sockets::ConnectSocket() {
+    //Waits until the socket has connected to a plug.
+    Logger.Info("Socket Tools: Sockets::ConnectSocket(): Attempting to connect to the requested socket...");
+
+    acceptor->accept(*Socket);
+    ApplyTuning();
+
+    if (IsSharedMemoryAddress(ServerAddress)) {
+        Logger.Info("Socket Tools: Sockets::ConnectSocket(): Waiting for shared memory from the plug...");
+        SharedMemory = std::make_shared<SharedMemoryStream>(Socket->native_handle());
+
+    }
+
+    Logger.Info("Socket Tools: Sockets::ConnectSocket(): Done!");
+
+}
+
+//---------- Tuning Functions ----------
+void Sockets::ApplyTuning() {
+    //Sets our socket options on Socket, which must be open. Only the buffer sizes mean anything for Unix domain sockets.
+    Logger.Debug("Socket Tools: Sockets::ApplyTuning(): Setting socket options...");
+
+    int Descriptor = Socket->native_handle();
+
+    if (Tuning.SendBufferSize != 0) {
+        SetSocketOption(Descriptor, SOL_SOCKET, SO_SNDBUF, Tuning.SendBufferSize, "SO_SNDBUF");
+
+    }
+
+    if (Tuning.ReceiveBufferSize != 0) {
+        SetSocketOption(Descriptor, SOL_SOCKET, SO_RCVBUF, Tuning.ReceiveBufferSize, "SO_RCVBUF");
+
+    }
+
+    QuickAckActive = false;
+
+    if (!IsLocalAddress(ServerAddress)) {
+        SetSocketOption(Descriptor, IPPROTO_TCP, TCP_NODELAY, Tuning.NoDelay, "TCP_NODELAY");
+
+        if (Tuning.QuickAck) {
+            QuickAckActive = SetSocketOption(Descriptor, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+
+        }
+
+        if (Tuning.BusyPoll != 0) {
+            SetSocketOption(Descriptor, SOL_SOCKET, SO_BUSY_POLL, Tuning.BusyPoll, "SO_BUSY_POLL");
+
+        }
+
+        if (Tuning.KeepAliveIdle != 0) {
+            SetSocketOption(Descriptor, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+            SetSocketOption(Descriptor, IPPROTO_TCP, TCP_KEEPIDLE, Tuning.KeepAliveIdle, "TCP_KEEPIDLE");
+
+            if (Tuning.KeepAliveInterval != 0) {
+                SetSocketOption(Descriptor, IPPROTO_TCP, TCP_KEEPINTVL, Tuning.KeepAliveInterval, "TCP_KEEPINTVL");
+
+            }
+
+            if (Tuning.KeepAliveCount != 0) {
+                SetSocketOption(Descriptor, IPPROTO_TCP, TCP_KEEPCNT, Tuning.KeepAliveCount, "TCP_KEEPCNT");
+
+            }
+        }
+    }
+
+    //Remember what we actually got, for GetTuning().
+    int Size;
+    socklen_t Length = sizeof(Size);
+
+    if (getsockopt(Descriptor, SOL_SOCKET, SO_SNDBUF, &Size, &Length) == 0) {
+        ActualSendBufferSize = Size;
+
+    }
+
+    Length = sizeof(Size);
+
+    if (getsockopt(Descriptor, SOL_SOCKET, SO_RCVBUF, &Size, &Length) == 0) {
+        ActualReceiveBufferSize = Size;
+
+    }
+}
+
+void Sockets::RearmQuickAck() {
+    //Linux turns TCP_QUICKACK off again whenever it decides to delay an acknowledgement, so set it after every read.
+    if (QuickAckActive) {
+        int On = 1;
+        setsockopt(Socket->native_handle(), IPPROTO_TCP, TCP_QUICKACK, &On, sizeof(On));
+
+    }
+}
+
+//--------- Read/Write Functions ----------
+bool Sockets::Write(const Message& Msg) {
+    //Pushes a message to the outgoing message queue so it can be written later by the handler thread. If the queue is
+    //full, WritePolicy decides whether we wait, throw, or drop the message.
+    Logger.Debug("Socket Tools: Sockets::Write(): Pushing a "+std::to_string(Msg.Size())+" byte message to OutgoingQueue...");
+
+    Frame NewFrame;
+    NewFrame.Header.Length = Msg.Size();
+    NewFrame.Payload = Msg;
+
+    return QueueFrame(NewFrame, WritePolicy);
+
+}
+
+std::size_t Sockets::WriteBatch(const Message* Messages, const std::size_t Count) {
+    //Pushes Count messages to the outgoing message queue with as few handoffs to the handler as possible. WritePolicy
+    //applies as in Write(). Returns the number of messages queued.
+    Logger.Debug("Socket Tools: Sockets::WriteBatch(): Pushing "+std::to_string(Count)+" message(s) to OutgoingQueue...");
+
+    vector<Frame> Frames(Count);
+
+    for (std::size_t i = 0; i < Count; i++) {
+        Frames[i].Header.Length = Messages[i].Size();
+        Frames[i].Payload = Messages[i];
+
+    }
+
+    return QueueFrames(Frames, WritePolicy);
+
+}
+
+std::size_t Sockets::WriteBatch(const std::vector<Message>& Messages) {
+    return WriteBatch(Messages.data(), Messages.size());
+
+}
+
+std::future<bool> Sockets::SendReliable(const Message& Msg) {
+    //Queues Msg with a sequence number, so the peer will acknowledge it. Doesn't wait for the acknowledgement unless the
+    //send window is full. The returned future becomes true when it's acknowledged, or false if the connection is lost first.
+    Logger.Debug("Socket Tools: Sockets::SendReliable(): Sending a "+std::to_string(Msg.Size())+" byte message to peer...");
+
+    std::promise<bool> Acknowledged;
+    std::future<bool> Result = Acknowledged.get_future();
+    std::unique_lock<std::mutex> Lock(SendWindowMutex);
+
+    //Wait for room in the send window. FailUnacknowledged() wakes us if the handler exits.
+    while (Unacknowledged.size() >= SendWindow && !HandlerHasExited()) {
+        Logger.Debug("Socket Tools: Sockets::SendReliable(): Send window is full. Waiting for acknowledgements...");
+        SendWindowChanged.wait(Lock);
+
+    }
+
+    if (HandlerHasExited()) {
+        Logger.Error("Socket Tools: Sockets::SendReliable(): The handler has exited! Dropping message...");
+        Acknowledged.set_value(false);
+        return Result;
+
+    }
+
+    //0 means "don't acknowledge", so skip it when we wrap around.
+    NextSequence++;
+
+    if (NextSequence == 0) {
+        NextSequence++;
+
+    }
+
+    Frame NewFrame;
+    NewFrame.Header.Length = Msg.Size();
+    NewFrame.Header.Sequence = NextSequence;
+    NewFrame.Payload = Msg;
+
+    //Register it before it's queued, so the acknowledgement can't arrive first.
+    PendingAck Pending;
+    Pending.Sequence = NextSequence;
+    Pending.Payload = Msg;
+    Pending.Acknowledged = std::move(Acknowledged);
+    Unacknowledged.push_back(std::move(Pending));
+
+    Lock.unlock();
+
+    //The send window already limits how many of these can be queued, so always wait for room.
+    if (!QueueFrame(NewFrame, "Block")) {
+        FailUnacknowledged();
+
+    }
+
+    return Result;
+
+}
+
+bool Sockets::SendToPeer(const Message& Msg) {
+    //Sends the given message to the peer and waits for it to be acknowledged. A convenience function.
+    Logger.Debug("Socket Tools: Sockets::SendToPeer(): Sending message and waiting for acknowledgement...");
+
+    std::future<bool> Acknowledged = SendReliable(Msg);
+    std::chrono::milliseconds Timeout = GetAckTimeout();
+
+    if (Acknowledged.wait_for(Timeout) != std::future_status::ready) {
+        //It's still queued (and will be replayed if we reconnect), but don't keep the caller waiting.
+        Logger.Error("Socket Tools: Sockets::SendToPeer(): Message wasn't acknowledged within "+std::to_string(Timeout.count())+" ms. Giving up waiting...");
+        return false;
+
+    }
+
+    if (Acknowledged.get()) {
+        Logger.Info("Socket Tools: Sockets::SendToPeer(): Done.");
+        return true;
+
+    }
+
+    Logger.Error("Socket Tools: Sockets::SendToPeer(): Message wasn't acknowledged before the connection was lost!");
+    return false;
+
+}
+
+bool Sockets::SendControl(const Message& Msg) {
+    //Queues Msg on the control lane, which the handler empties before sending anything from the channels. Never waits.
+    Logger.Debug("Socket Tools: Sockets::SendControl(): Pushing a "+std::to_string(Msg.Size())+" byte control message to ControlQueue...");
+
+    if (HandlerHasExited()) {
+        Logger.Error("Socket Tools: Sockets::SendControl(): The handler has exited! Dropping control message...");
+        return false;
+
+    }
+
+    Frame NewFrame;
+    NewFrame.Header.Type = FrameTypeControl;
+    NewFrame.Header.Length = Msg.Size();
+    NewFrame.Payload = Msg;
+
+    if (!ControlQueue.Push(std::move(NewFrame))) {
+        Logger.Error("Socket Tools: Sockets::SendControl(): ControlQueue is full! Dropping control message...");
+        return false;
+
+    }
+
+    NotifyFramesQueued();
+
+    return true;
+
+}
+
+bool Sockets::HasPendingData() {
+    //Returns true if there's data on the queue to read, else false.
+    return !IncomingQueue.Empty();
+
+}
+
+bool Sockets::WaitForData(const std::chrono::milliseconds& Timeout) {
+    //Waits until there's data on the queue to read, the handler exits, or Timeout passes. Returns true if there's data.
+    std::unique_lock<std::mutex> Lock(DataMutex);
+
+    DataArrived.wait_for(Lock, Timeout, [this]() { return !IncomingQueue.Empty() || HandlerHasExited(); });
+
+    return !IncomingQueue.Empty();
+
+}
+
+Message Sockets::ReadBlocking() {
+    //Waits for a message, then returns it and removes it from IncomingQueue.
+    std::unique_lock<std::mutex> Lock(DataMutex);
+
+    DataArrived.wait(Lock, [this]() { return !IncomingQueue.Empty() || HandlerHasExited(); });
+    Lock.unlock();
+
+    if (IncomingQueue.Empty()) {
+        Logger.Debug("Socket Tools: Sockets::ReadBlocking(): Handler exited while waiting! Throwing runtime_error...");
+        throw std::runtime_error("Handler exited");
+
+    }
+
+    Message Temp = std::move(IncomingQueue.Front());
+    IncomingQueue.Pop();
+    IncomingBytes -= Temp.Size();
+
+    //The caller keeps the buffer (if it had one), so it won't go back to the pool.
+    if (Temp.HasBuffer()) {
+        ReceivePool.Forget();
+
+    }
+
+    NotifyIncomingRoom(false);
+
+    return Temp;
+
+}
+
+std::size_t Sockets::DrainAll(std::vector<Message>& Out, const std::size_t Max) {
+    //Moves up to Max messages from IncomingQueue onto the end of Out in one go. Returns the number moved.
+    std::size_t Start = Out.size();
+    std::size_t Count = IncomingQueue.PopMany(Out, Max);
+    std::uint64_t Bytes = 0;
+
+    for (std::size_t i = Start; i < Out.size(); i++) {
+        Bytes += Out[i].Size();
+
+        //The caller keeps the buffers, so they won't go back to the pool.
+        if (Out[i].HasBuffer()) {
+            ReceivePool.Forget();
+
+        }
+    }
+
+    IncomingBytes -= Bytes;
+    NotifyIncomingRoom(false);
+
+    Logger.Debug("Socket Tools: Sockets::DrainAll(): Took "+std::to_string(Count)+" message(s) from IncomingQueue...");
+
+    return Count;
+
+}
+
+Message Sockets::Read() {
+    //Returns the item at the front of IncomingQueue. The payload is shared, not copied.
+    Logger.Debug("Socket Tools: Sockets::Read(): Returning front of IncomingQueue..."); 
+    return IncomingQueue.Front();
+
+}
+
+void Sockets::Pop() {
+    //Clears the front element from IncomingQueue. Prevents crash also if the queue is empty.
+    if (!IncomingQueue.Empty()) {
+        Logger.Debug("Socket Tools: Sockets::Pop(): Clearing front element of IncomingQueue...");
+
+        //Recycle the buffer for the next message, unless the application is still holding on to it from Read().
+        //Small messages are stored inline, so they never had a buffer from the pool.
+        Message& Front = IncomingQueue.Front();
+        vector<char> Buffer;
+
+        IncomingBytes -= Front.Size();
+
+        if (Front.TakeBuffer(Buffer)) {
+            ReceivePool.Release(std::move(Buffer));
+
+        } else if (Front.HasBuffer()) {
+            ReceivePool.Forget();
+
+        }
+
+        IncomingQueue.Pop();
+        NotifyIncomingRoom(false);
+
+    }
+
+}
+
+bool Sockets::Write(const Message& Msg, const std::uint8_t Channel) {
+    //Like Write(), but on a logical channel. Channels other than 0 are only limited by the size of their queues.
+    FindChannel(Channel);
+
+    Logger.Debug("Socket Tools: Sockets::Write(): Pushing a "+std::to_string(Msg.Size())+" byte message to channel "+std::to_string(Channel)+"...");
+
+    Frame NewFrame;
+    NewFrame.Header.Length = Msg.Size();
+    NewFrame.Header.Channel = Channel;
+    NewFrame.Payload = Msg;
+
+    return QueueFrame(NewFrame, WritePolicy);
+
+}
+
+bool Sockets::HasPendingData(const std::uint8_t Channel) {
+    if (Channel == 0) {
+        return HasPendingData();
+
+    }
+
+    return !FindChannel(Channel)->IncomingQueue.Empty();
+
+}
+
+Message Sockets::Read(const std::uint8_t Channel) {
+    //Returns the front message on the channel. Don't call this unless HasPendingData(Channel) is true.
+    if (Channel == 0) {
+        return Read();
+
+    }
+
+    return FindChannel(Channel)->IncomingQueue.Front();
+
+}
+
+void Sockets::Pop(const std::uint8_t Channel) {
+    //Clears the front message on the channel, recycling its buffer like Pop() does.
+    if (Channel == 0) {
+        Pop();
+        return;
+
+    }
+
+    LogicalChannel* Target = FindChannel(Channel);
+
+    if (!Target->IncomingQueue.Empty()) {
+        Message& Front = Target->IncomingQueue.Front();
+        vector<char> Buffer;
+
+        if (Front.TakeBuffer(Buffer)) {
+            ReceivePool.Release(std::move(Buffer));
+
+        } else if (Front.HasBuffer()) {
+            ReceivePool.Forget();
+
+        }
+
+        Target->IncomingQueue.Pop();
+        NotifyIncomingRoom(true);
+
+    }
+}
+
+LogicalChannel* Sockets::FindChannel(const std::uint8_t Channel) {
+    //Returns one of the channels added with AddChannel(), or nullptr for channel 0. Throws std::runtime_error if it
+    //doesn't exist.
+    if (Channel != 0 && ChannelsByID[Channel] == nullptr) {
+        Logger.Debug("Socket Tools: Sockets::FindChannel(): No such channel "+std::to_string(Channel)+"! Throwing runtime_error...");
+        throw std::runtime_error("No such channel");
+
+    }
+
+    return ChannelsByID[Channel];
+
+}
+
+//---------- Other Functions ----------
+int Sockets::SendAnyPendingMessages() {
+    //Sends any messages waiting in the message queue, in batches.
+    Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Sending any pending messages...");
+
+    //Setup. 
+    std::vector<boost::asio::const_buffer> Buffers;
+    std::size_t SentFrames;
+    std::size_t SentControlFrames;
+
+    try {
+        //Wait until there's something to send in the queue.
+        if (!HaveFramesToSend()) {
+            Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Nothing to send.");
+            return false;
+        }
+
+        while (HaveFramesToSend()) {
+            //Gather a batch of headers and payloads and write them all at once, without copying them into one buffer.
+            Buffers.clear();
+            SentFrames = PrepareWrite(Buffers, SentControlFrames);
+
+            Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Sending "+std::to_string(SentFrames)+" message(s)...");
+            if (WriteWhileReading(Buffers) == -1) {
+                Logger.Error("Socket Tools: Sockets::SendAnyPendingMessages(): Connection was closed by the peer...");
+                return false; // Connection closed by peer. *** HANDLE BETTER ***
+
+            }
+
+            RecordWrite(SentFrames, boost::asio::buffer_size(Buffers));
+
+            //Remove what we just sent from the message queue.
+            Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Clearing sent items from OutgoingQueue...");
+            FinishWrite(SentControlFrames, SentFrames);
+
+        }
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::SendAnyPendingMessages(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
+        std::cerr << "Error: " << err.what() << std::endl;
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SendAnyPendingMessages(): Done.");
+    return true;
+}
+
+int Sockets::AttemptToReadFromSocket() {
+    //Attempts to read some data from the socket.
+    Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Attempting to read some data from the socket...");
+
+    try {
+        //If the application hasn't kept up, leave the data in the socket until it has drained IncomingQueue.
+        if (!PushReceivedFrames()) {
+            //The application wakes us once it has made room (as do Write() and RequestHandlerExit()).
+            Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): IncomingQueue is above its watermarks. Not reading for now...");
+            WaitForWake(std::chrono::duration_cast<std::chrono::milliseconds>(HandlerWaitTimeout()));
+            return 0;
+
+        }
+
+        //Register the socket the first time we wait on this connection. The eventfd stays registered across reconnects.
+        if (EventReactor == nullptr) {
+            EventReactor.reset(new Reactor(EdgeTriggered));
+            EventReactor->Add(WakeDescriptor, true, false);
+
+        }
+
+        if (RegisteredDescriptor == -1) {
+            RegisteredDescriptor = (SharedMemory != nullptr) ? SharedMemory->GetReadDescriptor() : Socket->native_handle();
+            EventReactor->Add(RegisteredDescriptor, true, false);
+
+        }
+
+        //The peer only wakes us if we ask it to, so do that now, unless it's already written something.
+        if (!SocketReadable && SharedMemory != nullptr && !SharedMemory->PrepareToWait()) {
+            SocketReadable = true;
+
+        }
+
+        //In edge-triggered mode, we won't hear about data we left in the socket last time, so don't wait for it.
+        if (!SocketReadable) {
+            //Don't use mutexes here (blocks writing).
+            Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Waiting for data...");
+
+            if (EventReactor->Wait(HandlerWaitTimeout(), ReadyEvents) == 0) {
+                //We timed-out. Return.
+                Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Timed out. Giving up for now...");
+                return 0;
+
+            }
+
+            for (std::size_t i = 0; i < ReadyEvents.size(); i++) {
+                if (ReadyEvents[i].FileDescriptor == WakeDescriptor) {
+                    ClearWake();
+
+                } else {
+                    SocketReadable = true;
+
+                }
+            }
+
+            if (!SocketReadable) {
+                //We were woken up to send something, or to exit. The handler will deal with it.
+                Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Woken up. Returning...");
+                return 0;
+
+            }
+        }
+
+        //Try to read some data. Hangups and errors are reported by the read itself.
+        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Attempting to read some data...");
+
+        if (SharedMemory != nullptr) {
+            SocketReadable = false;
+            return ReadFromSharedMemory();
+
+        } else if (EdgeTriggered) {
+            return ReadUntilWouldBlock();
+
+        }
+
+        boost::system::error_code Error;
+        std::size_t Space;
+        char* Destination = Decoder.PrepareRead(Space);
+        std::size_t BytesRead = Socket->read_some(boost::asio::buffer(Destination, Space), Error);
+        SocketReadable = false;
+
+        if (Error == boost::asio::error::eof) {
+            Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Socket closed cleanly by peer! Returning -1...");
+
+            return -1; // Connection closed cleanly by peer.
+
+        } else if (Error) {
+            Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Other error from boost! throwing boost::system::system_error...");
+            throw boost::system::system_error(Error); // Some other error.
+
+        }
+
+        //The data is already in the decoder's ring. It keeps hold of any partial frame until the rest arrives.
+        LastHeardFrom = std::chrono::steady_clock::now();
+        Decoder.Commit(BytesRead);
+        RearmQuickAck();
+
+        //Push every complete frame to the message queue.
+        PushReceivedFrames();
+
+        Logger.Debug("Socket Tools: Sockets::AttemptToReadFromSocket(): Done.");
+
+        return 1;
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::AttemptToReadFromSocket(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
+        std::cerr << "Error: " << err.what() << std::endl;
+        return -1;
+
+    }
+}
+
+int Sockets::WriteWhileReading(const vector<boost::asio::const_buffer>& Buffers) {
+    //Writes all of Buffers. Whenever we can't write any more, reads anything the peer has sent while we wait, because
+    //it might be waiting for us to read before it can read what we're sending. Returns -1 if the peer has gone. Throws
+    //boost::system::system_error on other errors.
+    int Descriptor = Socket->native_handle();
+    std::size_t Total = boost::asio::buffer_size(Buffers);
+    std::size_t Written = 0;
+
+    while (true) {
+        Written += (SharedMemory != nullptr) ? SharedMemory->WriteSome(Buffers, Written) : SendSome(Buffers, Written);
+
+        if (Written == Total) {
+            return 1;
+
+        }
+
+        //Wait until we can write more, or there's something to read (unless IncomingQueue is full).
+        bool CanRead = PushReceivedFrames();
+        pollfd Descriptors[3];
+        nfds_t Count = 1;
+
+        if (SharedMemory != nullptr) {
+            if (!SharedMemory->PrepareToWaitForSpace()) {
+                continue;
+
+            }
+
+            if (CanRead && !SharedMemory->PrepareToWait()) {
+                //There's something to read already. Reading it might be what the peer needs to make room.
+                if (ReadFromSharedMemory() == -1) {
+                    return -1;
+
+                }
+
+                continue;
+
+            }
+
+            Descriptors[0] = {SharedMemory->GetSpaceDescriptor(), POLLIN, 0};
+            Descriptors[1] = {SharedMemory->GetReadDescriptor(), POLLIN, 0};
+            Count = CanRead ? 2 : 1;
+
+        } else {
+            Descriptors[0] = {Descriptor, static_cast<short>(CanRead ? POLLIN | POLLOUT : POLLOUT), 0};
+
+        }
+
+        //Also wait for RequestHandlerExit(), so a peer that has stopped reading can't keep us here forever.
+        nfds_t WakeIndex = Count++;
+        Descriptors[WakeIndex] = {WakeDescriptor, POLLIN, 0};
+
+        int TimeLeft = DrainTimeLeft();
+
+        if (TimeLeft == 0) {
+            //We're part of the way through a frame, so the connection can't be used for anything else now.
+            Logger.Error("Socket Tools: Sockets::WriteWhileReading(): Ran out of time to send everything! Giving up...");
+            ConnectionUnusable = true;
+            return -1;
+
+        }
+
+        if (poll(Descriptors, Count, TimeLeft) == -1) {
+            if (errno == EINTR) {
+                continue;
+
+            }
+
+            throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()));
+
+        }
+
+        if (Descriptors[WakeIndex].revents & POLLIN) {
+            ClearWake();
+
+            if (HandlerShouldExit && DrainDeadline == std::chrono::steady_clock::time_point::max()) {
+                DrainDeadline = std::chrono::steady_clock::now() + DrainTimeout;
+
+            }
+        }
+
+        short ReadEvents = (SharedMemory != nullptr) ? Descriptors[1].revents : Descriptors[0].revents;
+
+        if (CanRead && (ReadEvents & (POLLIN | POLLHUP | POLLERR))) {
+            if (((SharedMemory != nullptr) ? ReadFromSharedMemory() : ReadUntilWouldBlock()) == -1) {
+                return -1;
+
+            }
+        }
+    }
+}
+
+std::size_t Sockets::SendSome(const vector<boost::asio::const_buffer>& Buffers, const std::size_t Offset) {
+    //Sends as much as the socket will take right now, starting Offset bytes in. Throws boost::system::system_error on errors.
+    std::size_t Skip = Offset;
+
+    SendVector.clear();
+
+    for (std::size_t i = 0; i < Buffers.size() && SendVector.size() < IOV_MAX; i++) {
+        if (Skip >= Buffers[i].size()) {
+            Skip -= Buffers[i].size();
+            continue;
+
+        }
+
+        iovec Entry = {const_cast<char*>(static_cast<const char*>(Buffers[i].data())) + Skip, Buffers[i].size() - Skip};
+        SendVector.push_back(Entry);
+        Skip = 0;
+
+    }
+
+    msghdr Header;
+    std::memset(&Header, 0, sizeof(Header));
+    Header.msg_iov = SendVector.data();
+    Header.msg_iovlen = SendVector.size();
+
+    ssize_t Sent = sendmsg(Socket->native_handle(), &Header, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if (Sent == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+
+        }
+
+        throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()));
+
+    }
+
+    return Sent;
+
+}
+
+int Sockets::ReadUntilWouldBlock() {
+    //Edge-triggered reading. Reads until the socket runs dry, unless IncomingQueue fills up or we've read enough for now
+    //(so sending doesn't have to wait too long). Either way, SocketReadable says whether there might be more.
+    for (int Reads = 0; Reads < MaxReadsPerWakeup; Reads++) {
+        std::size_t Space;
+        char* Destination = Decoder.PrepareRead(Space);
+        ssize_t BytesRead = recv(Socket->native_handle(), Destination, Space, MSG_DONTWAIT);
+
+        if (BytesRead == 0) {
+            Logger.Error("Socket Tools: Sockets::ReadUntilWouldBlock(): Socket closed cleanly by peer! Returning -1...");
+            return -1;
+
+        } else if (BytesRead == -1) {
+            if (errno == EINTR) {
+                continue;
+
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                SocketReadable = false;
+                break;
+
+            }
+
+            Logger.Error("Socket Tools: Sockets::ReadUntilWouldBlock(): Error reading from socket! throwing boost::system::system_error...");
+            throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()));
+
+        }
+
+        LastHeardFrom = std::chrono::steady_clock::now();
+        Decoder.Commit(BytesRead);
+
+        if (!PushReceivedFrames()) {
+            //Leave the rest in the socket. We'll carry on once the application has caught up.
+            break;
+
+        }
+    }
+
+    RearmQuickAck();
+
+    Logger.Debug("Socket Tools: Sockets::ReadUntilWouldBlock(): Done.");
+
+    return 1;
+
+}
+
+int Sockets::ReadFromSharedMemory() {
+    //Hands whatever the peer has written straight from the ring to the decoder, without copying it anywhere else first.
+    //Returns 0 if there was nothing to read, or -1 if the peer has gone.
+    const char* Data;
+    std::size_t Size = SharedMemory->Peek(Data);
+
+    if (Size == 0) {
+        if (SharedMemory->PeerHasGone()) {
+            Logger.Error("Socket Tools: Sockets::ReadFromSharedMemory(): Peer closed the connection! Returning -1...");
+            return -1;
+
+        }
+
+        return 0;
+
+    }
+
+    for (int Reads = 0; Size != 0 && Reads < MaxReadsPerWakeup; Reads++) {
+        LastHeardFrom = std::chrono::steady_clock::now();
+        Decoder.Feed(Data, Size);
+        SharedMemory->Consume(Size);
+
+        if (!PushReceivedFrames()) {
+            //Leave the rest in the ring. We'll carry on once the application has caught up.
+            break;
+
+        }
+
+        Size = SharedMemory->Peek(Data);
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::ReadFromSharedMemory(): Done.");
+
+    return 1;
+
+}
+
+void Sockets::Wake() {
+    //Wakes the polling handler if it's waiting. Only writes to the eventfd if nobody has since the handler last
+    //cleared it, so a burst of Write()s costs one system call.
+    if (WakeDescriptor == -1 || WakePending.exchange(true)) {
+        return;
+
+    }
+
+    std::uint64_t One = 1;
+
+    if (write(WakeDescriptor, &One, sizeof(One)) == -1) {
+        Logger.Error("Socket Tools: Sockets::Wake(): Couldn't wake the handler: "+static_cast<string>(std::strerror(errno))+"...");
+
+    }
+}
+
+void Sockets::ClearWake() {
+    //Called by the handler once the eventfd is readable. WakePending is cleared after reading, so a Wake() in between
+    //writes again rather than being lost. Whoever calls this must check the queues afterwards.
+    std::uint64_t Count;
+
+    if (read(WakeDescriptor, &Count, sizeof(Count)) == -1 && errno != EAGAIN) {
+        Logger.Error("Socket Tools: Sockets::ClearWake(): Couldn't read the eventfd: "+static_cast<string>(std::strerror(errno))+"...");
+
+    }
+
+    WakePending = false;
+
+}
+
+bool Sockets::WaitForWake(const std::chrono::milliseconds& Timeout) {
+    //Sleeps for up to Timeout, or until Wake() is called. Returns true if we were woken.
+    pollfd Descriptor = {WakeDescriptor, POLLIN, 0};
+
+    if (poll(&Descriptor, 1, static_cast<int>(Timeout.count())) <= 0) {
+        return false;
+
+    }
+
+    ClearWake();
+    return true;
+
+}
+
+int Sockets::DrainTimeLeft() {
+    //Returns how many milliseconds we have left to send what's queued, or -1 if we aren't draining.
+    if (DrainDeadline == std::chrono::steady_clock::time_point::max()) {
+        return -1;
+
+    }
+
+    std::chrono::steady_clock::duration Left = DrainDeadline - std::chrono::steady_clock::now();
+
+    if (Left <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+
+    }
+
+    //Round up, so we don't spin for the last part of a millisecond.
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(Left).count()) + 1;
+
+}
+
+std::chrono::microseconds Sockets::HandlerWaitTimeout() {
+    //How long the polling handler can wait for something to happen: up to 1 second, or less if we need to send
+    //heartbeats more often than that, or are running out of time to drain.
+    std::chrono::microseconds Timeout(1000000);
+
+    if (HeartbeatInterval.count() != 0 && HeartbeatInterval < Timeout) {
+        Timeout = HeartbeatInterval;
+
+    }
+
+    if (DrainTimeLeft() != -1) {
+        Timeout = std::min(Timeout, std::chrono::microseconds(std::chrono::milliseconds(DrainTimeLeft())));
+
+    }
+
+    return Timeout;
+
+}
+
+void Sockets::Drain() {
+    //Called by the polling handler once it's been asked to exit. Keeps sending (and reading, in case the peer has to
+    //send something before it can read any more) until everything queued has gone, or we run out of time.
+    if (HandlerMode == "Async" || !CanTransmit() || !HaveUnsentFrames()) {
+        DrainDeadline = std::chrono::steady_clock::time_point::max();
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::Drain(): Sending what's left in the queues...");
+
+    //We might have started already, if we were asked to exit in the middle of a write.
+    if (DrainDeadline == std::chrono::steady_clock::time_point::max()) {
+        DrainDeadline = std::chrono::steady_clock::now() + DrainTimeout;
+
+    }
+
+    bool Sending = true;
+
+    while (Sending && CanTransmit() && DrainTimeLeft() != 0) {
+#ifdef STROODLR_IO_URING
+        if (SharedMemory == nullptr && SetUpRing()) {
+            if (RunRingIteration() == -1) {
+                break;
+
+            }
+
+            Sending = HaveUnsentFrames() || RingSendInFlight;
+            continue;
+
+        }
+
+#endif
+        SendAnyPendingMessages();
+
+        if (CanTransmit() && AttemptToReadFromSocket() == -1) {
+            break;
+
+        }
+
+        Sending = HaveUnsentFrames();
+
+    }
+
+    if (Sending) {
+        Logger.Warning("Socket Tools: Sockets::Drain(): Gave up with messages still waiting to be sent...");
+
+    }
+
+    DrainDeadline = std::chrono::steady_clock::time_point::max();
+
+}
+
+#ifdef STROODLR_IO_URING
+//---------- io_uring Functions ----------
+//Tags for the operations we give the ring. There's only ever one of each.
+static const std::uint64_t RingSendTag = 1;
+static const std::uint64_t RingReceiveTag = 2;
+static const std::uint64_t RingCancelTag = 3;
+static const std::uint64_t RingWakeTag = 4;
+
+bool Sockets::SetUpRing() {
+    //Returns true if we can use io_uring, setting it up the first time. If the kernel doesn't support it, we use epoll.
+    if (Ring != nullptr) {
+        return true;
+
+    } else if (RingUnavailable) {
+        return false;
+
+    }
+
+    try {
+        Ring.reset(new IOUring(64, 64, UringBufferSize));
+        Logger.Info("Socket Tools: Sockets::SetUpRing(): Using io_uring.");
+        return true;
+
+    } catch (boost::system::system_error& err) {
+        Logger.Info("Socket Tools: Sockets::SetUpRing(): io_uring isn't available ("+static_cast<string>(err.what())+"). Using epoll instead.");
+        RingUnavailable = true;
+        return false;
+
+    }
+}
+
+int Sockets::RunRingIteration() {
+    //One loop of the polling handler with io_uring. Returns -1 if the connection was lost.
+    int Descriptor = Socket->native_handle();
+    int Result = 0;
+
+    if (RingFallingBack && !RingSendInFlight && !RingReceiveArmed) {
+        Logger.Info("Socket Tools: Sockets::RunRingIteration(): Switching to epoll...");
+        Ring = nullptr;
+        RingUnavailable = true;
+        RingFallingBack = false;
+        RingWakeArmed = false;
+        return 0;
+
+    }
+
+    try {
+        //Send the next batch, unless the last one is still going. The frames stay in their queues until it's done.
+        if (!RingFallingBack && !RingSendInFlight && HaveFramesToSend()) {
+            RingBuffers.clear();
+            RingFramesInFlight = PrepareWrite(RingBuffers, RingControlFramesInFlight);
+            RingVectors.resize(RingBuffers.size());
+            RingBytesInFlight = 0;
+            RingBytesSent = 0;
+
+            for (std::size_t i = 0; i < RingBuffers.size(); i++) {
+                RingVectors[i].iov_base = const_cast<void*>(boost::asio::buffer_cast<const void*>(RingBuffers[i]));
+                RingVectors[i].iov_len = boost::asio::buffer_size(RingBuffers[i]);
+                RingBytesInFlight += RingVectors[i].iov_len;
+
+            }
+
+            std::memset(&RingMessage, 0, sizeof(RingMessage));
+            RingMessage.msg_iov = RingVectors.data();
+            RingMessage.msg_iovlen = RingVectors.size();
+
+            Logger.Debug("Socket Tools: Sockets::RunRingIteration(): Sending "+std::to_string(RingFramesInFlight)+" message(s)...");
+            Ring->QueueSendMessage(Descriptor, &RingMessage, RingSendTag);
+            RingSendInFlight = true;
+
+        }
+
+        //Keep a receive running, unless the application hasn't kept up with IncomingQueue. Then the data waits in the
+        //socket, like it does with epoll.
+        bool HaveRoom = PushReceivedFrames();
+
+        if (HaveRoom && !RingReceiveArmed && !RingFallingBack) {
+            Ring->QueueMultishotReceive(Descriptor, RingReceiveTag);
+            RingReceiveArmed = true;
+            RingReceiveCancelled = false;
+
+        } else if (!HaveRoom && RingReceiveArmed && !RingReceiveCancelled) {
+            Ring->QueueCancel(RingReceiveTag, RingCancelTag);
+            RingReceiveCancelled = true;
+
+        }
+
+        //Write() and RequestHandlerExit() wake us through the eventfd.
+        if (!RingWakeArmed) {
+            Ring->QueuePoll(WakeDescriptor, RingWakeTag);
+            RingWakeArmed = true;
+
+        }
+
+        //If reads are paused, the application wakes us through the eventfd too, once it has made room.
+        Ring->SubmitAndWait(HandlerWaitTimeout(), RingCompletions);
+
+        for (std::size_t i = 0; i < RingCompletions.size(); i++) {
+            HandleRingCompletion(RingCompletions[i], Result);
+
+        }
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::RunRingIteration(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
+        return -1;
+
+    }
+
+    return Result;
+
+}
+
+void Sockets::HandleRingCompletion(const UringCompletion& Completion, int& Result) {
+    //Deals with one finished operation. Sets Result to -1 if the connection was lost.
+    if (Completion.Tag == RingSendTag) {
+        RingSendInFlight = false;
+
+        if (Completion.Result < 0) {
+            Logger.Error("Socket Tools: Sockets::HandleRingCompletion(): Error writing to socket: "+boost::system::error_code(-Completion.Result, boost::system::system_category()).message()+"...");
+            Result = -1;
+            return;
+
+        } else if (Completion.Result == 0) {
+            Logger.Error("Socket Tools: Sockets::HandleRingCompletion(): Socket wouldn't take any more data! Giving up...");
+            Result = -1;
+            return;
+
+        }
+
+        RingBytesSent += Completion.Result;
+
+        if (RingBytesSent < RingBytesInFlight) {
+            //Older kernels don't retry MSG_WAITALL sends, and a signal can cut one short. Send the rest.
+            Logger.Debug("Socket Tools: Sockets::HandleRingCompletion(): Short write ("+std::to_string(Completion.Result)+" bytes). Sending the other "+std::to_string(RingBytesInFlight - RingBytesSent)+" bytes...");
+            ResubmitRingSend(Completion.Result);
+            return;
+
+        }
+
+        RecordWrite(RingFramesInFlight, RingBytesInFlight);
+        FinishWrite(RingControlFramesInFlight, RingFramesInFlight);
+
+        RingFramesInFlight = 0;
+        RingControlFramesInFlight = 0;
+
+    } else if (Completion.Tag == RingWakeTag) {
+        //The next loop sends whatever woke us, and polls again.
+        RingWakeArmed = false;
+        ClearWake();
+
+    } else if (Completion.Tag == RingReceiveTag) {
+        if (!Completion.More) {
+            RingReceiveArmed = false;
+
+        }
+
+        if (Completion.Result > 0 && Completion.HasBuffer) {
+            //Hand the data to the decoder, and the buffer straight back to the kernel.
+            LastHeardFrom = std::chrono::steady_clock::now();
+            Decoder.Feed(Ring->GetBuffer(Completion.BufferID), Completion.Result);
+            Ring->ReturnBuffer(Completion.BufferID);
+            RearmQuickAck();
+            PushReceivedFrames();
+            return;
+
+        }
+
+        if (Completion.HasBuffer) {
+            Ring->ReturnBuffer(Completion.BufferID);
+
+        }
+
+        if (Completion.Result == -ENOBUFS || Completion.Result == -ECANCELED) {
+            //We ran out of buffers, or cancelled it ourselves. It'll be started again next time.
+            return;
+
+        } else if (Completion.Result == -EINVAL) {
+            //The kernel doesn't support multishot receives. Fall back to epoll once our last send has finished.
+            Logger.Info("Socket Tools: Sockets::HandleRingCompletion(): Multishot receive isn't supported. Using epoll instead.");
+            RingFallingBack = true;
+            return;
+
+        } else if (Completion.Result == 0) {
+            Logger.Error("Socket Tools: Sockets::HandleRingCompletion(): Socket closed cleanly by peer!");
+
+        } else {
+            Logger.Error("Socket Tools: Sockets::HandleRingCompletion(): Error reading from socket: "+boost::system::error_code(-Completion.Result, boost::system::system_category()).message()+"...");
+
+        }
+
+        Result = -1;
+
+    }
+}
+
+void Sockets::ResubmitRingSend(const std::size_t Sent) {
+    //Skips past the first Sent bytes of what RingMessage points to, and queues the rest.
+    std::size_t Skip = Sent;
+    iovec* Vector = RingMessage.msg_iov;
+    std::size_t Count = RingMessage.msg_iovlen;
+
+    while (Count > 0 && Skip >= Vector->iov_len) {
+        Skip -= Vector->iov_len;
+        Vector++;
+        Count--;
+
+    }
+
+    Vector->iov_base = static_cast<char*>(Vector->iov_base) + Skip;
+    Vector->iov_len -= Skip;
+
+    RingMessage.msg_iov = Vector;
+    RingMessage.msg_iovlen = Count;
+
+    Ring->QueueSendMessage(Socket->native_handle(), &RingMessage, RingSendTag);
+    RingSendInFlight = true;
+
+}
+
+void Sockets::AbandonRing() {
+    //Stops whatever the ring is doing, waits for it to finish, and then gets rid of the ring. The socket is about to
+    //be closed, so shutting it down makes sure nothing takes long.
+    if (Ring == nullptr) {
+        return;
+
+    }
+
+    if ((RingSendInFlight || RingReceiveArmed) && Socket != nullptr) {
+        boost::system::error_code Ignored;
+        Socket->shutdown(StreamProtocol::socket::shutdown_both, Ignored);
+
+        if (RingReceiveArmed && !RingReceiveCancelled) {
+            Ring->QueueCancel(RingReceiveTag, RingCancelTag);
+
+        }
+
+        std::vector<UringCompletion> Completions;
+        std::chrono::steady_clock::time_point GiveUp = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+        while ((RingSendInFlight || RingReceiveArmed) && std::chrono::steady_clock::now() < GiveUp) {
+            Ring->SubmitAndWait(std::chrono::milliseconds(100), Completions);
+
+            for (std::size_t i = 0; i < Completions.size(); i++) {
+                if (Completions[i].Tag == RingSendTag) {
+                    RingSendInFlight = false;
+
+                } else if (Completions[i].Tag == RingReceiveTag && !Completions[i].More) {
+                    RingReceiveArmed = false;
+
+                }
+            }
+        }
+
+        if (RingSendInFlight || RingReceiveArmed) {
+            //The kernel still has our buffers. Leaking the ring is better than letting it write to freed memory.
+            Logger.Error("Socket Tools: Sockets::AbandonRing(): io_uring operations didn't finish! Leaking the ring...");
+            Ring.release();
+
+        }
+    }
+
+    Ring = nullptr;
+    RingUnavailable = RingUnavailable || RingFallingBack;
+    RingFallingBack = false;
+    RingSendInFlight = false;
+    RingReceiveArmed = false;
+    RingReceiveCancelled = false;
+    RingWakeArmed = false;
+    RingFramesInFlight = 0;
+    RingControlFramesInFlight = 0;
+
+}
+#endif
+
+bool Sockets::PushReceivedFrames() {
+    //Moves complete frames from the decoder to the incoming queues while there's room. Frames that aren't messages
+    //are always handled, even while reads are paused, so acknowledgements and heartbeats aren't stuck behind a
+    //backlog. A message for a full queue is held aside, and we only stop at the next message for that queue. Returns
+    //false if reads are paused because a queue is above its high watermark (or hasn't yet drained to its low one).
+    FrameHeader Header;
+    bool Pushed = PushHeldMessages();
+
+    while (true) {
+        //Read the frame where it lies in the decoder's buffer. Only messages for the application are copied out.
+        const char* Payload;
+
+        if (!Decoder.PeekFrame(Header, Payload)) {
+            break;
+
+        }
+
+        switch (Header.Type) {
+        case FrameTypeAck:
+            Decoder.Consume();
+            HandleAck(Header.Sequence);
+            continue;
+
+        case FrameTypeHello: {
+            std::uint64_t PeerToken = DecodeSessionToken(Payload);
+            vector<char> PeerCodecs(Payload + SessionTokenSize, Payload + Header.Length);
+
+            Decoder.Consume();
+            HandleHello(PeerToken, Header.Sequence, PeerCodecs);
+            continue;
+
+        }
+
+        case FrameTypePing:
+            Decoder.Consume();
+            HandlePing(DecodeTimestamp(Payload));
+            continue;
+
+        case FrameTypePong:
+            Decoder.Consume();
+            HandlePong(DecodeTimestamp(Payload));
+            continue;
+
+        case FrameTypeControl: {
+            Message Control(Payload, Header.Length);
+
+            Decoder.Consume();
+            HandleControl(Control);
+            continue;
+
+        }
+
+        case FrameTypeGoodbye:
+            Decoder.Consume();
+            HandleGoodbye(Payload[0]);
+            continue;
+
+        default:
+            //A message for the application.
+            break;
+
+        }
+
+        //Work out where it's going before doing anything else with it. A peer that has added a channel we haven't
+        //shouldn't be able to close the connection, so drop messages for it. They're never reliable (the decoder
+        //refuses sequence numbers on any channel but 0), so there's nothing to acknowledge.
+        LogicalChannel* Target = nullptr;
+
+        if (Header.Channel != 0) {
+            Target = ChannelsByID[Header.Channel];
+
+            if (Target == nullptr) {
+                Logger.Warning("Socket Tools: Sockets::PushReceivedFrames(): Message for unknown channel "+std::to_string(Header.Channel)+"! Dropping it...");
+                Decoder.Consume();
+                continue;
+
+            }
+        }
+
+        //If we're already holding a message for this queue, this one has to wait in the decoder behind it.
+        if ((Target != nullptr) ? Target->HaveHeld : HaveHeldMessage) {
+            break;
+
+        }
+
+        //Acknowledge reliable messages (cumulatively) next time we send.
+        if (Header.Sequence != 0) {
+            AckPending = true;
+
+            //After a reconnect, the peer replays everything we hadn't acknowledged, so we might have some of it already.
+            if (!SequenceIsAfter(Header.Sequence, LastReceivedSequence)) {
+                Logger.Debug("Socket Tools: Sockets::PushReceivedFrames(): Dropping duplicate of message "+std::to_string(Header.Sequence)+"...");
+                Decoder.Consume();
+                continue;
+
+            }
+
+            LastReceivedSequence = Header.Sequence;
+
+        }
+
+        //Uncompressed messages stay where they are in the decoder's ring until the application has finished with them.
+        //Compressed ones are decompressed straight out of it into a buffer from the pool.
+        Message NewMessage;
+
+        if (Header.Compressed) {
+            if (SpareBuffer.capacity() == 0) {
+                SpareBuffer = ReceivePool.Acquire();
+
+            }
+
+            DecompressPayload(Compressors, Payload, Header.Length, SpareBuffer);
+            Decoder.Consume();
+
+            //Small messages are copied inline, and SpareBuffer is kept for the next one.
+            NewMessage = Message::Adopt(SpareBuffer);
+
+        } else {
+            NewMessage = Decoder.TakePayload();
+
+        }
+
+        if (Target != nullptr) {
+            if (Target->IncomingQueue.Full()) {
+                Logger.Debug("Socket Tools: Sockets::PushReceivedFrames(): Channel "+std::to_string(Header.Channel)+" is full. Holding message...");
+                Target->Held = std::move(NewMessage);
+                Target->HaveHeld = true;
+
+            } else {
+                Target->IncomingQueue.Push(std::move(NewMessage));
+                Pushed = true;
+
+            }
+
+            UpdateReadsPaused();
+            continue;
+
+        }
+
+        if (OnMessage) {
+            //The application wants messages as soon as they arrive.
+            try {
+                OnMessage(NewMessage);
+
+            } catch (std::exception& err) {
+                Logger.Error("Socket Tools: Sockets::PushReceivedFrames(): Message callback threw an exception! Error was "+static_cast<string>(err.what())+"...");
+
+            }
+
+            //Reuse the buffer (or the space in the ring) straight away, unless the callback kept a copy of the message.
+            if (Header.Compressed && SpareBuffer.capacity() == 0 && !NewMessage.TakeBuffer(SpareBuffer)) {
+                ReceivePool.Forget();
+
+            }
+
+            continue;
+
+        }
+
+        if (!IncomingHasRoom()) {
+            Logger.Debug("Socket Tools: Sockets::PushReceivedFrames(): IncomingQueue is full. Holding message...");
+            HeldMessage = std::move(NewMessage);
+            HaveHeldMessage = true;
+
+        } else {
+            Logger.Debug("Socket Tools: Sockets::PushReceivedFrames(): Pushing message to IncomingQueue...");
+            IncomingBytes += NewMessage.Size();
+            IncomingQueue.Push(std::move(NewMessage));
+            Pushed = true;
+
+        }
+
+        UpdateReadsPaused();
+
+    }
+
+    UpdateReadsPaused();
+
+    if (ReadsPaused) {
+        //The application wakes us once it has made room, but only if it sees we've paused. Check again in case it
+        //made room just before then. The fence pairs with the one in NotifyIncomingRoom().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (PushHeldMessages()) {
+            //Carry on with the frames behind the ones we were holding.
+            NotifyDataArrived();
+            return PushReceivedFrames();
+
+        }
+
+        UpdateReadsPaused();
+
+    }
+
+    //Wake anyone waiting in WaitForData() or ReadBlocking().
+    if (Pushed) {
+        NotifyDataArrived();
+
+    }
+
+    return !ReadsPaused;
+
+}
+
+bool Sockets::PushHeldMessages() {
+    //Pushes the messages PushReceivedFrames() held aside, if their queues have room now. Returns true if it pushed any.
+    bool Pushed = false;
+
+    if (HaveHeldMessage && IncomingHasRoom()) {
+        IncomingBytes += HeldMessage.Size();
+        IncomingQueue.Push(std::move(HeldMessage));
+        HeldMessage = Message();
+        HaveHeldMessage = false;
+        Pushed = true;
+
+    }
+
+    for (std::size_t i = 0; i < Channels.size(); i++) {
+        if (Channels[i]->HaveHeld && !Channels[i]->IncomingQueue.Full()) {
+            Channels[i]->IncomingQueue.Push(std::move(Channels[i]->Held));
+            Channels[i]->Held = Message();
+            Channels[i]->HaveHeld = false;
+            Pushed = true;
+
+        }
+    }
+
+    return Pushed;
+
+}
+
+void Sockets::NotifyDataArrived() {
+    //Taking the lock means a waiter can't miss this between checking the queue and starting to wait.
+    std::lock_guard<std::mutex> Lock(DataMutex);
+    DataArrived.notify_all();
+
+}
+
+bool Sockets::HaveUnsentFrames() {
+    //Like HaveFramesToSend(), but also counts messages that are waiting for the Hello exchange.
+    if (HaveFramesToSend()) {
+        return true;
+
+    }
+
+    for (std::size_t Slot = 0; Slot < ChannelWeights.size(); Slot++) {
+        if (!ChannelOutgoingQueue(Slot).Empty()) {
+            return true;
+
+        }
+    }
+
+    return false;
+
+}
+
+bool Sockets::HaveFramesToSend() {
+    //Messages wait until the Hello exchange is done, but acknowledgements and control frames don't.
+    if (AckPending || !ControlFrames.empty() || !ControlQueue.Empty()) {
+        return true;
+
+    } else if (!SessionEstablished) {
+        return false;
+
+    }
+
+    for (std::size_t Slot = 0; Slot < ChannelWeights.size(); Slot++) {
+        if (!ChannelOutgoingQueue(Slot).Empty()) {
+            return true;
+
+        }
+    }
+
+    return false;
+
+}
+
+std::size_t Sockets::PrepareWrite(std::vector<boost::asio::const_buffer>& Buffers, std::size_t& ControlFramesInBatch) {
+    //Collects what to send next: an acknowledgement if one is due, then our own control frames, then as many messages
+    //from the logical channels' queues as the batch limits allow. Returns the number of messages included, and sets
+    //ControlFramesInBatch, so the caller knows how many of each to pop once they're sent.
+    char* Header = WriteHeaders.data();
+    std::size_t Bytes = 0;
+
+    ControlFramesInBatch = 0;
+    BatchSlots.clear();
+    std::fill(ChannelFramesInBatch.begin(), ChannelFramesInBatch.end(), 0);
+
+    //The application's control messages go ahead of everything but a Hello, so they're sent and popped with our own.
+    std::size_t Position = 0;
+
+    while (Position < ControlFrames.size() && ControlFrames[Position].Header.Type == FrameTypeHello) {
+        Position++;
+
+    }
+
+    while (!ControlQueue.Empty()) {
+        ControlFrames.insert(ControlFrames.begin() + Position++, std::move(ControlQueue.Front()));
+        ControlQueue.Pop();
+
+    }
+
+    if (AckPending) {
+        FrameHeader Ack;
+        Ack.Type = FrameTypeAck;
+        Ack.Sequence = LastReceivedSequence;
+
+        EncodeFrameHeader(Ack, Header);
+        Buffers.push_back(boost::asio::buffer(Header, FrameHeaderSize));
+        Header += FrameHeaderSize;
+        AckPending = false;
+
+    }
+
+    //Control frames share the batch limits with messages.
+    while (ControlFramesInBatch < ControlFrames.size() && ControlFramesInBatch < MaxBatchFrames) {
+        Frame& NextFrame = ControlFrames[ControlFramesInBatch];
+        CompressFrame(NextFrame);
+
+        //Always send at least one frame, even if it's bigger than the limit.
+        if (ControlFramesInBatch > 0 && Bytes + FrameHeaderSize + NextFrame.Payload.Size() > MaxBatchBytes) {
+            break;
+
+        }
+
+        EncodeFrameHeader(NextFrame.Header, Header);
+        Buffers.push_back(boost::asio::buffer(Header, FrameHeaderSize));
+        Buffers.push_back(boost::asio::buffer(NextFrame.Payload.Data(), NextFrame.Payload.Size()));
+
+        Header += FrameHeaderSize;
+        Bytes += FrameHeaderSize + NextFrame.Payload.Size();
+        ControlFramesInBatch++;
+
+    }
+
+    //Only start on the messages once every control frame is on its way, so replayed messages go first.
+    if (!SessionEstablished || ControlFramesInBatch < ControlFrames.size()) {
+        return 0;
+
+    }
+
+    //Visit each channel with messages waiting in turn (deficit round robin). Each visit gives the channel ChannelQuantum
+    //bytes times its weight to spend, and it sends messages until the next one won't fit in what it has left, which it
+    //keeps for its next turn. So a big backlog on one channel only holds up the others for one turn.
+    const std::size_t Slots = ChannelWeights.size();
+    std::size_t IdleSlots = 0;
+
+    while (IdleSlots < Slots) {
+        SPSCQueue<Frame>& Queue = ChannelOutgoingQueue(NextChannel);
+        std::size_t& Taken = ChannelFramesInBatch[NextChannel];
+
+        if (Taken >= Queue.Size()) {
+            //Nothing waiting, so it doesn't get to save anything up.
+            ChannelDeficits[NextChannel] = 0;
+            ChannelTurnStarted = false;
+            NextChannel = (NextChannel + 1) % Slots;
+            IdleSlots++;
+            continue;
+
+        }
+
+        IdleSlots = 0;
+
+        if (!ChannelTurnStarted) {
+            ChannelDeficits[NextChannel] += ChannelQuantum * ChannelWeights[NextChannel];
+
+        }
+
+        ChannelTurnStarted = false;
+
+        while (Taken < Queue.Size()) {
+            Frame& NextFrame = Queue.At(Taken);
+            std::size_t Saved = CompressFrame(NextFrame);
+
+            //OutgoingBytes counts what's left to send on channel 0, so take off whatever compression saved.
+            if (NextChannel == 0) {
+                OutgoingBytes -= Saved;
+
+            }
+
+            const std::size_t FrameBytes = FrameHeaderSize + NextFrame.Payload.Size();
+            const std::size_t InBatch = ControlFramesInBatch + BatchSlots.size();
+
+            if (InBatch >= MaxBatchFrames || (InBatch > 0 && Bytes + FrameBytes > MaxBatchBytes)) {
+                //The batch is full. Carry on with this turn next time.
+                ChannelTurnStarted = true;
+                return BatchSlots.size();
+
+            } else if (static_cast<std::int64_t>(FrameBytes) > ChannelDeficits[NextChannel]) {
+                break;
+
+            }
+
+            EncodeFrameHeader(NextFrame.Header, Header);
+            Buffers.push_back(boost::asio::buffer(Header, FrameHeaderSize));
+            Buffers.push_back(boost::asio::buffer(NextFrame.Payload.Data(), NextFrame.Payload.Size()));
+
+            Header += FrameHeaderSize;
+            Bytes += FrameBytes;
+            ChannelDeficits[NextChannel] -= FrameBytes;
+            BatchSlots.push_back(NextChannel);
+            Taken++;
+
+        }
+
+        NextChannel = (NextChannel + 1) % Slots;
+
+    }
+
+    return BatchSlots.size();
+
+}
+
+void Sockets::FinishWrite(const std::size_t ControlFramesSent, const std::size_t FramesSent) {
+    //Removes the frames PrepareWrite() included once they've been sent.
+    for (std::size_t i = 0; i < ControlFramesSent; i++) {
+        ControlFrames.pop_front();
+
+    }
+
+    //Each channel's messages were taken from the front of its queue, in order.
+    bool ChannelRoom = false;
+
+    for (std::size_t i = 0; i < FramesSent; i++) {
+        if (BatchSlots[i] == 0) {
+            OutgoingBytes -= OutgoingQueue.Front().Payload.Size();
+
+        } else {
+            ChannelRoom = true;
+
+        }
+
+        ChannelOutgoingQueue(BatchSlots[i]).Pop();
+
+    }
+
+    //A Write() waiting for room on OutgoingQueue can't carry on until it's down to its low watermarks.
+    if (ChannelRoom || (FramesSent > 0 && OutgoingQueue.Size() <= OutgoingWatermarks.LowMessages && OutgoingBytes <= OutgoingWatermarks.LowBytes)) {
+        NotifyOutgoingRoom();
+
+    }
+}
+
+std::size_t Sockets::ClearOutgoingQueue() {
+    //Empties OutgoingQueue and the other channels' queues, keeping OutgoingBytes in step. Only call this from the handler.
+    //Returns the number of messages thrown away, not counting reliable ones, which are still in Unacknowledged.
+    std::size_t Dropped = 0;
+
+    for (std::size_t Slot = 0; Slot < ChannelWeights.size(); Slot++) {
+        SPSCQueue<Frame>& Queue = ChannelOutgoingQueue(Slot);
+
+        while (!Queue.Empty()) {
+            if (Slot == 0) {
+                OutgoingBytes -= Queue.Front().Payload.Size();
+
+            }
+
+            if (Queue.Front().Header.Sequence == 0) {
+                Dropped++;
+
+            }
+
+            Queue.Pop();
+
+        }
+    }
+
+    //The application's control messages too, including any we'd already moved to ControlFrames.
+    Dropped += ControlQueue.Size();
+    ControlQueue.Clear();
+
+    for (std::size_t i = 0; i < ControlFrames.size(); i++) {
+        if (ControlFrames[i].Header.Type == FrameTypeControl) {
+            Dropped++;
+
+        }
+    }
+
+    ControlFrames.clear();
+
+    std::fill(ChannelDeficits.begin(), ChannelDeficits.end(), 0);
+    NextChannel = 0;
+    ChannelTurnStarted = false;
+
+    NotifyOutgoingRoom();
+
+    return Dropped;
+
+}
+
+SPSCQueue<Frame>& Sockets::ChannelOutgoingQueue(const std::size_t Slot) {
+    //The write scheduler's slot 0 is channel 0, and the rest are Channels in order.
+    return (Slot == 0) ? OutgoingQueue : Channels[Slot - 1]->OutgoingQueue;
+
+}
+
+bool Sockets::ChannelIncomingFull() {
+    //True if any channel other than 0 has no room for another message, or is holding one back.
+    for (std::size_t i = 0; i < Channels.size(); i++) {
+        if (Channels[i]->IncomingQueue.Full() || Channels[i]->HaveHeld) {
+            return true;
+
+        }
+    }
+
+    return false;
+
+}
+
+bool Sockets::IncomingHasRoom() {
+    //True if IncomingQueue is below both high watermarks. The high watermark is never above the queue's capacity.
+    return IncomingQueue.Size() < IncomingWatermarks.HighMessages && IncomingBytes < IncomingWatermarks.HighBytes;
+
+}
+
+//---------- Compression Functions ----------
+vector<char> Sockets::GetCodecIDs() {
+    //The codecs we tell the peer about in our Hello, most preferred first.
+    vector<char> IDs;
+
+    if (CompressionThreshold == 0) {
+        return IDs;
+
+    }
+
+    for (std::size_t i = 0; i < Compressors.size(); i++) {
+        IDs.push_back(Compressors[i]->GetID());
+
+    }
+
+    return IDs;
+
+}
+
+void Sockets::ChooseCompressor(const vector<char>& PeerCodecs) {
+    //Picks the codec we'll compress with: our favourite of the ones the peer can decompress.
+    PeerCompressor = nullptr;
+
+    if (CompressionThreshold == 0) {
+        return;
+
+    }
+
+    for (std::size_t i = 0; i < Compressors.size(); i++) {
+        if (std::find(PeerCodecs.begin(), PeerCodecs.end(), Compressors[i]->GetID()) != PeerCodecs.end()) {
+            PeerCompressor = Compressors[i];
+            Logger.Info("Socket Tools: Sockets::ChooseCompressor(): Compressing messages of at least "+std::to_string(CompressionThreshold)+" bytes with "+PeerCompressor->GetName()+".");
+            return;
+
+        }
+    }
+
+    Logger.Info("Socket Tools: Sockets::ChooseCompressor(): Peer can't decompress any of our codecs. Not compressing messages...");
+
+}
+
+std::size_t Sockets::CompressFrame(Frame& OutFrame) {
+    //Compresses a data frame in place, if the peer can decompress it and it's big enough to be worth it. Returns the
+    //number of bytes saved.
+    if (PeerCompressor == nullptr || OutFrame.Header.Type != FrameTypeData || OutFrame.Header.Compressed
+        || OutFrame.Payload.Size() < CompressionThreshold) {
+        return 0;
+
+    }
+
+    Message Compressed;
+
+    if (!CompressPayload(*PeerCompressor, OutFrame.Payload, Compressed)) {
+        return 0;
+
+    }
+
+    std::size_t Saved = OutFrame.Payload.Size() - Compressed.Size();
+
+    StatCompressedMessages++;
+    StatUncompressedBytes += OutFrame.Payload.Size();
+    StatCompressedBytes += Compressed.Size();
+
+    OutFrame.Payload = std::move(Compressed);
+    OutFrame.Header.Length = OutFrame.Payload.Size();
+    OutFrame.Header.Compressed = true;
+
+    return Saved;
+
+}
+
+void Sockets::UpdateReadsPaused() {
+    //Pauses reading once IncomingQueue reaches either high watermark, and resumes once it's back below both low ones.
+    //The gap between them stops us flapping between the two states with every message. The other channels' queues
+    //don't have watermarks, so we just stop reading while any of them is full.
+    const std::size_t Messages = IncomingQueue.Size();
+    const std::uint64_t Bytes = IncomingBytes;
+    const bool ChannelFull = ChannelIncomingFull() || HaveHeldMessage;
+
+    if (ReadsPaused) {
+        if (Messages <= IncomingWatermarks.LowMessages && Bytes <= IncomingWatermarks.LowBytes && !ChannelFull) {
+            Logger.Debug("Socket Tools: Sockets::UpdateReadsPaused(): IncomingQueue has drained. Resuming reads...");
+            ReadsPaused = false;
+
+        }
+
+    } else if (Messages >= IncomingWatermarks.HighMessages || Bytes >= IncomingWatermarks.HighBytes || ChannelFull) {
+        Logger.Debug("Socket Tools: Sockets::UpdateReadsPaused(): IncomingQueue is full. Pausing reads...");
+        ReadsPaused = true;
+        StatReadPauses++;
+
+    }
+}
+
+bool Sockets::OutgoingQueueFull() {
+    //Returns true if Write() shouldn't add to OutgoingQueue right now. Works like UpdateReadsPaused(), but for the
+    //application's side of OutgoingQueue.
+    const std::size_t Messages = OutgoingQueue.Size();
+    const std::uint64_t Bytes = OutgoingBytes;
+
+    if (OutgoingThrottled) {
+        if (Messages <= OutgoingWatermarks.LowMessages && Bytes <= OutgoingWatermarks.LowBytes) {
+            OutgoingThrottled = false;
+
+        }
+
+    } else if (Messages >= OutgoingWatermarks.HighMessages || Bytes >= OutgoingWatermarks.HighBytes) {
+        OutgoingThrottled = true;
+
+    }
+
+    return OutgoingThrottled || OutgoingQueue.Full();
+
+}
+
+void Sockets::RecordWrite(const std::size_t Frames, const std::size_t Bytes) {
+    //Updates the write statistics after a batch has been sent. Acknowledgements aren't counted as messages.
+    StatWrites++;
+    StatMessages += Frames;
+    StatBytes += Bytes;
+
+    if (Frames > StatLargestBatch) {
+        StatLargestBatch = Frames;
+
+    }
+}
+
+bool Sockets::QueueFrame(Frame& NewFrame, const std::string& Policy) {
+    //Pushes NewFrame to its channel's outgoing queue. If it's full, Policy says whether to wait for the handler to make
+    //room ("Block"), throw std::runtime_error ("Fail"), or give up ("Drop"). Returns false if we had to drop it.
+    const std::size_t Size = NewFrame.Payload.Size();
+    LogicalChannel* Target = ChannelsByID[NewFrame.Header.Channel];
+
+    while (true) {
+        if (Target != nullptr) {
+            if (Target->OutgoingQueue.Push(std::move(NewFrame))) {
+                break;
+
+            }
+
+        } else if (!OutgoingQueueFull()) {
+            //Count the bytes first, so the handler never sees OutgoingBytes go below zero.
+            OutgoingBytes += Size;
+
+            if (OutgoingQueue.Push(std::move(NewFrame))) {
+                break;
+
+            }
+
+            OutgoingBytes -= Size;
+
+        }
+
+        if (HandlerHasExited()) {
+            Logger.Error("Socket Tools: Sockets::QueueFrame(): OutgoingQueue is full and the handler has exited! Dropping message...");
+            return false;
+
+        } else if (Policy == "Fail") {
+            Logger.Debug("Socket Tools: Sockets::QueueFrame(): OutgoingQueue is full! Throwing runtime_error...");
+            throw std::runtime_error("Outgoing queue is full");
+
+        } else if (Policy == "Drop") {
+            Logger.Error("Socket Tools: Sockets::QueueFrame(): OutgoingQueue is full! Dropping message...");
+            StatDropped++;
+            return false;
+
+        }
+
+        WaitForOutgoingRoom(Target);
+
+    }
+
+    NotifyFramesQueued();
+
+    return true;
+
+}
+
+std::size_t Sockets::QueueFrames(std::vector<Frame>& Frames, const std::string& Policy) {
+    //Like QueueFrame(), but pushes as many frames as there's room for in one go, so the handler only has to be told
+    //once per batch rather than once per frame. Returns the number of frames queued.
+    std::size_t Queued = 0;
+
+    while (Queued < Frames.size()) {
+        if (!OutgoingQueueFull()) {
+            //Work out how many fit under the high watermarks. The handler only ever makes more room.
+            const std::size_t Messages = OutgoingQueue.Size();
+            const std::uint64_t CurrentBytes = OutgoingBytes;
+            std::size_t Room = (Messages < OutgoingWatermarks.HighMessages) ? OutgoingWatermarks.HighMessages - Messages : 0;
+            std::size_t Count = 0;
+            std::uint64_t Bytes = 0;
+
+            while (Count < Room && Queued + Count < Frames.size() && CurrentBytes + Bytes < OutgoingWatermarks.HighBytes) {
+                Bytes += Frames[Queued + Count].Payload.Size();
+                Count++;
+
+            }
+
+            OutgoingBytes += Bytes;
+
+            std::size_t Pushed = OutgoingQueue.PushMany(Frames.begin() + Queued, Frames.begin() + Queued + Count);
+
+            //Anything that didn't fit is still in Frames.
+            for (std::size_t i = Pushed; i < Count; i++) {
+                OutgoingBytes -= Frames[Queued + i].Payload.Size();
+
+            }
+
+            Queued += Pushed;
+
+            if (Pushed > 0) {
+                NotifyFramesQueued();
+                continue;
+
+            }
+        }
+
+        if (HandlerHasExited()) {
+            Logger.Error("Socket Tools: Sockets::QueueFrames(): OutgoingQueue is full and the handler has exited! Dropping "+std::to_string(Frames.size() - Queued)+" message(s)...");
+            break;
+
+        } else if (Policy == "Fail") {
+            Logger.Debug("Socket Tools: Sockets::QueueFrames(): OutgoingQueue is full! Throwing runtime_error...");
+            throw std::runtime_error("Outgoing queue is full");
+
+        } else if (Policy == "Drop") {
+            Logger.Error("Socket Tools: Sockets::QueueFrames(): OutgoingQueue is full! Dropping "+std::to_string(Frames.size() - Queued)+" message(s)...");
+            StatDropped += Frames.size() - Queued;
+            break;
+
+        }
+
+        WaitForOutgoingRoom(nullptr);
+
+    }
+
+    return Queued;
+
+}
+
+void Sockets::NotifyFramesQueued() {
+    //Start sending straight away, whichever handler we're using.
+    if (HandlerMode != "Async") {
+        Wake();
+
+    } else if (CanTransmit()) {
+        std::shared_ptr<Sockets> Self = KeepAlive();
+        PostToStrand([this, Self]() { StartAsyncWrite(); });
+
+    }
+}
+
+void Sockets::WaitForOutgoingRoom(LogicalChannel* Target) {
+    //Waits until Target's outgoing queue (OutgoingQueue if it's nullptr) has room, or the handler exits. The handler
+    //only signals OutgoingRoomMade after making room, and we check under the lock, so we can't miss it.
+    std::unique_lock<std::mutex> Lock(OutgoingRoomMutex);
+
+    OutgoingRoomMade.wait(Lock, [this, Target]() {
+        return HandlerHasExited() || ((Target != nullptr) ? !Target->OutgoingQueue.Full() : !OutgoingQueueFull());
+    });
+}
+
+void Sockets::NotifyOutgoingRoom() {
+    //Wakes any Write() waiting in WaitForOutgoingRoom().
+    std::lock_guard<std::mutex> Lock(OutgoingRoomMutex);
+    OutgoingRoomMade.notify_all();
+
+}
+
+void Sockets::NotifyIncomingRoom(const bool OnChannel) {
+    //Called by the application after taking messages off an incoming queue. If the handler has paused reads, and
+    //there's enough room for it to resume (IncomingQueue is down to its low watermarks, or a channel's queue is no
+    //longer full), wake it so it carries on straight away. The fence pairs with the one in PushReceivedFrames(): either
+    //we see that it has paused, or it sees the room we've made.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!ReadsPaused) {
+        return;
+
+    } else if (!OnChannel && (IncomingQueue.Size() > IncomingWatermarks.LowMessages || IncomingBytes > IncomingWatermarks.LowBytes)) {
+        return;
+
+    }
+
+    if (HandlerMode != "Async") {
+        Wake();
+
+    } else if (CanTransmit() && !RetryPosted.exchange(true)) {
+        std::shared_ptr<Sockets> Self = KeepAlive();
+
+        if (!PostToStrand([this, Self]() { RetryAsyncRead(); })) {
+            RetryPosted = false;
+
+        }
+    }
+}
+
+void Sockets::HandleControl(const Message& Msg) {
+    //Called by the handler when the peer sends a control message.
+    Logger.Debug("Socket Tools: Sockets::HandleControl(): Got a "+std::to_string(Msg.Size())+" byte control message from peer...");
+
+    if (!OnControl) {
+        Logger.Warning("Socket Tools: Sockets::HandleControl(): No control message callback. Dropping control message...");
+        return;
+
+    }
+
+    try {
+        OnControl(Msg);
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::HandleControl(): Control message callback threw an exception! Error was "+static_cast<string>(err.what())+"...");
+
+    }
+}
+
+void Sockets::HandleGoodbye(const char Reason) {
+    //Called by the handler when the peer says it's closing the connection. It'll close it straight after this, and
+    //we'll notice that as usual.
+    if (Reason == GoodbyeShuttingDown) {
+        Logger.Info("Socket Tools: Sockets::HandleGoodbye(): Peer is shutting down...");
+
+    } else {
+        Logger.Info("Socket Tools: Sockets::HandleGoodbye(): Peer is closing the connection...");
+
+    }
+
+    PeerSaidGoodbye = true;
+
+}
+
+void Sockets::SayGoodbye(const char Reason) {
+    //Tells the peer we're closing the connection on purpose. Best effort: we never wait for room to send it, and don't
+    //send it at all if we're part of the way through writing another frame.
+    bool Writing = WriteInProgress;
+
+#ifdef STROODLR_IO_URING
+    Writing = Writing || RingSendInFlight;
+
+#endif
+    if (!CanTransmit() || Socket == nullptr || !Socket->is_open() || Writing) {
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SayGoodbye(): Saying goodbye to peer...");
+
+    FrameHeader Header;
+    Header.Type = FrameTypeGoodbye;
+    Header.Length = 1;
+
+    char Goodbye[FrameHeaderSize + 1];
+    EncodeFrameHeader(Header, Goodbye);
+    Goodbye[FrameHeaderSize] = Reason;
+
+    vector<boost::asio::const_buffer> Buffers(1, boost::asio::buffer(Goodbye, sizeof(Goodbye)));
+
+    try {
+        if (SharedMemory != nullptr) {
+            SharedMemory->WriteSome(Buffers, 0);
+
+        } else {
+            SendSome(Buffers, 0);
+
+        }
+
+    } catch (std::exception& err) {
+        Logger.Debug("Socket Tools: Sockets::SayGoodbye(): Couldn't say goodbye. Error was "+static_cast<string>(err.what())+"...");
+
+    }
+}
+
+//---------- Reliable Sending Functions ----------
+void Sockets::HandleAck(const std::uint32_t Sequence) {
+    //Called by the handler when the peer acknowledges everything up to and including Sequence.
+    Logger.Debug("Socket Tools: Sockets::HandleAck(): Peer acknowledged up to "+std::to_string(Sequence)+"...");
+
+    std::lock_guard<std::mutex> Lock(SendWindowMutex);
+
+    while (!Unacknowledged.empty() && !SequenceIsAfter(Unacknowledged.front().Sequence, Sequence)) {
+        Unacknowledged.front().Acknowledged.set_value(true);
+        Unacknowledged.pop_front();
+
+    }
+
+    SendWindowChanged.notify_all();
+
+}
+
+void Sockets::FailUnacknowledged() {
+    //Called when the connection is lost. Tells everyone waiting for an acknowledgement that it won't come.
+    std::lock_guard<std::mutex> Lock(SendWindowMutex);
+
+    if (!Unacknowledged.empty()) {
+        Logger.Error("Socket Tools: Sockets::FailUnacknowledged(): "+std::to_string(Unacknowledged.size())+" message(s) weren't acknowledged!");
+
+    }
+
+    while (!Unacknowledged.empty()) {
+        Unacknowledged.front().Acknowledged.set_value(false);
+        Unacknowledged.pop_front();
+
+    }
+
+    SendWindowChanged.notify_all();
+
+}
+
+//---------- Heartbeat Functions ----------
+void Sockets::StartHeartbeat() {
+    //Called when we connect. The peer hasn't had a chance to be quiet yet, and we want an RTT sample straight away.
+    LastHeardFrom = std::chrono::steady_clock::now();
+    LastPingSent = std::chrono::steady_clock::time_point();
+
+}
+
+bool Sockets::CheckHeartbeat() {
+    //Called regularly by the handler. Pings the peer if it's time to, and returns false if the peer has been silent for too long.
+    if (HeartbeatInterval.count() == 0) {
+        return true;
+
+    }
+
+    std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+
+    //If we've stopped reading because IncomingQueue is full, the peer's frames are waiting in the socket, so don't hold
+    //that against it.
+    if (ReadsPaused) {
+        LastHeardFrom = Now;
+
+    }
+
+    if (Now - LastHeardFrom >= HeartbeatInterval * MissedHeartbeatLimit) {
+        Logger.Error("Socket Tools: Sockets::CheckHeartbeat(): Peer missed "+std::to_string(MissedHeartbeatLimit)+" heartbeat(s). Assuming the connection is dead...");
+        return false;
+
+    }
+
+    if (Now - LastPingSent >= HeartbeatInterval) {
+        ControlFrames.push_back(MakeHeartbeatFrame(FrameTypePing, MicrosecondsNow()));
+        LastPingSent = Now;
+
+    }
+
+    return true;
+
+}
+
+void Sockets::StartHeartbeatTimer() {
+    //Calls HandleHeartbeatTimer() once HeartbeatInterval has passed. Used by the async handler and sessions.
+    if (HeartbeatInterval.count() == 0) {
+        return;
+
+    }
+
+    std::shared_ptr<Sockets> Self = KeepAlive();
+
+    HeartbeatTimer->expires_from_now(HeartbeatInterval);
+    HeartbeatTimer->async_wait(Strand->wrap([this, Self](const boost::system::error_code& Error) { if (!Error) HandleHeartbeatTimer(); }));
+
+}
+
+void Sockets::HandleHeartbeatTimer() {
+    //Pings the peer, or gives up on it if it's been quiet for too long.
+    if (!Socket->is_open()) {
+        return;
+
+    }
+
+    if (!CheckHeartbeat()) {
+        HandleConnectionLost();
+        return;
+
+    }
+
+    StartAsyncWrite();
+    StartHeartbeatTimer();
+
+}
+
+void Sockets::HandlePing(const std::uint64_t Timestamp) {
+    //Send the timestamp straight back.
+    ControlFrames.push_back(MakeHeartbeatFrame(FrameTypePong, Timestamp));
+
+}
+
+void Sockets::HandlePong(const std::uint64_t Timestamp) {
+    //Updates the RTT estimates with a new sample, as in RFC 6298.
+    std::uint64_t Now = MicrosecondsNow();
+
+    if (Timestamp > Now) {
+        //Not one of ours.
+        return;
+
+    }
+
+    std::uint64_t Sample = Now - Timestamp;
+
+    if (RTTSamples == 0) {
+        SmoothedRTT = Sample;
+        RTTVariation = Sample / 2;
+
+    } else {
+        std::uint64_t Difference = (Sample > SmoothedRTT) ? Sample - SmoothedRTT : SmoothedRTT - Sample;
+
+        RTTVariation = (3 * RTTVariation + Difference) / 4;
+        SmoothedRTT = (7 * SmoothedRTT + Sample) / 8;
+
+    }
+
+    RTTSamples++;
+
+    Logger.Debug("Socket Tools: Sockets::HandlePong(): RTT was "+std::to_string(Sample)+" us. Smoothed RTT is now "+std::to_string(SmoothedRTT)+" us...");
+
+}
+
+//---------- Session Resumption Functions ----------
+void Sockets::SendHello() {
+    //Called by the connecting side once it's connected. Proposes the session we had before (if any), and tells the
+    //peer which of its reliable messages we've already received.
+    if (Type != "Plug") {
+        //The accepting side waits to hear from the client first.
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::SendHello(): Saying hello to peer...");
+    ControlFrames.push_back(MakeHelloFrame(SessionToken, LastReceivedSequence, GetCodecIDs()));
+
+}
+
+void Sockets::HandleHello(const std::uint64_t PeerToken, const std::uint32_t PeerLastReceived, const vector<char>& PeerCodecs) {
+    //Called by the handler when the peer says hello. Works out whether the session is new or resumed, then replays
+    //whatever the peer hasn't received yet.
+    ChooseCompressor(PeerCodecs);
+    if (Type == "Plug") {
+        //The server has chosen the token. If it isn't the one we had, our old session is gone (maybe the server was
+        //restarted), and the server's sequence numbers start again.
+        if (PeerToken != SessionToken) {
+            if (SessionToken != 0) {
+                Logger.Info("Socket Tools: Sockets::HandleHello(): Peer didn't resume our session. Starting a new one...");
+
+            }
+
+            SessionToken = PeerToken;
+            LastReceivedSequence = 0;
+
+        } else {
+            Logger.Info("Socket Tools: Sockets::HandleHello(): Resumed session with peer.");
+
+        }
+
+        FinishHello(PeerLastReceived);
+        return;
+
+    }
+
+    //We're the accepting side, so reply with the token to use from now on.
+    std::uint64_t Token = PeerToken;
+    std::shared_ptr<Sockets> OldSession;
+
+    if (Type == "Session") {
+        //SocketServer knows about every session, so let it find the one being resumed.
+        if (ResumeSession) {
+            OldSession = ResumeSession(KeepAlive(), Token);
+
+        } else {
+            Token = NewSessionToken();
+
+        }
+
+    } else if (Token == 0 || Token != SessionToken) {
+        //A new client. Forget what we'd received from the last one.
+        Token = NewSessionToken();
+        LastReceivedSequence = 0;
+
+    }
+
+    if (OldSession == nullptr) {
+        if (Token == SessionToken) {
+            Logger.Info("Socket Tools: Sockets::HandleHello(): Resumed session with peer.");
+
+        }
+
+        SessionToken = Token;
+        FinishHello(PeerLastReceived);
+        return;
+
+    }
+
+    //The old session might not have noticed that its connection is gone yet, so close it on its own strand first.
+    //Then take over its state on ours.
+    Logger.Info("Socket Tools: Sockets::HandleHello(): Resuming an earlier session...");
+    SessionToken = Token;
+
+    std::shared_ptr<Sockets> Self = KeepAlive();
+
+    OldSession->PostToStrand([Self, OldSession, PeerLastReceived]() {
+        OldSession->HandleConnectionLost();
+        std::shared_ptr<ResumeState> State = OldSession->DetachState();
+
+        Self->PostToStrand([Self, State, PeerLastReceived]() {
+            Self->AttachState(*State);
+            Self->FinishHello(PeerLastReceived);
+            Self->StartAsyncWrite();
+        });
+    });
+
+}
+
+void Sockets::FinishHello(const std::uint32_t PeerLastReceived) {
+    //Once we know which session this is: drop whatever the peer has received, reply if we're the accepting side, and
+    //send the rest again.
+    if (PeerLastReceived != 0) {
+        HandleAck(PeerLastReceived);
+
+    }
+
+    if (Type != "Plug") {
+        ControlFrames.push_back(MakeHelloFrame(SessionToken, LastReceivedSequence, GetCodecIDs()));
+
+    }
+
+    ReplayUnacknowledged();
+    SessionEstablished = true;
+
+}
+
+void Sockets::ReplayUnacknowledged() {
+    //Queues every reliable message that's still waiting for an acknowledgement to be sent again, oldest first. Some
+    //may also still be in OutgoingQueue, but the peer drops duplicates.
+    std::lock_guard<std::mutex> Lock(SendWindowMutex);
+
+    if (!Unacknowledged.empty()) {
+        Logger.Info("Socket Tools: Sockets::ReplayUnacknowledged(): Sending "+std::to_string(Unacknowledged.size())+" unacknowledged message(s) again...");
+
+    }
+
+    for (std::size_t i = 0; i < Unacknowledged.size(); i++) {
+        Frame Replay;
+        Replay.Header.Length = Unacknowledged[i].Payload.Size();
+        Replay.Header.Sequence = Unacknowledged[i].Sequence;
+        Replay.Payload = Unacknowledged[i].Payload;
+
+        ControlFrames.push_back(std::move(Replay));
+
+    }
+}
+
+std::shared_ptr<ResumeState> Sockets::DetachState() {
+    //Hands everything a resumed session needs over to it. Called on our strand once we're closed.
+    std::shared_ptr<ResumeState> State(new ResumeState());
+    std::lock_guard<std::mutex> Lock(SendWindowMutex);
+
+    State->NextSequence = NextSequence;
+    State->LastReceivedSequence = LastReceivedSequence;
+    State->Unacknowledged = std::move(Unacknowledged);
+    Unacknowledged.clear();
+
+    return State;
+
+}
+
+void Sockets::AttachState(ResumeState& State) {
+    //Takes over the state of the session we're resuming. Called on our strand.
+    std::lock_guard<std::mutex> Lock(SendWindowMutex);
+
+    //Anything the application sent on this connection before we knew it was a resumption has sequence numbers from
+    //the wrong session, so give up on it.
+    while (!Unacknowledged.empty()) {
+        Unacknowledged.front().Acknowledged.set_value(false);
+        Unacknowledged.pop_front();
+
+    }
+
+    NextSequence = State.NextSequence;
+    LastReceivedSequence = State.LastReceivedSequence;
+    Unacknowledged = std::move(State.Unacknowledged);
+
+    SendWindowChanged.notify_all();
+
+}
+
+//---------- Async R/W Functions ----------
+int Sockets::RunAsyncHandler() {
+    //Runs the io_service until we lose the connection or are asked to exit.
+    Logger.Debug("Socket Tools: Sockets::RunAsyncHandler(): Starting async reads and writes...");
+
+    WriteInProgress = false;
+    ConnectionLost = false;
+    Draining = false;
+    AsyncReadsPaused = false;
+    RetryPosted = false;
+    SetStrand(std::shared_ptr<boost::asio::io_service::strand>(new boost::asio::io_service::strand(*io_service)));
+    HeartbeatTimer = std::shared_ptr<boost::asio::steady_timer>(new boost::asio::steady_timer(*io_service));
+    DrainTimer = std::shared_ptr<boost::asio::steady_timer>(new boost::asio::steady_timer(*io_service));
+
+    Strand->post([this]() { StartAsyncRead(); HandleHeartbeatTimer(); StartAsyncWrite(); });
+
+    //There is always a read outstanding, so this only returns when io_service is stopped.
+    io_service->run();
+
+    if (ConnectionLost) {
+        Logger.Debug("Socket Tools: Sockets::RunAsyncHandler(): Connection lost. Returning -1...");
+        return -1;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::RunAsyncHandler(): io_service stopped. Returning 0...");
+    return 0;
+
+}
+
+void Sockets::StartSession() {
+    //Starts an accepted session running on the server's io_service. Called by SocketServer.
+    Logger.Debug("Socket Tools: Sockets::StartSession(): Starting async reads and writes...");
+
+    SetStrand(std::shared_ptr<boost::asio::io_service::strand>(new boost::asio::io_service::strand(*io_service)));
+    HeartbeatTimer = std::shared_ptr<boost::asio::steady_timer>(new boost::asio::steady_timer(*io_service));
+    DrainTimer = std::shared_ptr<boost::asio::steady_timer>(new boost::asio::steady_timer(*io_service));
+    StartHeartbeat();
+    SetState(ConnectionState::Connected);
+
+    std::shared_ptr<Sockets> Self = KeepAlive();
+
+    if (IsSharedMemoryAddress(ServerAddress)) {
+        //The client sends its shared memory first. Start the heartbeat timer anyway, so we give up on it if it doesn't.
+        AwaitingSharedMemory = true;
+        Socket->async_wait(StreamProtocol::socket::wait_read,
+                           Strand->wrap([this, Self](const boost::system::error_code& Error) { HandleSharedMemoryOffer(Error); }));
+
+        Strand->post([this, Self]() { HandleHeartbeatTimer(); });
+        return;
+
+    }
+
+    Strand->post([this, Self]() { StartAsyncRead(); HandleHeartbeatTimer(); StartAsyncWrite(); });
+
+}
+
+void Sockets::HandleSharedMemoryOffer(const boost::system::error_code& Error) {
+    //Called on the strand when a session's client has sent its shared memory, or the socket failed.
+    if (Error) {
+        if (Error != boost::asio::error::operation_aborted) {
+            Logger.Error("Socket Tools: Sockets::HandleSharedMemoryOffer(): Error waiting for shared memory: "+Error.message()+"...");
+            HandleConnectionLost();
+
+        }
+
+        return;
+
+    }
+
+    try {
+        SharedMemory = std::make_shared<SharedMemoryStream>(Socket->native_handle());
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::HandleSharedMemoryOffer(): Couldn't use the client's shared memory: "+static_cast<string>(err.what())+". Closing session...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::HandleSharedMemoryOffer(): Using shared memory. Starting async reads and writes...");
+    AwaitingSharedMemory = false;
+
+    StartAsyncRead();
+    StartAsyncWrite();
+
+}
+
+std::shared_ptr<Sockets> Sockets::KeepAlive() {
+    //Sessions are owned by SocketServer, which forgets about them once they close. Completion handlers hold on to
+    //this so the session isn't destroyed while they're still outstanding. Other types own their io_service, so don't need it.
+    if (Type == "Session") {
+        return shared_from_this();
+
+    }
+
+    return nullptr;
+
+}
+
+void Sockets::StartAsyncRead() {
+    //Reads whatever data arrives next. HandleAsyncRead() will be called when it does.
+    std::shared_ptr<Sockets> Self = KeepAlive();
+
+    if (SharedMemory != nullptr) {
+        SharedMemory->AsyncWaitReadable(*Strand, [this, Self](const boost::system::error_code& Error) { HandleSharedMemoryReadable(Error); });
+        return;
+
+    }
+
+    //Read straight into the decoder's ring. Nothing else touches it until the read has finished.
+    std::size_t Space;
+    char* Destination;
+
+    try {
+        Destination = Decoder.PrepareRead(Space);
+
+    } catch (boost::system::system_error& err) {
+        Logger.Error("Socket Tools: Sockets::StartAsyncRead(): Couldn't make room to read into! Error was "+static_cast<string>(err.what())+"...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    Socket->async_read_some(boost::asio::buffer(Destination, Space),
+                            Strand->wrap([this, Self](const boost::system::error_code& Error, std::size_t BytesRead) { HandleAsyncRead(Error, BytesRead); }));
+
+}
+
+void Sockets::StartAsyncWrite() {
+    //Starts sending the message at the front of OutgoingQueue (and any acknowledgement that's due), unless we're already sending.
+    if (WriteInProgress || AwaitingSharedMemory || !Socket->is_open()) {
+        return;
+
+    }
+
+    std::shared_ptr<std::vector<boost::asio::const_buffer> > Buffers(new std::vector<boost::asio::const_buffer>());
+    FramesBeingWritten = PrepareWrite(*Buffers, ControlFramesBeingWritten);
+
+    if (Buffers->empty()) {
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::StartAsyncWrite(): Sending "+std::to_string(FramesBeingWritten)+" message(s)...");
+    WriteInProgress = true;
+
+    std::shared_ptr<Sockets> Self = KeepAlive();
+
+    if (SharedMemory != nullptr) {
+        SharedMemory->AsyncWrite(*Strand, Buffers, [this, Self](const boost::system::error_code& Error, std::size_t BytesWritten) {
+            HandleAsyncWrite(Error, BytesWritten);
+        });
+
+        return;
+
+    }
+
+    boost::asio::async_write(*Socket, *Buffers,
+                             Strand->wrap([this, Self, Buffers](const boost::system::error_code& Error, std::size_t BytesWritten) {
+                                 HandleAsyncWrite(Error, BytesWritten);
+                             }));
+
+}
+
+void Sockets::HandleAsyncRead(const boost::system::error_code& Error, const std::size_t BytesRead) {
+    //Called by io_service when some data has been read, or the read failed.
+    bool HaveRoom;
+
+    if (Error) {
+        Logger.Error("Socket Tools: Sockets::HandleAsyncRead(): Error reading from socket: "+Error.message()+"...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    try {
+        //Push every complete frame to the message queue.
+        LastHeardFrom = std::chrono::steady_clock::now();
+        Decoder.Commit(BytesRead);
+        RearmQuickAck();
+        HaveRoom = PushReceivedFrames();
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::HandleAsyncRead(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    //Send any acknowledgements that are now due.
+    StartAsyncWrite();
+
+    if (!HaveRoom) {
+        //The application hasn't kept up. Stop reading until there's room, so the data waits in the socket instead.
+        Logger.Debug("Socket Tools: Sockets::HandleAsyncRead(): IncomingQueue is full. Pausing reads...");
+        AsyncReadsPaused = true;
+        return;
+
+    }
+
+    StartAsyncRead();
+
+}
+
+void Sockets::HandleSharedMemoryReadable(const boost::system::error_code& Error) {
+    //Called on the strand when the peer might have written to shared memory, or closed the connection.
+    bool HaveRoom;
+
+    if (Error) {
+        Logger.Error("Socket Tools: Sockets::HandleSharedMemoryReadable(): Error waiting for data: "+Error.message()+"...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    try {
+        if (ReadFromSharedMemory() == -1) {
+            HandleConnectionLost();
+            return;
+
+        }
+
+        HaveRoom = PushReceivedFrames();
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::HandleSharedMemoryReadable(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    //Send any acknowledgements that are now due.
+    StartAsyncWrite();
+
+    if (!HaveRoom) {
+        Logger.Debug("Socket Tools: Sockets::HandleSharedMemoryReadable(): IncomingQueue is full. Pausing reads...");
+        AsyncReadsPaused = true;
+        return;
+
+    }
+
+    StartAsyncRead();
+
+}
+
+void Sockets::HandleAsyncWrite(const boost::system::error_code& Error, const std::size_t BytesWritten) {
+    //Called by io_service when a batch has been sent, or sending failed.
+    WriteInProgress = false;
+
+    if (Error) {
+        Logger.Error("Socket Tools: Sockets::HandleAsyncWrite(): Error writing to socket: "+Error.message()+"...");
+        HandleConnectionLost();
+        return;
+
+    }
+
+    RecordWrite(FramesBeingWritten, BytesWritten);
+
+    //Remove the messages we just sent, and start on the next batch.
+    Logger.Debug("Socket Tools: Sockets::HandleAsyncWrite(): Clearing sent items from OutgoingQueue...");
+    FinishWrite(ControlFramesBeingWritten, FramesBeingWritten);
+
+    FramesBeingWritten = 0;
+    ControlFramesBeingWritten = 0;
+
+    StartAsyncWrite();
+    CheckDrained();
+
+}
+
+void Sockets::RetryAsyncRead() {
+    //Posted to the strand by NotifyIncomingRoom(). Resumes reading if we'd paused, and the application has made room.
+    RetryPosted = false;
+
+    if (!AsyncReadsPaused || !CanTransmit()) {
+        return;
+
+    }
+
+    try {
+        bool HaveRoom = PushReceivedFrames();
+        StartAsyncWrite();
+
+        if (HaveRoom) {
+            Logger.Debug("Socket Tools: Sockets::RetryAsyncRead(): There's room in IncomingQueue again. Resuming reads...");
+            AsyncReadsPaused = false;
+            StartAsyncRead();
+
+        }
+
+    } catch (std::exception& err) {
+        Logger.Error("Socket Tools: Sockets::RetryAsyncRead(): Caught unhandled exception! Error was "+static_cast<string>(err.what())+"...");
+        HandleConnectionLost();
+
+    }
+}
+
+void Sockets::HandleConnectionLost() {
+    //Called on the strand when a read or write fails, or we're asked to close.
+    if (Type == "Session") {
+        //Sessions don't reconnect - the client will start a new connection, and maybe resume this session on it. Close
+        //the socket so anything outstanding finishes, and flag that we're done so SocketServer can forget about us.
+        Logger.Debug("Socket Tools: Sockets::HandleConnectionLost(): Closing session...");
+
+        if (HandlerShouldExit) {
+            SayGoodbye(GoodbyeShuttingDown);
+
+        }
+
+        boost::system::error_code Ignored;
+        HeartbeatTimer->cancel(Ignored);
+        DrainTimer->cancel(Ignored);
+        Draining = false;
+        Socket->close(Ignored);
+
+        if (SharedMemory != nullptr) {
+            SharedMemory->Close();
+
+        }
+
+        ClosedAt = std::chrono::steady_clock::now();
+        SetState(ConnectionState::Closed);
+
+        //Without a token, or if the client said goodbye, this session won't be resumed. Otherwise, SocketServer gives up
+        //on it after a while.
+        if (SessionToken == 0 || PeerSaidGoodbye) {
+            FailUnacknowledged();
+
+        }
+
+        NotifyDataArrived();
+
+        return;
+
+    }
+
+    //The handler thread will reconnect once io_service->run() returns.
+    Logger.Debug("Socket Tools: Sockets::HandleConnectionLost(): Stopping io_service...");
+    ConnectionLost = true;
+    io_service->stop();
+
+}
+
+void Sockets::BeginAsyncDrain() {
+    //Called on the strand when we're asked to exit. Keeps the connection open until everything queued has been sent,
+    //or DrainTimeout runs out.
+    if (Draining) {
+        return;
+
+    }
+
+    if (!CanTransmit()) {
+        FinishAsyncDrain();
+        return;
+
+    }
+
+    if (Type == "Session") {
+        SetState(ConnectionState::Closing);
+
+    }
+
+    StartAsyncWrite();
+
+    if (DrainTimeout.count() == 0 || (!WriteInProgress && !HaveUnsentFrames())) {
+        FinishAsyncDrain();
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::BeginAsyncDrain(): Sending what's left in the queues...");
+    Draining = true;
+
+    std::shared_ptr<Sockets> Self = KeepAlive();
+
+    DrainTimer->expires_from_now(DrainTimeout);
+    DrainTimer->async_wait(Strand->wrap([this, Self](const boost::system::error_code& Error) {
+        if (!Error && Draining) {
+            Logger.Warning("Socket Tools: Sockets::BeginAsyncDrain(): Gave up with messages still waiting to be sent...");
+            FinishAsyncDrain();
+
+        }
+    }));
+}
+
+void Sockets::CheckDrained() {
+    //Finishes closing once we've sent everything, if we're exiting.
+    if (Draining && !WriteInProgress && !HaveUnsentFrames()) {
+        Logger.Debug("Socket Tools: Sockets::CheckDrained(): Sent everything...");
+        FinishAsyncDrain();
+
+    }
+}
+
+void Sockets::FinishAsyncDrain() {
+    //Called on the strand when draining is over. Sessions close the connection (saying goodbye), otherwise we stop
+    //io_service so the handler thread can do that.
+    Draining = false;
+
+    boost::system::error_code Ignored;
+    DrainTimer->cancel(Ignored);
+
+    if (Type == "Session") {
+        HandleConnectionLost();
+        return;
+
+    }
+
+    Logger.Debug("Socket Tools: Sockets::FinishAsyncDrain(): Stopping io_service...");
+    io_service->stop();
+
+}
+
+//---------- Operators ----------
+std::shared_ptr<StreamProtocol::socket> Sockets::operator * () {
+    //Return the socket.
+    Logger.Info("Socket Tools: Sockets::AttemptToReadFromSocket(): Returning a std::shared_ptr to the socket as requested...");
+    return Socket;
+
+}
+
+//Define SocketServer's functions.
+//---------- Setup Functions ----------
+void SocketServer::SetPortNumber(const int& PortNo) {
+    Logger.Debug("Socket Tools: SocketServer::SetPortNumber(): Setting PortNumber to "+std::to_string(PortNo)+"...");
+    PortNumber = PortNo;
+
+}
+
+void SocketServer::SetAddress(const string& Add) {
+    //An IP address to listen on (instead of all of them), or a "unix:" path to listen on a Unix domain socket.
+    Logger.Debug("Socket Tools: SocketServer::SetAddress(): Setting Address to "+Add+"...");
+    Address = Add;
+
+}
+
+void SocketServer::SetThreadCount(const int& Count) {
+    //The number of threads that run io_service and so serve the sessions.
+    if (Count < 1) {
+        Logger.Debug("Socket Tools: SocketServer::SetThreadCount(): Invalid thread count! Throwing runtime_error...");
+        throw std::runtime_error("Thread count must be at least 1");
+
+    }
+
+    Logger.Debug("Socket Tools: SocketServer::SetThreadCount(): Setting ThreadCount to "+std::to_string(Count)+"...");
+    ThreadCount = Count;
+
+}
+
+void SocketServer::SetResumeTimeout(const int& Seconds) {
+    //Sets how long we keep a closed session, in case its client reconnects and resumes it.
+    if (Seconds < 0) {
+        Logger.Debug("Socket Tools: SocketServer::SetResumeTimeout(): Invalid timeout! Throwing runtime_error...");
+        throw std::runtime_error("Resume timeout can't be negative");
+
+    }
+
+    Logger.Debug("Socket Tools: SocketServer::SetResumeTimeout(): Setting ResumeTimeout to "+std::to_string(Seconds)+" seconds...");
+    ResumeTimeout = std::chrono::seconds(Seconds);
+
+}
+
+void SocketServer::SetTuning(const SocketTuning& NewTuning) {
+    //Sets the socket options every session uses.
+    try {
+        CheckTuning(NewTuning);
+
+    } catch (std::runtime_error const& e) {
+        Logger.Debug("Socket Tools: SocketServer::SetTuning(): Invalid socket tuning! Throwing runtime_error...");
+        throw;
+
+    }
+
+    Logger.Debug("Socket Tools: SocketServer::SetTuning(): Setting socket options...");
+    Tuning = NewTuning;
+
+}
+
+void SocketServer::AddChannel(const std::uint8_t ID, const int& Weight) {
+    //Every session gets this logical channel, as if it had called Sockets::AddChannel() itself.
+    if (Weight < 1) {
+        Logger.Debug("Socket Tools: SocketServer::AddChannel(): Invalid weight! Throwing runtime_error...");
+        throw std::runtime_error("Channel weight must be at least 1");
+
+    }
+
+    for (std::size_t i = 0; i < Channels.size(); i++) {
+        if (Channels[i].first == ID) {
+            Logger.Debug("Socket Tools: SocketServer::AddChannel(): Channel "+std::to_string(ID)+" already exists! Throwing runtime_error...");
+            throw std::runtime_error("Channel already exists");
+
+        }
+    }
+
+    Logger.Debug("Socket Tools: SocketServer::AddChannel(): Adding channel "+std::to_string(ID)+" with weight "+std::to_string(Weight)+"...");
+    Channels.push_back(std::make_pair(ID, Weight));
+
+}
+
+void SocketServer::SetOnMessage(const std::function<void(std::shared_ptr<Sockets>, const Message&)>& Callback) {
+    //Every session hands its messages to Callback as soon as they arrive, on whichever pool thread read them.
+    Logger.Debug("Socket Tools: SocketServer::SetOnMessage(): Setting message callback...");
+    OnMessage = Callback;
+
+}
+
+void SocketServer::SetOnControl(const std::function<void(std::shared_ptr<Sockets>, const Message&)>& Callback) {
+    //Every session hands its control messages to Callback, on whichever pool thread read them.
+    Logger.Debug("Socket Tools: SocketServer::SetOnControl(): Setting control message callback...");
+    OnControl = Callback;
+
+}
+
+//---------- Controller Functions ----------
+void SocketServer::Start() {
+    //Opens the acceptor and starts the thread pool, then returns. Throws boost::system::system_error if we can't listen.
+    if (IsLocalAddress(Address)) {
+        Logger.Info("Socket Tools: SocketServer::Start(): Listening on "+Address+" with "+std::to_string(ThreadCount)+" threads...");
+
+    } else {
+        Logger.Info("Socket Tools: SocketServer::Start(): Listening on port "+std::to_string(PortNumber)+" with "+std::to_string(ThreadCount)+" threads...");
+
+    }
+
+    io_service = std::shared_ptr<boost::asio::io_service>(new boost::asio::io_service());
+    Work = std::shared_ptr<boost::asio::io_service::work>(new boost::asio::io_service::work(*io_service));
+
+    //The acceptor lives as long as the server does, so clients can connect at any time.
+    acceptor = std::shared_ptr<StreamAcceptor>(new StreamAcceptor(*io_service));
+    OpenAcceptor(*acceptor, Address, PortNumber, Tuning);
+
+    StartAccept();
+
+    ReapTimer = std::shared_ptr<boost::asio::steady_timer>(new boost::asio::steady_timer(*io_service));
+    StartReapTimer();
+
+    for (int i = 0; i < ThreadCount; i++) {
+        Threads.push_back(std::thread([this]() { io_service->run(); }));
+
+    }
+
+    Logger.Info("Socket Tools: SocketServer::Start(): Done!");
+
+}
+
+void SocketServer::Stop() {
+    //Closes every session, stops the thread pool, and waits for it to exit.
+    if (io_service == nullptr) {
+        return;
+
+    }
+
+    Logger.Info("Socket Tools: SocketServer::Stop(): Stopping server...");
+
+    boost::system::error_code Ignored;
+    acceptor->close(Ignored);
+    RemoveSocketFile(Address);
+    ReapTimer->cancel(Ignored);
+
+    SessionsMutex.lock();
+    vector<std::shared_ptr<Sockets> > Closing = Sessions;
+    SessionsMutex.unlock();
+
+    for (std::size_t i = 0; i < Closing.size(); i++) {
+        Closing[i]->RequestHandlerExit();
+
+    }
+
+    //Let the sessions finish closing: each one sends what it has queued, says goodbye, and closes its socket. They
+    //drain in parallel, so give them all until the slowest one's DrainTimeout (and a little) runs out.
+    std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    bool AllClosed = true;
+
+    for (std::size_t i = 0; i < Closing.size(); i++) {
+        Deadline = std::max(Deadline, std::chrono::steady_clock::now() + Closing[i]->DrainTimeout + std::chrono::seconds(1));
+
+    }
+
+    for (std::size_t i = 0; i < Closing.size(); i++) {
+        std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+        std::chrono::milliseconds TimeLeft = std::chrono::duration_cast<std::chrono::milliseconds>(Deadline > Now ? Deadline - Now : std::chrono::steady_clock::duration::zero());
+
+        if (!Closing[i]->WaitForState(ConnectionState::Closed, TimeLeft)) {
+            AllClosed = false;
+
+        }
+    }
+
+    //With nothing left to do, run() returns by itself. Only stop it if a session wouldn't close.
+    Work = nullptr;
+
+    if (!AllClosed) {
+        Logger.Warning("Socket Tools: SocketServer::Stop(): Some sessions didn't close in time. Stopping io_service...");
+        io_service->stop();
+
+    }
+
+    for (std::size_t i = 0; i < Threads.size(); i++) {
+        Threads[i].join();
+
+    }
+
+    Threads.clear();
+
+    //Nobody can resume a session now.
+    for (std::map<std::uint64_t, std::shared_ptr<Sockets> >::iterator It = SessionsByToken.begin(); It != SessionsByToken.end(); It++) {
+        It->second->FailUnacknowledged();
+
+    }
+
+    SessionsByToken.clear();
+    Sessions.clear();
+    NextSocket = nullptr;
+    ReapTimer = nullptr;
+    acceptor = nullptr;
+    io_service = nullptr;
+
+    Logger.Info("Socket Tools: SocketServer::Stop(): Done!");
+
+}
+
+//---------- Info getter functions ----------
+vector<std::shared_ptr<Sockets> > SocketServer::GetSessions() {
+    //Returns all of the open sessions. Forgets about any that have closed and been read since the last call.
+    vector<std::shared_ptr<Sockets> > Open;
+
+    SessionsMutex.lock();
+    ReapSessions();
+    Open = Sessions;
+    SessionsMutex.unlock();
+
+    return Open;
+
+}
+
+//---------- Private Functions ----------
+void SocketServer::StartAccept() {
+    //Waits for the next client. HandleAccept() will be called when one connects.
+    NextSocket = std::shared_ptr<StreamProtocol::socket>(new StreamProtocol::socket(*io_service));
+    acceptor->async_accept(*NextSocket, [this](const boost::system::error_code& Error) { HandleAccept(Error); });
+
+}
+
+void SocketServer::HandleAccept(const boost::system::error_code& Error) {
+    //Called by io_service when a client has connected, or accepting failed.
+    if (Error == boost::asio::error::operation_aborted) {
+        //We're stopping.
+        return;
+
+    } else if (Error) {
+        Logger.Error("Socket Tools: SocketServer::HandleAccept(): Error accepting connection: "+Error.message()+". Continuing...");
+        StartAccept();
+        return;
+
+    }
+
+    boost::system::error_code EndpointError;
+    Logger.Info("Socket Tools: SocketServer::HandleAccept(): New session from "+DescribeEndpoint(NextSocket->remote_endpoint(EndpointError))+"...");
+
+    std::shared_ptr<Sockets> Session(new Sockets(io_service, NextSocket));
+    Session->ServerAddress = Address;
+    Session->Tuning = Tuning;
+    Session->ApplyTuning();
+
+    for (std::size_t i = 0; i < Channels.size(); i++) {
+        Session->AddChannel(Channels[i].first, Channels[i].second);
+
+    }
+
+    if (OnMessage) {
+        //Don't let the session keep itself alive through its own callback.
+        std::weak_ptr<Sockets> WeakSession = Session;
+        std::function<void(std::shared_ptr<Sockets>, const Message&)> Callback = OnMessage;
+
+        Session->SetOnMessage([WeakSession, Callback](const Message& Msg) { Callback(WeakSession.lock(), Msg); });
+
+    }
+
+    if (OnControl) {
+        std::weak_ptr<Sockets> WeakSession = Session;
+        std::function<void(std::shared_ptr<Sockets>, const Message&)> Callback = OnControl;
+
+        Session->SetOnControl([WeakSession, Callback](const Message& Msg) { Callback(WeakSession.lock(), Msg); });
+
+    }
+
+    Session->ResumeSession = [this](std::shared_ptr<Sockets> NewSession, std::uint64_t& Token) { return ResumeSession(NewSession, Token); };
+
+    SessionsMutex.lock();
+
+    //Forget about any sessions that have closed, so they don't build up if nobody calls GetSessions().
+    ReapSessions();
+
+    Sessions.push_back(Session);
+    SessionsMutex.unlock();
+
+    Session->StartSession();
+
+    StartAccept();
+
+}
+
+std::shared_ptr<Sockets> SocketServer::ResumeSession(std::shared_ptr<Sockets> Session, std::uint64_t& Token) {
+    //Called on the pool when a session's client says hello. Returns the closed session the client wants to resume, if
+    //we still have it, and sets Token to the token the session should use from now on.
+    std::shared_ptr<Sockets> OldSession;
+    std::lock_guard<std::mutex> Lock(SessionsMutex);
+    std::map<std::uint64_t, std::shared_ptr<Sockets> >::iterator It = SessionsByToken.find(Token);
+
+    if (Token != 0 && It != SessionsByToken.end() && It->second != Session) {
+        OldSession = It->second;
+
+    } else {
+        if (Token != 0) {
+            Logger.Info("Socket Tools: SocketServer::ResumeSession(): Client asked to resume a session we don't have. Starting a new one...");
+
+        }
+
+        do {
+            Token = NewSessionToken();
+
+        } while (SessionsByToken.count(Token) != 0);
+
+    }
+
+    SessionsByToken[Token] = Session;
+
+    return OldSession;
+
+}
+
+void SocketServer::StartReapTimer() {
+    //Calls ReapSessions() every second, so closed sessions are given up on even if no more clients connect.
+    ReapTimer->expires_from_now(std::chrono::seconds(1));
+    ReapTimer->async_wait([this](const boost::system::error_code& Error) {
+        if (Error) {
+            return;
+
+        }
+
+        SessionsMutex.lock();
+        ReapSessions();
+        SessionsMutex.unlock();
+
+        StartReapTimer();
+    });
+
+}
+
+void SocketServer::ReapSessions() {
+    //Forgets about sessions that have closed and been read, and gives up on resuming any that closed more than
+    //ResumeTimeout ago. Call with SessionsMutex locked.
+    std::chrono::steady_clock::time_point Now = std::chrono::steady_clock::now();
+    std::map<std::uint64_t, std::shared_ptr<Sockets> >::iterator It = SessionsByToken.begin();
+
+    while (It != SessionsByToken.end()) {
+        if (It->second->HandlerHasExited() && It->second->PeerSaidGoodbye) {
+            //It isn't coming back.
+            Logger.Info("Socket Tools: SocketServer::ReapSessions(): A client said goodbye. Forgetting its session...");
+            SessionsByToken.erase(It++);
+
+        } else if (It->second->HandlerHasExited() && Now - It->second->ClosedAt >= ResumeTimeout) {
+            Logger.Info("Socket Tools: SocketServer::ReapSessions(): A client didn't come back in time. Giving up on its session...");
+            It->second->FailUnacknowledged();
+            SessionsByToken.erase(It++);
+
+        } else {
+            It++;
+
+        }
+    }
+
+    for (int i = Sessions.size() - 1; i >= 0; i--) {
+        if (Sessions[i]->HandlerHasExited() && !Sessions[i]->HasPendingData()) {
+            Logger.Info("Socket Tools: SocketServer::ReapSessions(): A client has disconnected. Forgetting about its session...");
+            Sessions.erase(Sessions.begin() + i);
+
+        }
+    }
 }
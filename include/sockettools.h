@@ -20,41 +20,410 @@ along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
 
 //Includes.
 #include <string>
-#include <queue>
 #include <vector>
 #include <boost/asio.hpp>
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <sys/uio.h>
+
+#include "frametools.h"
+#include "messagetools.h"
+#include "compressiontools.h"
+#include "reactortools.h"
+#include "shmtools.h"
+
+#ifdef STROODLR_IO_URING
+#include "uringtools.h"
+#endif
+#include "queuetools.h"
+#include "pooltools.h"
+
+//Sessions are cheap, because the server may have thousands of them.
+const std::size_t SessionQueueCapacity = 64;
+
+//Control messages the application can have waiting to be sent at once. They're meant to be small and rare.
+const std::size_t ControlQueueCapacity = 64;
+
+//The size of each buffer io_uring receives into. Received data is copied from them into the decoder's ring.
+const std::size_t UringBufferSize = 4096;
+
+//Each time the write scheduler visits a logical channel, the channel can send this many bytes (times its weight).
+const std::int64_t ChannelQuantum = 16 * 1024;
+
+//Sockets can use TCP or Unix domain sockets, chosen by address. An address starting with this is the path of a Unix
+//domain socket (eg "unix:/run/stroodlr.sock"), and the port number is ignored.
+const std::string UnixAddressPrefix = "unix:";
+
+//Likewise, but messages go through shared memory, and the Unix domain socket is only used to set it up and to notice
+//when the peer has gone (eg "shm:/run/stroodlr-shm.sock").
+const std::string SharedMemoryAddressPrefix = "shm:";
+
+//Either kind of socket.
+typedef boost::asio::generic::stream_protocol StreamProtocol;
+typedef boost::asio::basic_socket_acceptor<StreamProtocol> StreamAcceptor;
+
+//The state of a connection. Plugs and Sockets start Disconnected, go to Connecting when the handler starts, and then
+//between Connected and Reconnecting until they're asked to exit. While Closing, the handler is sending what's left and
+//saying goodbye. Nothing follows Closed, which means the handler has exited (or, for a session, the connection has closed).
+enum class ConnectionState {
+    Disconnected,
+    Connecting,
+    Connected,
+    Reconnecting,
+    Closing,
+    Closed
+};
+
+//Structs.
+//How well the handler is coalescing writes. Each write sends one batch of messages with a single gather write.
+struct WriteStatistics {
+    std::uint64_t Writes = 0;
+    std::uint64_t Messages = 0;
+    std::uint64_t Bytes = 0;
+    std::uint64_t LargestBatch = 0;
+    std::uint64_t CompressedMessages = 0;
+    std::uint64_t UncompressedBytes = 0; //Size of the compressed messages before compression.
+    std::uint64_t CompressedBytes = 0;   //And after.
+};
+
+//Limits for one of the message queues. A queue counts as full once it reaches either high watermark, and stays that way
+//until it has drained to both low watermarks.
+struct QueueWatermarks {
+    std::size_t HighMessages;
+    std::size_t LowMessages;
+    std::size_t HighBytes;
+    std::size_t LowBytes;
+};
+
+//Socket options applied to each connection, on both the connecting and accepting sides. Sizes are in bytes and times
+//in seconds (microseconds for BusyPoll). 0 leaves the system default alone. Only the buffer sizes apply to Unix domain
+//sockets.
+struct SocketTuning {
+    bool NoDelay = true;          //TCP_NODELAY: send small messages straight away instead of waiting to combine them.
+    int SendBufferSize = 0;       //SO_SNDBUF.
+    int ReceiveBufferSize = 0;    //SO_RCVBUF.
+    bool QuickAck = false;        //TCP_QUICKACK: acknowledge straight away instead of waiting for a reply to carry it.
+    int BusyPoll = 0;             //SO_BUSY_POLL. Values above net.core.busy_read need CAP_NET_ADMIN.
+    int KeepAliveIdle = 0;        //TCP keepalive. 0 turns it off.
+    int KeepAliveInterval = 0;
+    int KeepAliveCount = 0;
+};
+
+//How full the message queues are.
+struct QueueStatistics {
+    std::uint64_t IncomingMessages = 0;
+    std::uint64_t IncomingBytes = 0;
+    std::uint64_t OutgoingMessages = 0;
+    std::uint64_t OutgoingBytes = 0;
+    std::uint64_t DroppedMessages = 0; //Messages Write() dropped because OutgoingQueue was full, or that were still unsent when we lost the connection.
+    std::uint64_t ReadPauses = 0;      //Times the handler stopped reading because IncomingQueue was full.
+};
+
+//Round trip times measured with heartbeats. Times are in microseconds.
+struct RoundTripStatistics {
+    std::uint64_t Samples = 0;     //Pongs received.
+    std::uint64_t SmoothedRTT = 0; //0 until there's a sample.
+    std::uint64_t Jitter = 0;      //Smoothed mean deviation of the RTT.
+    std::uint64_t AckTimeout = 0;  //How long SendToPeer() waits for an acknowledgement.
+};
+
+//A reliable message that has been sent, but not acknowledged yet. Payload is kept so it can be sent again if we reconnect.
+struct PendingAck {
+    std::uint32_t Sequence;
+    Message Payload;
+    std::promise<bool> Acknowledged;
+};
+
+//What a resumed session takes over from the connection it replaces.
+struct ResumeState {
+    std::uint32_t NextSequence = 0;
+    std::uint32_t LastReceivedSequence = 0;
+    std::deque<PendingAck> Unacknowledged;
+};
+
+//One of the extra logical channels carried by a connection, each with its own queues, so a backlog on one doesn't hold
+//up the others. Channel 0 is Sockets' own IncomingQueue and OutgoingQueue.
+struct LogicalChannel {
+    LogicalChannel(const std::uint8_t ChannelID, const std::size_t Capacity) : ID(ChannelID), IncomingQueue(Capacity), OutgoingQueue(Capacity) {}
+
+    std::uint8_t ID;
+    SPSCQueue<Message> IncomingQueue;
+    SPSCQueue<Frame> OutgoingQueue;
+
+    //A message that arrived while IncomingQueue was full. It's pushed as soon as there's room, and the handler keeps
+    //reading frames behind it in the meantime. Only touched by the handler thread.
+    Message Held;
+    bool HaveHeld = false;
+};
+
+//Function declarations.
+//The socket tuning command line options both programs take: --nodelay on|off, --sndbuf BYTES, --rcvbuf BYTES,
+//--quickack on|off, --busypoll MICROSECONDS and --keepalive IDLE[,INTERVAL,COUNT].
+bool IsTuningOption(const std::string& Option);
+void ParseTuningOption(const std::string& Option, const std::string& Value, SocketTuning& Tuning); //Throws std::runtime_error if Value is invalid.
+std::string ConnectionStateName(const ConnectionState State); //eg "Connected".
 
 //Class definitions.
-class Sockets {
+class Sockets : public std::enable_shared_from_this<Sockets> {
 private:
+    //SocketServer creates sessions.
+    friend class SocketServer;
+
     //Core variables and socket pointer.
     int PortNumber;
     std::string ServerAddress;
-    std::shared_ptr<boost::asio::ip::tcp::socket> Socket;
+    std::shared_ptr<StreamProtocol::socket> Socket;
     std::thread HandlerThread;
     std::string Type;
+    std::string HandlerMode = "Polling";
 
-    //Variables for tracking status of the handler, and the socket.
+    //Variables for tracking status of the handler, and the socket. State is only changed with SetState(), which wakes
+    //anyone in WaitForState() and calls each of StateCallbacks (on the thread that changed it). Being atomic makes
+    //these safe to read from any thread, but it doesn't protect anything the handler replaces when it reconnects: the
+    //socket and timers are the handler thread's alone, and io_service and Strand are guarded by ServiceMutex.
     bool Verbose = true;
-    bool ReadyForTransmission = false;
-    bool Reconnected = false;
-    bool HandlerShouldExit = false;
-    bool HandlerExited = false;
+    std::atomic<ConnectionState> State{ConnectionState::Disconnected};
+    std::atomic<bool> Reconnected{false};
+    std::atomic<bool> HandlerShouldExit{false};
 
-    //Message queues.
-    std::queue<std::vector<char> > IncomingQueue;
-    std::queue<std::vector<char> > OutgoingQueue;
+    //Set when we gave up part of the way through a frame, so nothing else can be sent on this connection. The handler
+    //still owns it until it moves State to Closed.
+    std::atomic<bool> ConnectionUnusable{false};
+    std::mutex StateMutex;
+    std::condition_variable StateChanged;
+    std::vector<std::function<void(const ConnectionState, const ConnectionState)> > StateCallbacks;
 
-    //Boost core variables.
+    //Wakes the polling handler whenever there's something new to send, or it's asked to exit, so it never sleeps
+    //through either. WakePending is set while a wake-up is on its way, so a burst of writes only needs one.
+    int WakeDescriptor = -1;
+    std::atomic<bool> WakePending{false};
+
+    //Once asked to exit, the handler keeps sending whatever is queued for up to DrainTimeout. DrainDeadline is when
+    //it gives up, or time_point::max() if it isn't draining. Only touched by the handler thread.
+    std::chrono::milliseconds DrainTimeout{1000};
+    std::chrono::steady_clock::time_point DrainDeadline = std::chrono::steady_clock::time_point::max();
+
+    //Variables for the async handler. Only touched from the io_service's thread.
+    bool WriteInProgress = false;
+    std::size_t FramesBeingWritten = 0;
+    std::size_t ControlFramesBeingWritten = 0;
+    bool ConnectionLost = false;
+    std::shared_ptr<boost::asio::io_service::strand> Strand; //Completion handlers all run through here, so they never overlap.
+    std::shared_ptr<boost::asio::steady_timer> HeartbeatTimer;
+    std::shared_ptr<boost::asio::steady_timer> DrainTimer;
+    bool Draining = false;
+
+    //Set while we've stopped reading because an incoming queue is full. The application posts RetryAsyncRead() once
+    //it has made room, at most once until it runs (RetryPosted).
+    bool AsyncReadsPaused = false;
+    std::atomic<bool> RetryPosted{false};
+
+    //Message queues. Each has one producer and one consumer: the application thread writes to OutgoingQueue and reads from
+    //IncomingQueue, and the handler thread does the opposite.
+    SPSCQueue<Message> IncomingQueue;
+    SPSCQueue<Frame> OutgoingQueue;
+
+    //Queue limits. The handler stops reading from the socket while IncomingQueue is full, so TCP flow control makes the
+    //peer wait too. When OutgoingQueue is full, Write() does what WritePolicy says: "Block", "Fail" or "Drop".
+    QueueWatermarks IncomingWatermarks = {1024, 512, 8 * 1024 * 1024, 4 * 1024 * 1024};
+    QueueWatermarks OutgoingWatermarks = {1024, 512, 8 * 1024 * 1024, 4 * 1024 * 1024};
+    std::string WritePolicy = "Block";
+    std::atomic<bool> ReadsPaused{false}; //Only changed by the handler thread. The application checks it after taking messages.
+
+    //A message that arrived while IncomingQueue was above its high watermark, like LogicalChannel::Held.
+    Message HeldMessage;
+    bool HaveHeldMessage = false;
+    bool OutgoingThrottled = false;  //Only touched by the application thread.
+
+    //Bytes in each queue. Added by the producer before pushing, and taken off by the consumer after popping.
+    std::atomic<std::uint64_t> IncomingBytes{0};
+    std::atomic<std::uint64_t> OutgoingBytes{0};
+    std::atomic<std::uint64_t> StatDropped{0};
+    std::atomic<std::uint64_t> StatReadPauses{0};
+
+    //Blocking reads. The handler signals DataArrived whenever it pushes to IncomingQueue, or exits.
+    std::mutex DataMutex;
+    std::condition_variable DataArrived;
+
+    //Write()s waiting for room in an outgoing queue (with the "Block" policy). The handler signals OutgoingRoomMade
+    //whenever it has made room, or exits.
+    std::mutex OutgoingRoomMutex;
+    std::condition_variable OutgoingRoomMade;
+
+    //If set, messages are handed to this (on the handler thread) as they arrive, instead of going to IncomingQueue.
+    std::function<void(const Message&)> OnMessage;
+
+    //The control lane. The application's control messages wait here (the application thread is the producer, and the
+    //handler the consumer), and the handler always sends them before any channel's messages. The peer's go to OnControl.
+    SPSCQueue<Frame> ControlQueue{ControlQueueCapacity};
+    std::function<void(const Message&)> OnControl;
+
+    //Reliable sending. Reliable messages carry a sequence number, and up to SendWindow of them can be waiting for an
+    //acknowledgement at once. The peer acknowledges cumulatively, so one ACK can cover many messages.
+    std::size_t SendWindow = 32;
+    std::uint32_t NextSequence = 0; //Only touched by the application thread.
+    std::deque<PendingAck> Unacknowledged;
+    std::mutex SendWindowMutex;
+    std::condition_variable SendWindowChanged;
+
+    //Acknowledging the peer's reliable messages. Only touched by the handler thread.
+    std::uint32_t LastReceivedSequence = 0;
+    bool AckPending = false;
+
+    //Sessions. The connecting side sends a Hello with its session token, and the accepting side replies with the token
+    //to use from then on. If the token matches an earlier connection, each side replays the reliable messages the other
+    //hasn't received yet. Messages aren't sent until the Hello exchange is done. Only touched by the handler thread.
+    std::uint64_t SessionToken = 0;
+    bool SessionEstablished = false;
+    std::deque<Frame> ControlFrames; //Frames made by the handler itself (Hellos and replays). Sent before OutgoingQueue.
+    std::chrono::steady_clock::time_point ClosedAt;
+
+    //Set when the peer sends a Goodbye, so we know the connection was closed on purpose. Read by SocketServer too.
+    std::atomic<bool> PeerSaidGoodbye{false};
+
+    //Given to sessions by SocketServer. Looks up the closed session a client wants to resume, and chooses the token to use.
+    std::function<std::shared_ptr<Sockets>(std::shared_ptr<Sockets>, std::uint64_t&)> ResumeSession;
+
+    //Logical channels. Any besides channel 0 are added before the handler starts, so both threads can look them up
+    //without locking. Only channel 0 carries reliable messages, so they're always acknowledged in order.
+    std::vector<std::shared_ptr<LogicalChannel> > Channels;
+    std::vector<LogicalChannel*> ChannelsByID = std::vector<LogicalChannel*>(256, nullptr);
+
+    //The write scheduler's state, by slot: 0 for channel 0, then one for each of Channels. Only touched by the handler,
+    //apart from the weights. See PrepareWrite().
+    std::vector<int> ChannelWeights = {1};
+    std::vector<std::int64_t> ChannelDeficits = {0};
+    std::vector<std::size_t> ChannelFramesInBatch = {0};
+    std::vector<std::size_t> BatchSlots; //The slot each frame in the write came from, in order.
+    std::size_t NextChannel = 0;
+    bool ChannelTurnStarted = false; //The last write filled up part way through NextChannel's turn.
+
+    //Heartbeats. We ping the peer every HeartbeatInterval, and give up on it if we hear nothing at all for
+    //MissedHeartbeatLimit intervals. An interval of 0 turns heartbeats off. The times are only touched by the handler thread.
+    std::chrono::milliseconds HeartbeatInterval{1000};
+    int MissedHeartbeatLimit = 3;
+    std::chrono::steady_clock::time_point LastHeardFrom;
+    std::chrono::steady_clock::time_point LastPingSent;
+
+    //RTT estimates, in microseconds (as in RFC 6298). Written by the handler thread, read by anyone.
+    std::atomic<std::uint64_t> RTTSamples{0};
+    std::atomic<std::uint64_t> SmoothedRTT{0};
+    std::atomic<std::uint64_t> RTTVariation{0};
+
+    //SendToPeer() waits SmoothedRTT + 4 * RTTVariation for an acknowledgement, within these limits. The polling handler
+    //can take up to a second to send a message, so the minimum allows for that.
+    std::chrono::milliseconds InitialAckTimeout{3000};
+    std::chrono::milliseconds MinAckTimeout{2000};
+    std::chrono::milliseconds MaxAckTimeout{60000};
+
+    //Reconnecting. Waits start at InitialReconnectDelay and double after each failed attempt, up to MaxReconnectDelay.
+    std::chrono::milliseconds InitialReconnectDelay{100};
+    std::chrono::milliseconds MaxReconnectDelay{10000};
+    int MaxReconnectAttempts = 10;
+
+    //Write coalescing. The handler sends up to MaxBatchFrames frames (or MaxBatchBytes bytes) from OutgoingQueue with
+    //each write. The headers must outlive the write, so they're kept here.
+    std::size_t MaxBatchFrames = 32;
+    std::size_t MaxBatchBytes = 64 * 1024;
+    std::vector<char> WriteHeaders = std::vector<char>((32 + 1) * FrameHeaderSize);
+
+    //Written by the handler thread, read by anyone.
+    std::atomic<std::uint64_t> StatWrites{0};
+    std::atomic<std::uint64_t> StatMessages{0};
+    std::atomic<std::uint64_t> StatBytes{0};
+    std::atomic<std::uint64_t> StatLargestBatch{0};
+    std::atomic<std::uint64_t> StatCompressedMessages{0};
+    std::atomic<std::uint64_t> StatUncompressedBytes{0};
+    std::atomic<std::uint64_t> StatCompressedBytes{0};
+
+    //Compression. Data frames of at least CompressionThreshold bytes are compressed with the first of Compressors that
+    //the peer listed in its Hello. A threshold of 0 turns compression off, and we don't offer the peer any codecs.
+    std::vector<std::shared_ptr<Compressor> > Compressors = {std::make_shared<LZCompressor>()};
+    std::size_t CompressionThreshold = 512;
+    std::shared_ptr<Compressor> PeerCompressor; //Only touched by the handler. Null if we can't compress for this peer.
+
+    //Socket options. The buffer sizes are what the kernel actually gave us (Linux doubles what we ask for), or 0 until
+    //we've connected. QuickAckActive is only touched by the handler, because TCP_QUICKACK has to be set again after reads.
+    SocketTuning Tuning;
+    std::atomic<int> ActualSendBufferSize{0};
+    std::atomic<int> ActualReceiveBufferSize{0};
+    bool QuickAckActive = false;
+
+    //Polling handler. The socket is registered with EventReactor once per connection, rather than being added to an
+    //fd_set every time we wait. In edge-triggered mode, SocketReadable remembers that we stopped reading before the
+    //socket ran dry, because the reactor won't tell us again.
+    std::unique_ptr<Reactor> EventReactor;
+    std::vector<ReactorEvent> ReadyEvents;
+    int RegisteredDescriptor = -1;
+    bool EdgeTriggered = false;
+    bool SocketReadable = false;
+    int MaxReadsPerWakeup = 16;
+
+    //Shared memory transport. Set up once connected if the address starts with "shm:", and used instead of reading
+    //and writing the socket. Sessions wait for the client to send it before they start.
+    std::shared_ptr<SharedMemoryStream> SharedMemory;
+    bool AwaitingSharedMemory = false;
+
+    //The polling handler's writes. Filled from the batch each time, so it never allocates once it's big enough.
+    std::vector<iovec> SendVector;
+
+#ifdef STROODLR_IO_URING
+    //io_uring backend for the polling handler, used instead of EventReactor if the kernel supports it. Each loop submits
+    //the next batch to send, a multishot receive (if one isn't running), and any receive buffers we've finished with,
+    //all with one system call. Only touched by the handler thread.
+    std::unique_ptr<IOUring> Ring;
+    bool RingUnavailable = false;
+    bool RingFallingBack = false; //Multishot receives aren't supported. Stop using the ring once the last send is done.
+    bool RingSendInFlight = false;
+    bool RingReceiveArmed = false;
+    bool RingReceiveCancelled = false;
+    bool RingWakeArmed = false;
+    std::size_t RingFramesInFlight = 0;
+    std::size_t RingControlFramesInFlight = 0;
+    std::size_t RingBytesInFlight = 0;
+    std::size_t RingBytesSent = 0; //Of RingBytesInFlight, if the kernel sent only part of the batch.
+    std::vector<boost::asio::const_buffer> RingBuffers;
+    std::vector<iovec> RingVectors;
+    msghdr RingMessage;
+    std::vector<UringCompletion> RingCompletions;
+#endif
+
+    //Framing. Reassembles whole messages from whatever read_some() gives us. We read straight into its ring, and
+    //uncompressed messages stay there until the application has finished with them.
+    FrameDecoder Decoder;
+
+    //Compressed messages are decompressed into buffers from ReceivePool, which get recycled when the application calls Pop().
+    BufferPool ReceivePool;
+    std::vector<char> SpareBuffer; //Acquired, but not filled yet. Only touched by the handler thread.
+
+    //Boost core variables. The handler thread replaces io_service and Strand on each connection, while other threads
+    //post work to them, so they're only changed with ServiceMutex held. The handler thread can read them directly;
+    //anything else uses PostToStrand() or StopService(), which hold the lock while they use them.
     std::shared_ptr<boost::asio::io_service> io_service;
-    std::shared_ptr<boost::asio::ip::tcp::resolver> resolver;
-    boost::asio::ip::tcp::resolver::iterator endpoint_iterator;
-    std::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor;
+    std::mutex ServiceMutex;
+    std::vector<StreamProtocol::endpoint> Endpoints; //Where a plug can connect to, in the order to try them.
+    std::shared_ptr<StreamAcceptor> acceptor;
 
     //Handler functions.
     static void Handler(Sockets* Ptr);
-    void CreateAndConnect(Sockets* Ptr);
+    bool CreateAndConnect(Sockets* Ptr);
+    bool Reconnect();
+    bool SetState(const ConnectionState NewState);
+    bool CanTransmit();
+    void SetService(const std::shared_ptr<boost::asio::io_service>& Service);
+    void SetStrand(const std::shared_ptr<boost::asio::io_service::strand>& NewStrand);
+    bool PostToStrand(const std::function<void()>& Work);
+    void StopService();
+    void ReleaseBoostObjects();
 
     //Connection functions (Plug).
     void CreatePlug();
@@ -64,49 +433,253 @@ private:
     void CreateSocket();
     void ConnectSocket();
 
+    //Tuning functions.
+    void ApplyTuning();
+    void RearmQuickAck();
+
     //R/W Functions.
     int SendAnyPendingMessages();
     int AttemptToReadFromSocket();
+    int ReadUntilWouldBlock();
+    int ReadFromSharedMemory();
+    void Wake();
+    void ClearWake();
+    bool WaitForWake(const std::chrono::milliseconds& Timeout);
+    int DrainTimeLeft();
+    std::chrono::microseconds HandlerWaitTimeout();
+    void Drain();
+    int WriteWhileReading(const std::vector<boost::asio::const_buffer>& Buffers);
+    std::size_t SendSome(const std::vector<boost::asio::const_buffer>& Buffers, const std::size_t Offset);
+
+#ifdef STROODLR_IO_URING
+    //io_uring functions.
+    bool SetUpRing();
+    int RunRingIteration();
+    void HandleRingCompletion(const UringCompletion& Completion, int& Result);
+    void ResubmitRingSend(const std::size_t Sent);
+    void AbandonRing();
+#endif
+    bool PushReceivedFrames();
+    void NotifyDataArrived();
+    bool HaveFramesToSend();
+    bool HaveUnsentFrames();
+    std::size_t PrepareWrite(std::vector<boost::asio::const_buffer>& Buffers, std::size_t& ControlFramesInBatch);
+    void FinishWrite(const std::size_t ControlFramesSent, const std::size_t FramesSent);
+    void RecordWrite(const std::size_t Frames, const std::size_t Bytes);
+    bool QueueFrame(Frame& NewFrame, const std::string& Policy);
+    std::size_t QueueFrames(std::vector<Frame>& Frames, const std::string& Policy);
+    void NotifyFramesQueued();
+    void NotifyOutgoingRoom();
+    void NotifyIncomingRoom(const bool OnChannel);
+    void WaitForOutgoingRoom(LogicalChannel* Target);
+    void HandleControl(const Message& Msg);
+    void HandleGoodbye(const char Reason);
+    void SayGoodbye(const char Reason);
+    bool OutgoingQueueFull();
+    void UpdateReadsPaused();
+    std::size_t ClearOutgoingQueue();
+    SPSCQueue<Frame>& ChannelOutgoingQueue(const std::size_t Slot);
+    LogicalChannel* FindChannel(const std::uint8_t Channel);
+    bool ChannelIncomingFull();
+    bool IncomingHasRoom();
+    bool PushHeldMessages();
+
+    //Compression functions.
+    std::vector<char> GetCodecIDs();
+    void ChooseCompressor(const std::vector<char>& PeerCodecs);
+    std::size_t CompressFrame(Frame& OutFrame);
+
+    //Reliable sending functions.
+    void HandleAck(const std::uint32_t Sequence);
+    void FailUnacknowledged();
+
+    //Heartbeat functions.
+    void StartHeartbeat();
+    bool CheckHeartbeat();
+    void StartHeartbeatTimer();
+    void HandleHeartbeatTimer();
+    void HandlePing(const std::uint64_t Timestamp);
+    void HandlePong(const std::uint64_t Timestamp);
+
+    //Session resumption functions.
+    void SendHello();
+    void HandleHello(const std::uint64_t PeerToken, const std::uint32_t PeerLastReceived, const std::vector<char>& PeerCodecs);
+    void FinishHello(const std::uint32_t PeerLastReceived);
+    void ReplayUnacknowledged();
+    std::shared_ptr<ResumeState> DetachState();
+    void AttachState(ResumeState& State);
+
+    //Async R/W functions.
+    int RunAsyncHandler();
+    void StartAsyncRead();
+    void StartAsyncWrite();
+    void HandleAsyncRead(const boost::system::error_code& Error, const std::size_t BytesRead);
+    void HandleAsyncWrite(const boost::system::error_code& Error, const std::size_t BytesWritten);
+    void RetryAsyncRead();
+    void HandleConnectionLost();
+    void BeginAsyncDrain();
+    void CheckDrained();
+    void FinishAsyncDrain();
+    void HandleSharedMemoryReadable(const boost::system::error_code& Error);
+    void HandleSharedMemoryOffer(const boost::system::error_code& Error);
+
+    //Session functions.
+    Sockets(std::shared_ptr<boost::asio::io_service> Service, std::shared_ptr<StreamProtocol::socket> AcceptedSocket);
+    void StartSession();
+    std::shared_ptr<Sockets> KeepAlive();
 
 public:
     //Constructors.
     Sockets(std::string TheType) : Type(TheType) {};
 
-    //Destructor. The order of destruction is important here.
-    ~Sockets() {
-        Socket = nullptr;
-        acceptor = nullptr;
-        resolver = nullptr;    
-        io_service->stop();
-        io_service = nullptr;
-    }
+    //Destructor.
+    ~Sockets();
 
     //Other constructors.
     Sockets(const Sockets& that) = delete; //Don't allow the copy constructor, because it's often dangerous to allow multiple references to a socket.
     Sockets operator = (const Sockets& rhs) = delete; //Comparisons are pointless;
-    std::shared_ptr<boost::asio::ip::tcp::socket> operator * ();
+    std::shared_ptr<StreamProtocol::socket> operator * ();
 
     //Setup functions.
     void SetPortNumber(const int& PortNo);
-    void SetServerAddress(const std::string& ServerAdd); //Only needed when creating a plug.
+    void SetServerAddress(const std::string& ServerAdd); //Where a plug connects to, or a socket listens on. May be a "unix:" path.
     void SetConsoleOutput(const bool State); //Can tell us not to output any message to console (used in server).
+    void SetHandlerMode(const std::string& Mode); //"Polling" (the default) or "Async".
+    void SetEdgeTriggered(const bool State); //Use edge-triggered epoll in the polling handler. Set before StartHandler().
+    void SetSendWindow(const int& Size); //The number of reliable messages that can be waiting for an acknowledgement.
+    void SetWriteBatchLimits(const int& MaxFrames, const int& MaxBytes); //Caps on how much is sent with each write. Set before StartHandler().
+    void SetOnMessage(const std::function<void(const Message&)>& Callback); //Deliver messages to Callback instead of queuing them. Set before StartHandler().
+    void SetOnControl(const std::function<void(const Message&)>& Callback); //Called on the handler thread with each control message from the peer. Set before StartHandler().
+    void SetReconnectBackoff(const int& InitialDelay, const int& MaxDelay, const int& MaxAttempts); //Delays in milliseconds. Set before StartHandler().
+    void SetHeartbeat(const int& Interval, const int& MissedLimit); //Interval in milliseconds, or 0 to turn heartbeats off. Set before StartHandler().
+    void SetDrainTimeout(const int& Timeout); //How long (in milliseconds) to keep sending queued messages once asked to exit. 0 doesn't wait. Set before StartHandler().
+    void SetIncomingWatermarks(const QueueWatermarks& Watermarks); //Set before StartHandler().
+    void SetOutgoingWatermarks(const QueueWatermarks& Watermarks);
+    void SetWritePolicy(const std::string& Policy); //What Write() does when OutgoingQueue is full: "Block" (the default), "Fail" (throw std::runtime_error) or "Drop".
+    void SetCompressionThreshold(const int& Threshold); //Compress messages of at least Threshold bytes, if the peer can. 0 turns compression off. Set before StartHandler().
+    void SetTuning(const SocketTuning& NewTuning); //Socket options for every connection. Set before StartHandler(), like the setters below.
+    void SetNoDelay(const bool State);
+    void SetBufferSizes(const int& SendSize, const int& ReceiveSize);
+    void SetQuickAck(const bool State);
+    void SetBusyPoll(const int& Microseconds);
+    void SetKeepAlive(const int& Idle, const int& Interval, const int& Count);
+    void AddCompressor(std::shared_ptr<Compressor> Codec); //Preferred over the codecs we already have. Set before StartHandler().
+    void AddChannel(const std::uint8_t ID, const int& Weight = 1); //Channel 0 always exists, so adding it just sets its weight. Set before StartHandler().
+    void AddStateCallback(const std::function<void(const ConnectionState, const ConnectionState)>& Callback); //Called with the old and new state on each change, on the thread that made it. Set before StartHandler().
     void StartHandler();
 
     //Info getter functions.
-    bool IsReady();
+    bool IsReady(); //True if Connected.
     bool JustReconnected();
     void WaitForHandlerToExit();
-    bool HandlerHasExited();
+    bool HandlerHasExited(); //True if Closed.
+    ConnectionState GetState();
+    bool WaitForState(const ConnectionState Wanted, const std::chrono::milliseconds& Timeout); //Waits up to Timeout for Wanted, or Closed. Returns true if we're in Wanted.
+    bool WaitForState(const ConnectionState Wanted); //Likewise, with no timeout.
+    WriteStatistics GetWriteStatistics();
+    BufferPoolStatistics GetReceivePoolStatistics();
+    RoundTripStatistics GetRoundTripStatistics();
+    QueueStatistics GetQueueStatistics();
+    std::chrono::milliseconds GetAckTimeout();
+    SocketTuning GetTuning(); //The buffer sizes are what the kernel gave us, or 0 if we haven't connected yet.
 
     //Controller functions.
     void RequestHandlerExit();
     void Reset();
 
     //Request R/W functions.
-    void Write(std::vector<char> Msg);
-    void SendToPeer(const std::vector<char>& Msg); //Convenience function that waits for an acknowledgement before returning.
+    //Messages that haven't been sent when the connection is lost are dropped (and counted in DroppedMessages), so only
+    //SendReliable() messages are sure to survive a reconnect.
+    bool Write(const Message& Msg); //Messages are reference-counted, so this doesn't copy the payload. Returns false if Msg was dropped.
+    std::size_t WriteBatch(const Message* Messages, const std::size_t Count); //Like calling Write() for each message, but hands them all to the handler at once. Returns the number queued.
+    std::size_t WriteBatch(const std::vector<Message>& Messages);
+    std::future<bool> SendReliable(const Message& Msg); //The future becomes true when the peer acknowledges Msg, or false if the connection is lost first.
+    bool SendToPeer(const Message& Msg); //Convenience function that waits up to GetAckTimeout() for an acknowledgement. Returns true if it came.
+    bool SendControl(const Message& Msg); //Sends Msg ahead of every message waiting on any channel, to the peer's OnControl callback. Returns false if the control lane is full.
     bool HasPendingData();
-    std::vector<char> Read();
+    bool WaitForData(const std::chrono::milliseconds& Timeout); //Waits until there's a message to read, up to Timeout. Returns HasPendingData().
+    Message Read(); //Shares the front message's payload rather than copying it.
+    Message ReadBlocking(); //Waits for a message, then returns and pops it. Throws std::runtime_error if the handler exits first.
+    std::size_t DrainAll(std::vector<Message>& Out, const std::size_t Max = SIZE_MAX); //Moves up to Max messages onto the end of Out at once. Returns the number moved.
     void Pop();
 
+    //Logical channel R/W functions. Like those above, but for channel ID, which must have been added with AddChannel().
+    //Throw std::runtime_error if it hasn't. Messages on other channels never go to the OnMessage callback. Messages the
+    //peer sends on a channel we haven't added are dropped with a warning.
+    bool Write(const Message& Msg, const std::uint8_t Channel);
+    bool HasPendingData(const std::uint8_t Channel);
+    Message Read(const std::uint8_t Channel);
+    void Pop(const std::uint8_t Channel);
+
+};
+
+//Accepts any number of clients, and serves each with its own Sockets (a "Session") on a shared pool of threads.
+class SocketServer {
+private:
+    //Core variables.
+    int PortNumber = 50000;
+    std::string Address; //Empty means every IPv4 interface.
+    int ThreadCount = 1;
+    std::vector<std::thread> Threads;
+
+    //Sessions. Accessed by both the pool and the application thread.
+    std::mutex SessionsMutex;
+    std::vector<std::shared_ptr<Sockets> > Sessions;
+
+    //Closed sessions that can still be resumed, by token. Forgotten once they've been closed for ResumeTimeout.
+    std::map<std::uint64_t, std::shared_ptr<Sockets> > SessionsByToken;
+    std::chrono::seconds ResumeTimeout{30};
+
+    //Socket options and logical channels (IDs and weights), given to each new session.
+    SocketTuning Tuning;
+    std::vector<std::pair<std::uint8_t, int> > Channels;
+
+    //Boost core variables.
+    std::shared_ptr<boost::asio::io_service> io_service;
+    std::shared_ptr<boost::asio::io_service::work> Work;
+    std::shared_ptr<boost::asio::steady_timer> ReapTimer;
+    std::shared_ptr<StreamAcceptor> acceptor;
+    std::shared_ptr<StreamProtocol::socket> NextSocket;
+
+    //Given to each new session, along with the session itself.
+    std::function<void(std::shared_ptr<Sockets>, const Message&)> OnMessage;
+    std::function<void(std::shared_ptr<Sockets>, const Message&)> OnControl;
+
+    //Private functions.
+    void StartAccept();
+    void HandleAccept(const boost::system::error_code& Error);
+    std::shared_ptr<Sockets> ResumeSession(std::shared_ptr<Sockets> Session, std::uint64_t& Token);
+    void StartReapTimer();
+    void ReapSessions();
+
+public:
+    //Constructors.
+    SocketServer() {};
+
+    //Destructor.
+    ~SocketServer() {
+        Stop();
+    }
+
+    //Other constructors.
+    SocketServer(const SocketServer& that) = delete;
+    SocketServer operator = (const SocketServer& rhs) = delete;
+
+    //Setup functions.
+    void SetPortNumber(const int& PortNo);
+    void SetAddress(const std::string& Add); //An IP address to listen on, or a "unix:" path for a Unix domain socket.
+    void SetThreadCount(const int& Count);
+    void SetResumeTimeout(const int& Seconds); //How long a disconnected client has to come back and resume its session.
+    void SetTuning(const SocketTuning& NewTuning); //Socket options for every session. Set before Start().
+    void AddChannel(const std::uint8_t ID, const int& Weight = 1); //Every session gets this logical channel. Set before Start().
+    void SetOnMessage(const std::function<void(std::shared_ptr<Sockets>, const Message&)>& Callback); //Called on the pool's threads. Set before Start().
+    void SetOnControl(const std::function<void(std::shared_ptr<Sockets>, const Message&)>& Callback); //Likewise, for control messages.
+
+    //Controller functions.
+    void Start();
+    void Stop();
+
+    //Info getter functions.
+    std::vector<std::shared_ptr<Sockets> > GetSessions();
+
 };
@@ -37,25 +37,12 @@ extern Logging Logger;
 
 string ConvertToString(const vector<char>& Vec) {
     //Converts a vector<char> to a string to make it easy to read and process.
-    std::string tempstring;
-
-    for (int i = 0; i < Vec.size(); i++) {
-        tempstring += Vec[i];
-
-    }
-
-    return tempstring;
+    return string(Vec.begin(), Vec.end());
 }
 
 vector<char> ConvertToVectorChar(const string& Str) {
-    //Converts a string to a vector<char> so it can be put on a message queue.
-    vector<char> tempvec;
-
-    for (int i = 0; i < Str.length(); i++) {
-        tempvec.push_back(Str[i]);
-    }
-
-    return tempvec;
+    //Converts a string to a vector<char>.
+    return vector<char>(Str.begin(), Str.end());
 }
 
 vector<string> split(const string& mystring, const string delimiters) {
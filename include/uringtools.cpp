@@ -0,0 +1,313 @@
+/*
+io_uring Tools for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <boost/system/system_error.hpp>
+
+#include "uringtools.h"
+
+using std::vector;
+
+//Our receive buffers are all in this group.
+static const std::uint16_t BufferGroup = 0;
+
+//Completions for giving buffers back are dealt with here, and never returned to the caller.
+static const std::uint64_t ProvideBuffersTag = ~static_cast<std::uint64_t>(0);
+
+//Local helpers.
+static void ThrowError(const int Error, const char* What) {
+    throw boost::system::system_error(boost::system::error_code(Error, boost::system::system_category()), What);
+
+}
+
+//Define IOUring's functions.
+//---------- Constructors ----------
+IOUring::IOUring(const unsigned int Entries, const std::size_t BufferCount, const std::size_t BufferSize)
+    : BufferSize(BufferSize), Buffers(BufferCount * BufferSize) {
+
+    std::memset(&Params, 0, sizeof(Params));
+    RingDescriptor = static_cast<int>(syscall(__NR_io_uring_setup, Entries, &Params));
+
+    if (RingDescriptor == -1) {
+        ThrowError(errno, "io_uring_setup");
+
+    }
+
+    //We need a timeout when waiting, and the completion ring mapped with the submission ring (both since 5.11).
+    if (!(Params.features & IORING_FEAT_EXT_ARG) || !(Params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(RingDescriptor);
+        ThrowError(ENOSYS, "io_uring is too old");
+
+    }
+
+    //The features above don't tell us which operations there are. Multishot receives can't be probed for: if the
+    //kernel doesn't have them, the first one fails with EINVAL, and Sockets switches to epoll.
+    if (!SupportsOperations()) {
+        close(RingDescriptor);
+        ThrowError(ENOSYS, "io_uring doesn't support the operations we need");
+
+    }
+
+    SubmissionRingSize = std::max(Params.sq_off.array + Params.sq_entries * sizeof(unsigned),
+                                  Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe));
+    SubmissionEntriesSize = Params.sq_entries * sizeof(io_uring_sqe);
+
+    SubmissionRing = mmap(nullptr, SubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingDescriptor, IORING_OFF_SQ_RING);
+    void* EntryMemory = mmap(nullptr, SubmissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingDescriptor, IORING_OFF_SQES);
+
+    if (SubmissionRing == MAP_FAILED || EntryMemory == MAP_FAILED) {
+        int Error = errno;
+
+        if (SubmissionRing == MAP_FAILED) {
+            SubmissionRing = nullptr;
+
+        }
+
+        SubmissionEntries = (EntryMemory == MAP_FAILED) ? nullptr : static_cast<io_uring_sqe*>(EntryMemory);
+        Unmap();
+        close(RingDescriptor);
+        ThrowError(Error, "mmap");
+
+    }
+
+    SubmissionEntries = static_cast<io_uring_sqe*>(EntryMemory);
+
+    char* Ring = static_cast<char*>(SubmissionRing);
+    SubmissionHead = reinterpret_cast<unsigned*>(Ring + Params.sq_off.head);
+    SubmissionTail = reinterpret_cast<unsigned*>(Ring + Params.sq_off.tail);
+    SubmissionMask = reinterpret_cast<unsigned*>(Ring + Params.sq_off.ring_mask);
+    SubmissionArray = reinterpret_cast<unsigned*>(Ring + Params.sq_off.array);
+    CompletionHead = reinterpret_cast<unsigned*>(Ring + Params.cq_off.head);
+    CompletionTail = reinterpret_cast<unsigned*>(Ring + Params.cq_off.tail);
+    CompletionMask = reinterpret_cast<unsigned*>(Ring + Params.cq_off.ring_mask);
+    CompletionEntries = reinterpret_cast<io_uring_cqe*>(Ring + Params.cq_off.cqes);
+
+    //Hand every buffer to the kernel in one go.
+    io_uring_sqe* Entry = GetEntry();
+    Entry->opcode = IORING_OP_PROVIDE_BUFFERS;
+    Entry->fd = static_cast<int>(BufferCount);
+    Entry->addr = reinterpret_cast<std::uint64_t>(Buffers.data());
+    Entry->len = static_cast<std::uint32_t>(BufferSize);
+    Entry->buf_group = BufferGroup;
+    Entry->off = 0;
+    Entry->user_data = ProvideBuffersTag;
+
+}
+
+IOUring::~IOUring() {
+    Unmap();
+    close(RingDescriptor);
+
+}
+
+//---------- Queuing Functions ----------
+void IOUring::QueueSendMessage(const int FileDescriptor, const msghdr* Message, const std::uint64_t Tag) {
+    //MSG_WAITALL makes the kernel keep going until everything is sent, like boost::asio::write().
+    io_uring_sqe* Entry = GetEntry();
+    Entry->opcode = IORING_OP_SENDMSG;
+    Entry->fd = FileDescriptor;
+    Entry->addr = reinterpret_cast<std::uint64_t>(Message);
+    Entry->len = 1;
+    Entry->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    Entry->user_data = Tag;
+
+}
+
+void IOUring::QueueMultishotReceive(const int FileDescriptor, const std::uint64_t Tag) {
+    //Keeps receiving into our buffers, with a completion for each, until it's cancelled or fails.
+    io_uring_sqe* Entry = GetEntry();
+    Entry->opcode = IORING_OP_RECV;
+    Entry->fd = FileDescriptor;
+    Entry->ioprio = IORING_RECV_MULTISHOT;
+    Entry->flags = IOSQE_BUFFER_SELECT;
+    Entry->buf_group = BufferGroup;
+    Entry->user_data = Tag;
+
+}
+
+void IOUring::QueuePoll(const int FileDescriptor, const std::uint64_t Tag) {
+    //Completes once, as soon as FileDescriptor is readable.
+    io_uring_sqe* Entry = GetEntry();
+    Entry->opcode = IORING_OP_POLL_ADD;
+    Entry->fd = FileDescriptor;
+    Entry->poll32_events = POLLIN;
+    Entry->user_data = Tag;
+
+}
+
+void IOUring::QueueCancel(const std::uint64_t TargetTag, const std::uint64_t Tag) {
+    io_uring_sqe* Entry = GetEntry();
+    Entry->opcode = IORING_OP_ASYNC_CANCEL;
+    Entry->addr = TargetTag;
+    Entry->user_data = Tag;
+
+}
+
+void IOUring::ReturnBuffer(const std::uint16_t BufferID) {
+    //Lets the kernel fill the buffer again.
+    io_uring_sqe* Entry = GetEntry();
+    Entry->opcode = IORING_OP_PROVIDE_BUFFERS;
+    Entry->fd = 1;
+    Entry->addr = reinterpret_cast<std::uint64_t>(Buffers.data() + BufferID * BufferSize);
+    Entry->len = static_cast<std::uint32_t>(BufferSize);
+    Entry->buf_group = BufferGroup;
+    Entry->off = BufferID;
+    Entry->user_data = ProvideBuffersTag;
+
+}
+
+//---------- Waiting Functions ----------
+std::size_t IOUring::SubmitAndWait(const std::chrono::microseconds& Timeout, vector<UringCompletion>& Completions) {
+    __kernel_timespec TimeSpec;
+    TimeSpec.tv_sec = Timeout.count() / 1000000;
+    TimeSpec.tv_nsec = (Timeout.count() % 1000000) * 1000;
+
+    io_uring_getevents_arg Argument;
+    std::memset(&Argument, 0, sizeof(Argument));
+    Argument.ts = reinterpret_cast<std::uint64_t>(&TimeSpec);
+
+    //Timing out, or being interrupted, just means there's nothing to do yet.
+    int Result = Enter(Unsubmitted, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &Argument, sizeof(Argument));
+
+    if (Result < 0 && errno != ETIME && errno != EINTR) {
+        ThrowError(errno, "io_uring_enter");
+
+    }
+
+    Completions.clear();
+
+    unsigned Head = *CompletionHead;
+    unsigned Tail = __atomic_load_n(CompletionTail, __ATOMIC_ACQUIRE);
+
+    for (; Head != Tail; Head++) {
+        const io_uring_cqe& Entry = CompletionEntries[Head & *CompletionMask];
+
+        if (Entry.user_data == ProvideBuffersTag) {
+            if (Entry.res < 0) {
+                __atomic_store_n(CompletionHead, Head + 1, __ATOMIC_RELEASE);
+                ThrowError(-Entry.res, "io_uring provide buffers");
+
+            }
+
+            continue;
+
+        }
+
+        UringCompletion Completion;
+        Completion.Tag = Entry.user_data;
+        Completion.Result = Entry.res;
+        Completion.HasBuffer = (Entry.flags & IORING_CQE_F_BUFFER) != 0;
+        Completion.BufferID = static_cast<std::uint16_t>(Entry.flags >> IORING_CQE_BUFFER_SHIFT);
+        Completion.More = (Entry.flags & IORING_CQE_F_MORE) != 0;
+
+        Completions.push_back(Completion);
+
+    }
+
+    __atomic_store_n(CompletionHead, Head, __ATOMIC_RELEASE);
+
+    return Completions.size();
+
+}
+
+//---------- Private Functions ----------
+io_uring_sqe* IOUring::GetEntry() {
+    //Returns the next free submission entry, cleared. If the ring is full, submits what's there to make room.
+    unsigned Tail = *SubmissionTail;
+
+    if (Tail - __atomic_load_n(SubmissionHead, __ATOMIC_ACQUIRE) == Params.sq_entries) {
+        if (Enter(Unsubmitted, 0, 0, nullptr, 0) < 0) {
+            ThrowError(errno, "io_uring_enter");
+
+        }
+    }
+
+    unsigned Index = Tail & *SubmissionMask;
+    io_uring_sqe* Entry = &SubmissionEntries[Index];
+
+    //The kernel only looks at entries when we call Enter() (we don't use SQPOLL), so it's fine to publish this one
+    //before the caller fills it in.
+    std::memset(Entry, 0, sizeof(*Entry));
+    SubmissionArray[Index] = Index;
+    __atomic_store_n(SubmissionTail, Tail + 1, __ATOMIC_RELEASE);
+    Unsubmitted++;
+
+    return Entry;
+
+}
+
+int IOUring::Enter(const unsigned int ToSubmit, const unsigned int MinComplete, const unsigned int Flags, void* Argument, const std::size_t ArgumentSize) {
+    int Result = static_cast<int>(syscall(__NR_io_uring_enter, RingDescriptor, ToSubmit, MinComplete, Flags, Argument, ArgumentSize));
+
+    if (Result >= 0) {
+        Unsubmitted -= std::min<unsigned>(Unsubmitted, Result);
+
+    }
+
+    return Result;
+
+}
+
+bool IOUring::SupportsOperations() {
+    //Asks the kernel which operations it supports (IORING_REGISTER_PROBE, since 5.6), and returns true if it has all
+    //of the ones we use.
+    const unsigned int ProbeCount = 256;
+    vector<char> Memory(sizeof(io_uring_probe) + ProbeCount * sizeof(io_uring_probe_op), 0);
+    io_uring_probe* Probe = reinterpret_cast<io_uring_probe*>(Memory.data());
+
+    if (syscall(__NR_io_uring_register, RingDescriptor, IORING_REGISTER_PROBE, Probe, ProbeCount) == -1) {
+        return false;
+
+    }
+
+    const std::uint8_t Needed[] = {IORING_OP_SENDMSG, IORING_OP_RECV, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_PROVIDE_BUFFERS};
+
+    for (std::size_t i = 0; i < sizeof(Needed); i++) {
+        if (Needed[i] > Probe->last_op || !(Probe->ops[Needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+
+        }
+    }
+
+    return true;
+
+}
+
+void IOUring::Unmap() {
+    if (SubmissionEntries != nullptr) {
+        munmap(SubmissionEntries, SubmissionEntriesSize);
+
+    }
+
+    if (SubmissionRing != nullptr) {
+        munmap(SubmissionRing, SubmissionRingSize);
+
+    }
+}
@@ -0,0 +1,102 @@
+/*
+io_uring Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+//Structs.
+//A finished operation.
+struct UringCompletion {
+    std::uint64_t Tag;      //Whatever the operation was queued with.
+    int Result;             //As the equivalent system call would have returned it, or -errno.
+    bool HasBuffer;         //True if a receive used one of our buffers. Give it back with ReturnBuffer() when done.
+    std::uint16_t BufferID;
+    bool More;              //True if a multishot operation is still going.
+};
+
+//Class definitions.
+//A minimal io_uring, driven with the raw system calls so we don't need liburing. Receives use multishot recv with a
+//fixed pool of buffers provided to the kernel up front, and nothing is submitted until SubmitAndWait(), so a send, a
+//receive and any buffers being given back all go to the kernel with one system call. Only one thread may use it.
+class IOUring {
+public:
+    //Constructors. Throws boost::system::system_error if the kernel doesn't support what we need.
+    IOUring(const unsigned int Entries, const std::size_t BufferCount, const std::size_t BufferSize);
+
+    //Destructor. Don't destroy it while operations are still in progress: they'd use memory we've freed.
+    ~IOUring();
+
+    //Other constructors.
+    IOUring(const IOUring& that) = delete;
+    IOUring& operator = (const IOUring& rhs) = delete;
+
+    //Queuing functions. Message (and everything it points to) must stay valid until its send completes.
+    void QueueSendMessage(const int FileDescriptor, const msghdr* Message, const std::uint64_t Tag);
+    void QueueMultishotReceive(const int FileDescriptor, const std::uint64_t Tag);
+    void QueuePoll(const int FileDescriptor, const std::uint64_t Tag);
+    void QueueCancel(const std::uint64_t TargetTag, const std::uint64_t Tag);
+    void ReturnBuffer(const std::uint16_t BufferID);
+
+    //Submits everything queued, then waits up to Timeout for at least one completion. Replaces the contents of
+    //Completions with whatever has finished.
+    std::size_t SubmitAndWait(const std::chrono::microseconds& Timeout, std::vector<UringCompletion>& Completions);
+
+    //Info getter functions.
+    const char* GetBuffer(const std::uint16_t BufferID) const { return Buffers.data() + BufferID * BufferSize; }
+
+private:
+    //Variables.
+    int RingDescriptor = -1;
+    io_uring_params Params;
+
+    //Memory shared with the kernel. The completion ring is mapped with the submission ring.
+    void* SubmissionRing = nullptr;
+    std::size_t SubmissionRingSize = 0;
+    io_uring_sqe* SubmissionEntries = nullptr;
+    std::size_t SubmissionEntriesSize = 0;
+
+    //Pointers into the rings.
+    unsigned* SubmissionHead;
+    unsigned* SubmissionTail;
+    unsigned* SubmissionMask;
+    unsigned* SubmissionArray;
+    unsigned* CompletionHead;
+    unsigned* CompletionTail;
+    unsigned* CompletionMask;
+    io_uring_cqe* CompletionEntries;
+
+    //Entries we've filled in, but not submitted yet.
+    unsigned Unsubmitted = 0;
+
+    //Receive buffers, one after the other.
+    std::size_t BufferSize;
+    std::vector<char> Buffers;
+
+    //Private function declarations.
+    io_uring_sqe* GetEntry();
+    int Enter(const unsigned int ToSubmit, const unsigned int MinComplete, const unsigned int Flags, void* Argument, const std::size_t ArgumentSize);
+    bool SupportsOperations();
+    void Unmap();
+};
@@ -44,14 +44,20 @@ using std::deque;
 //Logger.
 Logging Logger;
 
-bool ReadyForTransmission = false;
-
 void Usage() {
     //Prints cmdline options.
     std::cout << "Usage: stroodlrc [OPTION]" << std::endl << std::endl << std::endl;
     std::cout << "Options:" << std::endl << std::endl;
     std::cout << "        -h, --help:               Show this help message." << std::endl;
     std::cout << "        -a, --serveraddress:      Specify the server address (if unspecified, assumed to be localhost)." << std::endl;
+    std::cout << "                                  Use unix:PATH (eg unix:/run/stroodlr.sock) to connect with a Unix domain socket." << std::endl;
+    std::cout << "        -A, --async:              Use the event-driven socket handler, which sends messages as soon as they are queued." << std::endl;
+    std::cout << "        --nodelay on|off:         Send small messages straight away (TCP_NODELAY, the default) or combine them." << std::endl;
+    std::cout << "        --sndbuf, --rcvbuf BYTES: Set the size of the kernel's send or receive buffer (SO_SNDBUF, SO_RCVBUF)." << std::endl;
+    std::cout << "        --quickack on|off:        Acknowledge data as soon as it arrives (TCP_QUICKACK, off by default)." << std::endl;
+    std::cout << "        --busypoll MICROSECONDS:  Busy-wait for packets for this long when reading (SO_BUSY_POLL)." << std::endl;
+    std::cout << "        --keepalive IDLE[,INTERVAL,COUNT]:" << std::endl;
+    std::cout << "                                  Turn on TCP keepalive after IDLE seconds without traffic." << std::endl;
     std::cout << "        -q, --quiet:              Show only warnings, errors and critical errors in the log file." << std::endl;
     std::cout << "                                  Very unhelpful for debugging, and not recommended." << std::endl;
     std::cout << "        -v, --verbose:            Enable logging of info messages, as well as warnings, errors and critical errors." << std::endl;
@@ -78,6 +84,8 @@ int main(int argc, char* argv[])
     Logger.SetLevel("Info");
     string ServerAddress = "localhost";
     int PortNumber = 50000;
+    bool UseAsyncHandler = false;
+    SocketTuning Tuning;
 
     //Vars to hold temporary data *** Clean up ***
     string command;
@@ -90,7 +98,7 @@ int main(int argc, char* argv[])
 
     //Parse the commandline options.
     try {
-        ServerAddress = ParseCmdlineOptions(ServerAddress, argc, argv);
+        ServerAddress = ParseCmdlineOptions(ServerAddress, UseAsyncHandler, Tuning, argc, argv);
 
     } catch (std::runtime_error const& e) {
         //Print the error, print usage and exit.
@@ -104,16 +112,20 @@ int main(int argc, char* argv[])
 
     Plug.SetPortNumber(PortNumber);
     Plug.SetServerAddress(ServerAddress);
+    Plug.SetTuning(Tuning);
+
+    if (UseAsyncHandler) {
+        Plug.SetHandlerMode("Async");
+
+    }
 
     Plug.StartHandler();
 
     Logger.Info("main(): Waiting for connection to server...");
     std::cout << std::endl << "Connecting to server..." << std::endl;
 
-    //Wait until we're connected, or requested to exit.
-    while (!Plug.IsReady() && !Plug.HandlerHasExited()) std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-    if (!Plug.IsReady()) {
+    //Wait until we're connected, or the handler gives up.
+    if (!Plug.WaitForState(ConnectionState::Connected)) {
         //Couldn't connect to server.
         Logger.Critical("Couldn't connect to server! Exiting...");
 
@@ -145,10 +157,8 @@ int main(int argc, char* argv[])
             //Deregister signal handler, so we can exit if we get stuck while connecting.
             signal(SIGINT, SIG_DFL);
 
-            //Wait until we're connected or have to exit because of a connection error..
-            while (!Plug.IsReady() && !Plug.HandlerHasExited()) std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-            if (Plug.HandlerHasExited()) {
+            //Wait until we're connected or have to exit because of a connection error.
+            if (!Plug.WaitForState(ConnectionState::Connected)) {
                 //Couldn't reconnect to client.
                 Logger.Critical("Couldn't reconnect to server! Exiting...");
 
@@ -272,7 +282,7 @@ int main(int argc, char* argv[])
 
         } else if (splitcommand[0] == "STATUS") {
             Logger.Info("main(): Showing status...");
-            ShowStatus();
+            ShowStatus(&Plug);
 
         } else if (splitcommand[0] == "LISTSERV") {
             Logger.Info("main(): Listing connected servers...");
@@ -317,20 +327,14 @@ int main(int argc, char* argv[])
                 }
             }
 
-            //Check this isn't a control message used for client-server communication.
-            if (abouttosend == "PEERGOODBYE") {
-                //Refuse to send it.
-                Logger.Error("main(): Won't send control message PEERGOODBYE. Warning user...");
-                std::cout << std::endl << "You cannot send control messages." << std::endl << std::endl;
-                command = "";
-
-                continue;
+            //Send it.
+            Logger.Info("main(): Sending the message...");
+            if (!Plug.SendToPeer(Message(abouttosend))) {
+                //It'll still be sent if the connection comes back.
+                std::cout << std::endl << "The server hasn't received that message yet. It will be sent again if the connection recovers." << std::endl << std::endl;
 
             }
 
-            //Send it.
-            Logger.Info("main(): Sending the message...");
-            Plug.SendToPeer(ConvertToVectorChar(abouttosend));
             Logger.Info("main(): Done.");
 
         } else {
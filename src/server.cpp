@@ -17,9 +17,11 @@ along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <string>
-#include <chrono>
+#include <vector>
+#include <memory>
 #include <thread>
 #include <signal.h> //POSIX-only. *** Try to find an alternative solution - might not be thread-safe ***
+#include <pthread.h> //POSIX-only.
 #include <stdexcept>
 
 //Custom includes.
@@ -33,14 +35,22 @@ using std::string;
 //Logger.
 Logging Logger;
 
-bool ReadyForTransmission = false;
-
 void Usage() {
     //Prints cmdline options.
     std::cout << "Usage: stroodlrd [OPTION]" << std::endl << std::endl << std::endl;
     std::cout << "Options:" << std::endl << std::endl;
     std::cout << "        -h, --help:               Show this help message." << std::endl;
     std::cout << "        -p, --portnumber:         Specify the port number (default is 50000)." << std::endl;
+    std::cout << "        -a, --address:            Specify the address to listen on (default is every IPv4 interface)." << std::endl;
+    std::cout << "                                  Use unix:PATH (eg unix:/run/stroodlr.sock) to listen on a Unix domain socket." << std::endl;
+    std::cout << "        -t, --threads:            Specify the number of threads used to serve clients (default is 1)." << std::endl;
+    std::cout << "        -A, --async:              Accepted for compatibility. Clients are always served by the event-driven handler." << std::endl;
+    std::cout << "        --nodelay on|off:         Send small messages straight away (TCP_NODELAY, the default) or combine them." << std::endl;
+    std::cout << "        --sndbuf, --rcvbuf BYTES: Set the size of the kernel's send or receive buffer (SO_SNDBUF, SO_RCVBUF)." << std::endl;
+    std::cout << "        --quickack on|off:        Acknowledge data as soon as it arrives (TCP_QUICKACK, off by default)." << std::endl;
+    std::cout << "        --busypoll MICROSECONDS:  Busy-wait for packets for this long when reading (SO_BUSY_POLL)." << std::endl;
+    std::cout << "        --keepalive IDLE[,INTERVAL,COUNT]:" << std::endl;
+    std::cout << "                                  Turn on TCP keepalive after IDLE seconds without traffic." << std::endl;
     std::cout << "        -q, --quiet:              Show only warnings, errors and critical errors in the log file." << std::endl;
     std::cout << "                                  Very unhelpful for debugging, and not recommended." << std::endl;
     std::cout << "        -v, --verbose:            Enable logging of info messages, as well as warnings, errors and critical errors." << std::endl;
@@ -65,12 +75,16 @@ int main(int argc, char* argv[]) {
     //Setup.
     Logger.SetLevel("Info");
     int PortNumber = 50000;
+    string Address;
+    int ThreadCount = 1;
+    SocketTuning Tuning;
+    sigset_t InterruptMask;
+    sigset_t OldMask;
     string Temp;
-    bool Continue = true;
 
     //Parse commandline options.
     try {
-        ParseCmdlineOptions(PortNumber, argc, argv);
+        ParseCmdlineOptions(PortNumber, Address, ThreadCount, Tuning, argc, argv);
 
     } catch (std::runtime_error const& e) {
         //Print the error, print usage and exit.
@@ -79,20 +93,29 @@ int main(int argc, char* argv[]) {
 
     }
 
-    //Setup Socket.
-    Sockets Socket("Socket");
+    //Block SIGINT until we're ready to wait for it, so it can only interrupt this thread (the pool's threads inherit this).
+    sigemptyset(&InterruptMask);
+    sigaddset(&InterruptMask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &InterruptMask, &OldMask);
+
+    //Setup the server. Clients can connect and disconnect at any time from here on.
+    SocketServer Server;
 
-    Socket.SetPortNumber(PortNumber);
-    Socket.SetConsoleOutput(false);
+    Server.SetPortNumber(PortNumber);
+    Server.SetAddress(Address);
+    Server.SetThreadCount(ThreadCount);
+    Server.SetTuning(Tuning);
 
-    Socket.StartHandler();
+    //Handle each message as soon as it arrives. The session acknowledges it itself.
+    Server.SetOnMessage([](std::shared_ptr<Sockets>, const Message& Msg) {
+        Logger.Debug("main(): Message from local client: "+Msg.ToString()+"...");
+    });
 
-    //Wait until we're connected or have to exit because of a connection error..
-    while (!Socket.IsReady() && !Socket.HandlerHasExited()) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    try {
+        Server.Start();
 
-    if (Socket.HandlerHasExited()) {
-        //Couldn't connect to client.
-        Logger.CriticalWCerr("Couldn't connect to client! Exiting...");
+    } catch (boost::system::system_error const& e) {
+        Logger.CriticalWCerr("Couldn't listen for clients: "+static_cast<string>(e.what())+". Exiting...");
 
         exit(1);
 
@@ -101,47 +124,14 @@ int main(int argc, char* argv[]) {
     //Setup signal handler.
     signal(SIGINT, RequestExit);
 
+    //The pool does all the work, so just sleep until we're asked to exit.
     while (!::RequestedExit) {
-        //Check that we're still connected.
-        if (!Socket.IsReady()) {
-            Logger.Info("main(): Client has disconnected. Waiting for the socket to reconnect...");
-
-            //Deregister signal handler, so we can exit if we get stuck while connecting.
-            signal(SIGINT, SIG_DFL);
-
-            //Wait until we're connected or have to exit because of a connection error..
-            while (!Socket.IsReady() && !Socket.HandlerHasExited()) std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-            if (Socket.HandlerHasExited()) {
-                //Couldn't reconnect to client.
-                Logger.CriticalWCerr("Couldn't connect to client! Exiting...");
-
-                exit(1);
-
-            }
+        sigsuspend(&OldMask);
 
-            //Setup signal handler.
-            signal(SIGINT, RequestExit);
-
-        }
-
-        //Check if there are any messages.
-        Logger.Debug("main(): Checking for messages...");
-
-        while (Socket.HasPendingData()) {
-            Logger.Debug("main(): Message from local client: "+ConvertToString(Socket.Read())+"...");
-
-            Logger.Debug("main(): Sending acknowledgement...");
-            Socket.Write(ConvertToVectorChar("\x06"));
-
-            //Remove the message.
-            Socket.Pop();
-        }
-
-        //Wait for 1 second before doing anything.
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     }
 
+    pthread_sigmask(SIG_SETMASK, &OldMask, NULL);
+
     //User requested an exit.
     Logger.Debug("main(): Exiting...");
 
@@ -149,9 +139,8 @@ int main(int argc, char* argv[]) {
 
     ::RequestedExit = true;
 
-    //Stop the socket handler so it can be safely destructed.
-    Socket.RequestHandlerExit();
-    Socket.WaitForHandlerToExit();
+    //Close all of the sessions and stop the thread pool so the server can be safely destructed.
+    Server.Stop();
 
     return 0;
 }
@@ -0,0 +1,165 @@
+/*
+ACK latency test for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Checks that acknowledgements aren't held up behind a backlog of data going the other way: a plug sends reliable
+//messages to a socket that is busy sending bulk data back, and times how long each takes to be acknowledged.
+
+//Includes.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../include/loggertools.h"
+#include "../include/sockettools.h"
+#include "testtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Sends Count reliable messages one at a time, and returns the median time (in microseconds) each took to be acknowledged.
+double MedianAckLatency(Sockets& Plug, const int Count) {
+    std::vector<double> Latencies;
+
+    for (int i = 0; i < Count; i++) {
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        std::future<bool> Acked = Plug.SendReliable(Message("reliable " + std::to_string(i)));
+
+        if (Acked.wait_for(std::chrono::seconds(10)) != std::future_status::ready || !Acked.get()) {
+            Check(false, "Reliable message should be acknowledged");
+            return 0;
+
+        }
+
+        Latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+    }
+
+    std::sort(Latencies.begin(), Latencies.end());
+
+    return Latencies[Latencies.size() / 2];
+}
+
+int main() {
+    Logger.SetLevel("Critical");
+
+    const std::string Address = "unix:/tmp/stroodlr-acklatencytest-" + std::to_string(getpid()) + ".sock";
+
+    //Compression would shrink the backlog, so turn it off, and let the backlog grow big enough (64 MB) that waiting
+    //behind it would take tens of milliseconds.
+    Sockets Server("Socket");
+    Server.SetServerAddress(Address);
+    Server.SetConsoleOutput(false);
+    Server.SetCompressionThreshold(0);
+    Server.SetOutgoingWatermarks({256, 128, 64 * 1024 * 1024, 32 * 1024 * 1024});
+    Server.StartHandler();
+
+    Sockets Plug("Plug");
+    Plug.SetServerAddress(Address);
+    Plug.SetConsoleOutput(false);
+    Plug.SetCompressionThreshold(0);
+    Plug.StartHandler();
+
+    if (!Plug.WaitForState(ConnectionState::Connected, std::chrono::seconds(10)) || !Server.WaitForState(ConnectionState::Connected, std::chrono::seconds(10))) {
+        std::cerr << "FAILED: Couldn't connect" << std::endl;
+        return 1;
+
+    }
+
+    //The server's reads of our reliable messages are thrown away as they arrive.
+    std::atomic<bool> Stop(false);
+
+    std::thread ServerReader([&]() {
+        while (!Stop) {
+            std::vector<Message> Received;
+
+            if (Server.WaitForData(std::chrono::milliseconds(10))) {
+                Server.DrainAll(Received);
+
+            }
+        }
+    });
+
+    const double IdleLatency = MedianAckLatency(Plug, 50);
+
+    //Now keep the server's outgoing queue full of big messages, while we read them as fast as we can.
+    std::mt19937 Random(1);
+    std::string Bulk(256 * 1024, '\0');
+
+    for (std::size_t i = 0; i < Bulk.size(); i++) {
+        Bulk[i] = static_cast<char>(Random());
+
+    }
+
+    const Message BulkMessage(Bulk);
+
+    std::thread ServerWriter([&]() {
+        while (!Stop) {
+            Server.Write(BulkMessage);
+
+        }
+    });
+
+    std::atomic<std::size_t> BulkReceived(0);
+
+    std::thread PlugReader([&]() {
+        while (!Stop) {
+            std::vector<Message> Received;
+
+            if (Plug.WaitForData(std::chrono::milliseconds(10))) {
+                BulkReceived += Plug.DrainAll(Received);
+
+            }
+        }
+    });
+
+    //Let the backlog build up first.
+    while (Server.GetQueueStatistics().OutgoingMessages < 128) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    }
+
+    const double BusyLatency = MedianAckLatency(Plug, 50);
+    const std::size_t Backlog = Server.GetQueueStatistics().OutgoingMessages;
+
+    std::cout << "Median ACK latency idle: " << IdleLatency << " us, during a backlog of " << Backlog
+              << " messages: " << BusyLatency << " us (" << BulkReceived << " bulk messages received)" << std::endl;
+
+    Check(BulkReceived > 0, "Bulk data should be flowing while we measure");
+
+    //Waiting behind the backlog would take tens of milliseconds. Allow for a busy machine, but not for that.
+    Check(BusyLatency < 10 * IdleLatency + 5000, "ACK latency should stay flat while a backlog drains");
+
+    Stop = true;
+    Server.RequestHandlerExit();
+    Plug.RequestHandlerExit();
+    ServerWriter.join();
+    Server.WaitForHandlerToExit();
+    Plug.WaitForHandlerToExit();
+    ServerReader.join();
+    PlugReader.join();
+
+    return TestFailures();
+}
@@ -0,0 +1,202 @@
+/*
+Compression Tools tests for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Includes.
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/compressiontools.h"
+#include "../include/frametools.h"
+#include "testtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Returns Size bytes that compress well, badly, or somewhere in between.
+std::vector<char> MakeInput(std::mt19937& Random, const std::size_t Size, const int Kind) {
+    std::vector<char> Input(Size);
+
+    for (std::size_t i = 0; i < Size; i++) {
+        if (Kind == 0) {
+            Input[i] = static_cast<char>(Random());
+
+        } else if (Kind == 1) {
+            Input[i] = "abcab"[Random() % 5];
+
+        } else {
+            Input[i] = (i > 20 && Random() % 4) ? Input[i - 1 - Random() % 20] : static_cast<char>(Random());
+
+        }
+    }
+
+    return Input;
+}
+
+//Decompresses Compressed into a buffer of exactly OutSize bytes. Returns false if the decompressor refused it.
+bool TryDecompress(const std::vector<char>& Compressed, const std::size_t OutSize) {
+    LZCompressor Codec;
+    std::vector<char> Out(OutSize);
+
+    return Codec.Decompress(Compressed.data(), Compressed.size(), Out.data(), Out.size());
+}
+
+void TestRoundTrip() {
+    LZCompressor Codec;
+    std::mt19937 Random(1);
+
+    for (int i = 0; i < 2000; i++) {
+        std::vector<char> Input = MakeInput(Random, Random() % 5000, i % 3);
+        std::vector<char> Compressed;
+        Codec.Compress(Input.data(), Input.size(), Compressed);
+
+        std::vector<char> Output(Input.size());
+        Check(Codec.Decompress(Compressed.data(), Compressed.size(), Output.data(), Output.size()) && Output == Input,
+              "Compressed data should decompress to the original");
+
+    }
+}
+
+void TestTruncated() {
+    //Every truncation of a valid stream should be refused.
+    LZCompressor Codec;
+    std::mt19937 Random(2);
+    std::vector<char> Input = MakeInput(Random, 3000, 2);
+    std::vector<char> Compressed;
+    Codec.Compress(Input.data(), Input.size(), Compressed);
+
+    for (std::size_t Length = 0; Length < Compressed.size(); Length++) {
+        std::vector<char> Truncated(Compressed.begin(), Compressed.begin() + Length);
+        Check(!TryDecompress(Truncated, Input.size()), "Truncated data should be refused");
+
+    }
+
+    //So should a stream that's too long for the buffer, or one that stops short of it.
+    Check(!TryDecompress(Compressed, Input.size() - 1), "Data longer than the buffer should be refused");
+    Check(!TryDecompress(Compressed, Input.size() + 1), "Data shorter than the buffer should be refused");
+}
+
+void TestCorrupt() {
+    //Flipped bits can give garbage, but mustn't write outside the buffer (run this under a sanitizer to be sure).
+    LZCompressor Codec;
+    std::mt19937 Random(3);
+
+    for (int i = 0; i < 5000; i++) {
+        std::vector<char> Input = MakeInput(Random, 1 + Random() % 2000, i % 3);
+        std::vector<char> Compressed;
+        Codec.Compress(Input.data(), Input.size(), Compressed);
+
+        Compressed[Random() % Compressed.size()] ^= static_cast<char>(1 << (Random() % 8));
+        TryDecompress(Compressed, Input.size());
+
+    }
+}
+
+void TestHostile() {
+    //A literal length that never ends.
+    std::vector<char> Endless(1, '\xF0');
+    Endless.insert(Endless.end(), 100, '\xFF');
+    Check(!TryDecompress(Endless, 1000), "An unterminated literal length should be refused");
+
+    //A literal length far bigger than the input or output.
+    std::vector<char> Long = {'\xF0', '\xFF', '\xFF', '\xFF', '\x00', 'a', 'b'};
+    Check(!TryDecompress(Long, 1000), "A literal longer than the data should be refused");
+
+    //Matches that point before the start of the output, or at the byte being written.
+    std::vector<char> ZeroOffset = {'\x10', 'a', '\x00', '\x00'};
+    Check(!TryDecompress(ZeroOffset, 5), "A match with offset 0 should be refused");
+
+    std::vector<char> FarOffset = {'\x10', 'a', '\x02', '\x00'};
+    Check(!TryDecompress(FarOffset, 5), "A match before the start of the output should be refused");
+
+    //A match longer than the room left.
+    std::vector<char> LongMatch = {'\x1F', 'a', '\x01', '\x00', '\xFF', '\xFF', '\x00'};
+    Check(!TryDecompress(LongMatch, 100), "A match longer than the buffer should be refused");
+
+    //A match with no offset after it.
+    std::vector<char> NoOffset = {'\x10', 'a', '\x01'};
+    Check(!TryDecompress(NoOffset, 5), "A match without a whole offset should be refused");
+
+    //Valid: one literal, then a run made by an overlapping match.
+    std::vector<char> Run = {'\x10', 'a', '\x01', '\x00'};
+    Check(TryDecompress(Run, 5), "An overlapping match should be accepted");
+}
+
+void TestPayloads() {
+    std::vector<std::shared_ptr<Compressor> > Codecs(1, std::make_shared<LZCompressor>());
+    std::vector<char> Out;
+
+    //Round trip through the payload header.
+    std::string Text;
+
+    for (int i = 0; i < 500; i++) {
+        Text += "Line " + std::to_string(i % 7) + ": the same thing again\n";
+
+    }
+
+    Message Compressed;
+    Check(CompressPayload(*Codecs[0], Message(Text), Compressed), "Repetitive text should compress");
+    DecompressPayload(Codecs, Compressed.Data(), Compressed.Size(), Out);
+    Check(std::string(Out.begin(), Out.end()) == Text, "Payload should decompress to the original");
+
+    //Incompressible data isn't worth sending compressed.
+    std::mt19937 Random(4);
+    std::vector<char> Noise = MakeInput(Random, 1000, 0);
+    Message Unchanged;
+    Check(!CompressPayload(*Codecs[0], Message(Noise.data(), Noise.size()), Unchanged), "Random data shouldn't be compressed");
+
+    //Big random payloads should give up after the first block, and still round-trip if anyone does decompress them.
+    std::vector<char> BigNoise = MakeInput(Random, 65536, 0);
+    std::vector<char> Copied;
+    Check(!CompressPayload(*Codecs[0], Message(BigNoise.data(), BigNoise.size()), Unchanged), "Large random data shouldn't be compressed");
+    Codecs[0]->Compress(BigNoise.data(), BigNoise.size(), Copied);
+    Check(Copied.size() < BigNoise.size() + BigNoise.size() / 255 + 16, "Giving up should just copy the rest");
+
+    Out.assign(BigNoise.size(), 0);
+    Check(Codecs[0]->Decompress(Copied.data(), Copied.size(), Out.data(), Out.size()) && Out == BigNoise,
+          "Data we gave up on should decompress to the original");
+
+    //Bad headers.
+    std::vector<char> Short = {'\x01', '\x00'};
+    CheckThrows([&]() { DecompressPayload(Codecs, Short.data(), Short.size(), Out); }, "A short header should be rejected");
+
+    std::vector<char> Unknown(Compressed.begin(), Compressed.end());
+    Unknown[0] = 9;
+    CheckThrows([&]() { DecompressPayload(Codecs, Unknown.data(), Unknown.size(), Out); }, "An unknown codec should be rejected");
+
+    std::vector<char> Huge(Compressed.begin(), Compressed.end());
+    EncodeUInt32(MaxFramePayloadSize + 1, Huge.data() + 1);
+    CheckThrows([&]() { DecompressPayload(Codecs, Huge.data(), Huge.size(), Out); }, "An oversized length should be rejected");
+
+    std::vector<char> Lying(Compressed.begin(), Compressed.end());
+    EncodeUInt32(static_cast<std::uint32_t>(Text.size() + 1), Lying.data() + 1);
+    CheckThrows([&]() { DecompressPayload(Codecs, Lying.data(), Lying.size(), Out); }, "A wrong length should be rejected");
+}
+
+int main() {
+    Logger.SetLevel("Critical");
+
+    TestRoundTrip();
+    TestTruncated();
+    TestCorrupt();
+    TestHostile();
+    TestPayloads();
+
+    return TestFailures();
+}
@@ -0,0 +1,140 @@
+/*
+Frame Tools tests for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Includes.
+#include <string>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/frametools.h"
+#include "testtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Returns a whole frame, header and payload.
+std::vector<char> MakeFrame(const FrameHeader& Header, const std::string& Payload) {
+    std::vector<char> Bytes(FrameHeaderSize);
+    EncodeFrameHeader(Header, Bytes.data());
+    Bytes.insert(Bytes.end(), Payload.begin(), Payload.end());
+
+    return Bytes;
+}
+
+//A data frame's header, with one byte (at Offset) changed to Value.
+std::vector<char> CorruptHeader(const std::size_t Offset, const char Value) {
+    FrameHeader Header;
+    Header.Length = 4;
+
+    std::vector<char> Bytes = MakeFrame(Header, "data");
+    Bytes[Offset] = Value;
+
+    return Bytes;
+}
+
+//Feeds Bytes to a new decoder, and peeks at the frame.
+void Peek(const std::vector<char>& Bytes) {
+    FrameDecoder Decoder;
+    Decoder.Feed(Bytes.data(), Bytes.size());
+
+    FrameHeader Header;
+    const char* Payload = nullptr;
+    Decoder.PeekFrame(Header, Payload);
+}
+
+void TestRoundTrip() {
+    //Frames fed a byte at a time should only appear once they're complete, and come out as they went in.
+    FrameHeader Header;
+    Header.Length = 5;
+    Header.Sequence = 42;
+
+    std::vector<char> Bytes = MakeFrame(Header, "hello");
+
+    FrameHeader Pong;
+    Pong.Type = FrameTypePong;
+    Pong.Length = TimestampSize;
+    std::vector<char> PongBytes = MakeFrame(Pong, std::string(TimestampSize, '\x01'));
+    Bytes.insert(Bytes.end(), PongBytes.begin(), PongBytes.end());
+
+    FrameDecoder Decoder;
+    FrameHeader Got;
+    const char* Payload = nullptr;
+
+    for (std::size_t i = 0; i < FrameHeaderSize + 4; i++) {
+        Decoder.Feed(Bytes.data() + i, 1);
+        Check(!Decoder.PeekFrame(Got, Payload), "An incomplete frame shouldn't be returned");
+
+    }
+
+    Decoder.Feed(Bytes.data() + FrameHeaderSize + 4, Bytes.size() - FrameHeaderSize - 4);
+
+    Check(Decoder.PeekFrame(Got, Payload), "A complete frame should be returned");
+    Check(Got.Type == FrameTypeData && Got.Length == 5 && Got.Sequence == 42 && Got.Channel == 0 && !Got.Compressed,
+          "The header should decode as it was encoded");
+
+    Message Taken = Decoder.TakePayload();
+    Check(Taken == "hello", "The payload should come out as it went in");
+
+    std::vector<char> PongPayload;
+    Check(Decoder.GetFrame(Got, PongPayload), "The second frame should be returned");
+    Check(Got.Type == FrameTypePong && PongPayload == std::vector<char>(TimestampSize, '\x01'), "The second frame should decode as it was encoded");
+    Check(Decoder.BufferedBytes() == 0, "Nothing should be left once both frames are taken");
+}
+
+void TestRejects() {
+    //Bad headers should be refused as soon as they've arrived.
+    CheckThrows([]() { Peek(CorruptHeader(0, FrameProtocolVersion + 1)); }, "A bad protocol version should be rejected");
+    CheckThrows([]() { Peek(CorruptHeader(1, 7)); }, "An unknown frame type should be rejected");
+    CheckThrows([]() { Peek(CorruptHeader(2, 0x02)); }, "Unknown flags should be rejected");
+
+    //Too big. This shouldn't wait for the payload to arrive.
+    FrameHeader Header;
+    Header.Length = MaxFramePayloadSize + 1;
+    std::vector<char> Huge = MakeFrame(Header, "");
+    CheckThrows([&]() { Peek(Huge); }, "A frame bigger than MaxFramePayloadSize should be rejected");
+
+    //Control and reliable frames only belong on channel 0.
+    Header = FrameHeader();
+    Header.Length = 1;
+    Header.Channel = 1;
+    Header.Sequence = 1;
+    std::vector<char> Reliable = MakeFrame(Header, "x");
+    CheckThrows([&]() { Peek(Reliable); }, "A reliable frame on a logical channel should be rejected");
+
+    //Malformed heartbeats.
+    Header = FrameHeader();
+    Header.Type = FrameTypePing;
+    Header.Length = 3;
+    std::vector<char> Ping = MakeFrame(Header, "abc");
+    CheckThrows([&]() { Peek(Ping); }, "A ping with a short timestamp should be rejected");
+
+    //A good frame on a logical channel is fine.
+    Header = FrameHeader();
+    Header.Length = 1;
+    Header.Channel = 3;
+    std::vector<char> Good = MakeFrame(Header, "x");
+    CheckNoThrow([&]() { Peek(Good); }, "An unreliable data frame on a logical channel should be accepted");
+}
+
+int main() {
+    Logger.SetLevel("Critical");
+
+    TestRoundTrip();
+    TestRejects();
+
+    return TestFailures();
+}
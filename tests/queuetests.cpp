@@ -0,0 +1,165 @@
+/*
+Queue Tools tests for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Includes.
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/queuetools.h"
+#include "testtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+void TestCapacity() {
+    //The capacity is rounded up to a power of two.
+    SPSCQueue<int> Queue(5);
+    Check(Queue.GetCapacity() == 8, "Capacity of 5 should round up to 8");
+    Check(Queue.Empty() && !Queue.Full() && Queue.Size() == 0, "New queue should be empty");
+
+    for (int i = 0; i < 8; i++) {
+        Check(Queue.Push(i), "Push into a queue with room should succeed");
+
+    }
+
+    Check(Queue.Full() && Queue.Size() == 8, "Queue should be full after 8 pushes");
+    Check(!Queue.Push(8), "Push into a full queue should fail");
+    Check(Queue.Front() == 0, "A failed push shouldn't disturb the queue");
+}
+
+void TestWraparound() {
+    //Push and pop in uneven steps, so the indexes wrap round the slots many times.
+    SPSCQueue<int> Queue(4);
+    int NextIn = 0;
+    int NextOut = 0;
+
+    for (int Cycle = 0; Cycle < 1000; Cycle++) {
+        const int ToPush = 1 + (Cycle % 4);
+
+        for (int i = 0; i < ToPush && !Queue.Full(); i++) {
+            Check(Queue.Push(NextIn++), "Push should succeed while not full");
+
+        }
+
+        Check(Queue.Size() == static_cast<std::size_t>(NextIn - NextOut), "Size should match what's been pushed and popped");
+
+        for (std::size_t i = 0; i < Queue.Size(); i++) {
+            Check(Queue.At(i) == NextOut + static_cast<int>(i), "At() should see items in order across the wrap");
+
+        }
+
+        const int ToPop = 1 + ((Cycle * 3) % 4);
+
+        for (int i = 0; i < ToPop && !Queue.Empty(); i++) {
+            Check(Queue.Front() == NextOut++, "Items should come out in order across the wrap");
+            Queue.Pop();
+
+        }
+    }
+}
+
+void TestManyAcrossWrap() {
+    //PushMany() and PopMany() should stop at the ends of the queue, not the ends of the slots.
+    SPSCQueue<std::string> Queue(8);
+
+    for (int i = 0; i < 6; i++) {
+        Queue.Push(std::to_string(i));
+
+    }
+
+    std::vector<std::string> Out;
+    Check(Queue.PopMany(Out, 5) == 5, "PopMany should take as many as asked for");
+
+    std::vector<std::string> In;
+
+    for (int i = 6; i < 20; i++) {
+        In.push_back(std::to_string(i));
+
+    }
+
+    Check(Queue.PushMany(In.begin(), In.end()) == 7, "PushMany should only push as many as there is room for");
+    Check(Queue.Full(), "Queue should be full after PushMany");
+
+    Out.clear();
+    Check(Queue.PopMany(Out, 100) == 8, "PopMany should stop when the queue is empty");
+
+    for (std::size_t i = 0; i < Out.size(); i++) {
+        Check(Out[i] == std::to_string(5 + i), "PopMany should return items in order across the wrap");
+
+    }
+
+    Check(Queue.Empty(), "Queue should be empty after PopMany");
+
+    //Clear() should empty it, and leave it usable.
+    Queue.Push("a");
+    Queue.Push("b");
+    Queue.Clear();
+    Check(Queue.Empty() && Queue.Size() == 0, "Clear should empty the queue");
+    Check(Queue.Push("c") && Queue.Front() == "c", "Queue should be usable after Clear");
+}
+
+void TestTwoThreads() {
+    //One producer and one consumer, with a small queue so it's full and empty a lot.
+    const int Count = 200000;
+    SPSCQueue<int> Queue(16);
+    bool InOrder = true;
+
+    std::thread Consumer([&]() {
+        int Expected = 0;
+
+        while (Expected < Count) {
+            if (Queue.Empty()) {
+                std::this_thread::yield();
+                continue;
+
+            }
+
+            if (Queue.Front() != Expected) {
+                InOrder = false;
+
+            }
+
+            Queue.Pop();
+            Expected++;
+
+        }
+    });
+
+    for (int i = 0; i < Count; i++) {
+        while (!Queue.Push(i)) {
+            std::this_thread::yield();
+
+        }
+    }
+
+    Consumer.join();
+    Check(InOrder, "Items should arrive in order across threads");
+    Check(Queue.Empty(), "Queue should be empty once the consumer is done");
+}
+
+int main() {
+    Logger.SetLevel("Critical");
+
+    TestCapacity();
+    TestWraparound();
+    TestManyAcrossWrap();
+    TestTwoThreads();
+
+    return TestFailures();
+}
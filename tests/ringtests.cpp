@@ -0,0 +1,161 @@
+/*
+Ring Tools tests for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Includes.
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../include/loggertools.h"
+#include "../include/messagetools.h"
+#include "../include/ringtools.h"
+#include "testtools.h"
+
+//Global logger, needed by the library.
+Logging Logger;
+
+//Writes Count bytes of Fill at the ring's write position.
+void WriteBytes(ReceiveRing& Ring, const std::size_t Count, const char Fill) {
+    std::size_t Space = 0;
+    char* Destination = Ring.WriteSpace(Space);
+    Check(Space >= Count, "Ring should have room for the write");
+    memset(Destination, Fill, Count);
+    Ring.Commit(Count);
+}
+
+void TestReleaseOrder() {
+    //Space only comes back once a lease and every lease before it has been released.
+    std::shared_ptr<ReceiveRing> Ring = std::make_shared<ReceiveRing>(4096);
+    const std::size_t Size = Ring->GetSize();
+    const std::size_t Half = Size / 2;
+
+    WriteBytes(*Ring, Half, 'a');
+    WriteBytes(*Ring, Half, 'b');
+
+    std::unique_ptr<Message> First(new Message(Ring->Lease(Half)));
+    std::unique_ptr<Message> Second(new Message(Ring->Lease(Half)));
+    Check(First->IsView() && Second->IsView(), "Large leases should be views into the ring");
+    Check(First->Data()[0] == 'a' && Second->Data()[Half - 1] == 'b', "Leases should see what was written");
+
+    std::size_t Space = 1;
+    Ring->WriteSpace(Space);
+    Check(Space == 0, "Ring should be full while both leases are held");
+
+    //Release the newer lease first. Its space can't be reused until the older one has gone too.
+    Second.reset();
+    Ring->WriteSpace(Space);
+    Check(Space == 0, "Releasing the newer lease first shouldn't free any space");
+    Check(!Ring->IsIdle(), "Ring shouldn't be idle while the older lease is held");
+    Check(First->Data()[Half - 1] == 'a', "The older lease should be untouched");
+
+    First.reset();
+    Ring->WriteSpace(Space);
+    Check(Space == Size, "Releasing the older lease should free the whole ring");
+    Check(Ring->IsIdle(), "Ring should be idle once every lease is released");
+}
+
+void TestCopiesAndConsume() {
+    //Small messages are copied, and consumed bytes come straight back.
+    std::shared_ptr<ReceiveRing> Ring = std::make_shared<ReceiveRing>(4096);
+    const std::size_t Size = Ring->GetSize();
+
+    WriteBytes(*Ring, Message::InlineCapacity, 'x');
+    Message Small = Ring->Lease(Message::InlineCapacity);
+    Check(!Small.IsView() && Small.Size() == Message::InlineCapacity, "Small leases should be copied");
+    Check(Ring->IsIdle(), "Copying shouldn't hold a lease");
+
+    WriteBytes(*Ring, 100, 'y');
+    Ring->Consume(100);
+    Check(Ring->Readable() == 0, "Nothing should be readable after consuming everything");
+
+    std::size_t Space = 0;
+    Ring->WriteSpace(Space);
+    Check(Space == Size, "Consumed bytes should be reusable straight away");
+}
+
+void TestWrap() {
+    //A message that straddles the end of the buffer should still be contiguous, thanks to the second mapping.
+    std::shared_ptr<ReceiveRing> Ring = std::make_shared<ReceiveRing>(4096);
+    const std::size_t Size = Ring->GetSize();
+
+    WriteBytes(*Ring, Size - 10, 'p');
+    Ring->Consume(Size - 10);
+
+    std::string Text;
+
+    for (std::size_t i = 0; i < 100; i++) {
+        Text.push_back(static_cast<char>('A' + (i % 26)));
+
+    }
+
+    std::size_t Space = 0;
+    char* Destination = Ring->WriteSpace(Space);
+    Check(Space == Size, "Whole ring should be free");
+    memcpy(Destination, Text.data(), Text.size());
+    Ring->Commit(Text.size());
+
+    Check(Ring->Readable() == Text.size(), "All the written bytes should be readable");
+    Check(std::string(Ring->ReadPointer(), Text.size()) == Text, "Bytes across the wrap should read back contiguously");
+
+    Message Wrapped = Ring->Lease(Text.size());
+    Check(Wrapped.IsView() && Wrapped == Text, "A lease across the wrap should be contiguous");
+
+    //Clear() drops unread bytes, but leaves leases alone.
+    WriteBytes(*Ring, 50, 'z');
+    Ring->Clear();
+    Check(Ring->Readable() == 0, "Clear should drop unread bytes");
+    Check(!Ring->IsIdle() && Wrapped == Text, "Clear shouldn't touch leased bytes");
+}
+
+void TestLeaseLifetime() {
+    //Copies and slices share a lease, leases are reused once released, and a view keeps its ring alive.
+    std::shared_ptr<ReceiveRing> Ring = std::make_shared<ReceiveRing>(4096);
+
+    for (std::size_t i = 0; i < 2 * MaxRingLeases; i++) {
+        WriteBytes(*Ring, 100, 'r');
+        Message Lease = Ring->Lease(100);
+        Check(Lease.IsView(), "Released leases should be reused");
+
+    }
+
+    Check(Ring->IsIdle(), "Every reused lease should have been released");
+
+    WriteBytes(*Ring, 100, 'c');
+    Message Original = Ring->Lease(100);
+    Message Copy = Original;
+    Message Part = Original.Slice(10, 50);
+
+    Original = Message();
+    Copy = Message();
+    Check(!Ring->IsIdle(), "A slice should hold the lease");
+    Check(Part.IsView() && Part.Size() == 50 && Part.Data()[49] == 'c', "A slice should see its part of the lease");
+
+    Ring.reset();
+    Check(Part.Data()[0] == 'c', "A view should keep its ring alive");
+}
+
+int main() {
+    Logger.SetLevel("Critical");
+
+    TestReleaseOrder();
+    TestCopiesAndConsume();
+    TestWrap();
+    TestLeaseLifetime();
+
+    return TestFailures();
+}
@@ -0,0 +1,63 @@
+/*
+Test Tools header for Stroodlr Version 0.9
+This file is part of Stroodlr.
+Copyright (C) 2017 Hamish McIntyre-Bhatty
+Stroodlr is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License version 3 or,
+at your option, any later version.
+
+Stroodlr is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Stroodlr.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//Only include once.
+#pragma once
+
+//Includes.
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+//Each test program counts its failures here, and returns TestFailures() from main(), so ctest sees them.
+inline int& TestFailures() {
+    static int Failures = 0;
+    return Failures;
+}
+
+inline void Check(const bool Condition, const std::string& What) {
+    if (!Condition) {
+        std::cerr << "FAILED: " << What << std::endl;
+        TestFailures()++;
+
+    }
+}
+
+template <typename Function>
+inline void CheckThrows(Function Body, const std::string& What) {
+    //Body must throw std::runtime_error (or something derived from it).
+    try {
+        Body();
+
+    } catch (std::runtime_error&) {
+        return;
+
+    }
+
+    Check(false, What);
+}
+
+template <typename Function>
+inline void CheckNoThrow(Function Body, const std::string& What) {
+    try {
+        Body();
+
+    } catch (std::exception& Error) {
+        Check(false, What + " (threw: " + Error.what() + ")");
+
+    }
+}